@@ -1,5 +1,5 @@
 set CXX=g++
-set CFLAGS=-std=c++17
+set CFLAGS=-std=c++17 -O2
 set VERSION=3.3.2
 set LIB_NAME=xml-mesh
 set BLENDER="C:\Program Files\Blender Foundation\Blender\blender.exe"
@@ -20,7 +20,7 @@ del /Q /F /S obj\* bin\%LIB_NAME%-%VERSION%.dll lib\lib%LIB_NAME%.a data\dummy.x
 
 :: Make the library.
 
-@for %%m in (parse access build math animate error) do (
+@for %%m in (parse access build math animate error skeleton crowd parallel posecache vertexcache skin frame trace stats memory idpool scan load datacache lazy) do (
     %CXX% %CFLAGS% -I include\xml-mesh -c src\%%m.cpp -o obj\%%m.o -fPIC
 
     @if %ERRORLEVEL% neq 0 (
@@ -28,7 +28,8 @@ del /Q /F /S obj\* bin\%LIB_NAME%-%VERSION%.dll lib\lib%LIB_NAME%.a data\dummy.x
     )
 )
 
-%CXX% obj\parse.o obj\math.o obj\animate.o obj\build.o obj\access.o obj\error.o -lxml2 ^
+%CXX% obj\parse.o obj\math.o obj\animate.o obj\build.o obj\access.o obj\error.o ^
+obj\skeleton.o obj\crowd.o obj\parallel.o obj\posecache.o obj\vertexcache.o obj\skin.o obj\frame.o obj\trace.o obj\stats.o obj\memory.o obj\idpool.o obj\scan.o obj\load.o obj\datacache.o obj\lazy.o -lxml2 -pthread ^
 -o bin\%LIB_NAME%-%VERSION%.dll -shared -fPIC -Wl,--out-implib,lib\lib%LIB_NAME%.a
 @if %ERRORLEVEL% neq 0 (
     goto end
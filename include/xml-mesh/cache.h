@@ -0,0 +1,196 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+#include "skin.h"
+
+
+namespace XMLMesh
+{
+    struct MeshPoseCacheKey
+    {
+        size_t animationIndex;
+        bool loop;
+        size_t step;  // quantized frame
+
+        bool operator==(const MeshPoseCacheKey &) const;
+    };
+
+    struct MeshPoseCacheKeyHash
+    {
+        size_t operator()(const MeshPoseCacheKey &) const;
+    };
+
+    struct MeshPoseCacheEntry
+    {
+        MeshPoseCacheKey key;
+        std::vector<MeshBoneTransformation> pose;
+    };
+
+    /**
+     *  Remembers recently sampled poses, so that instances playing the same animation
+     *  at nearly the same time can share them.
+     *
+     *  Frames are rounded to 1 / stepsPerFrame before sampling, so a cached pose can be
+     *  up to half a step off. When the cache grows beyond its byte limit, the least
+     *  recently used poses are dropped.
+     *
+     *  All functions may be called from multiple threads at once.
+     */
+    class MeshPoseCache
+    {
+        private:
+            const MeshSkeleton *pSkeleton;
+            float stepsPerFrame;
+            size_t maxBytes, usedBytes;
+
+            std::mutex mutex;
+            std::list<MeshPoseCacheEntry> entries;  // most recently used first
+            std::unordered_map<MeshPoseCacheKey, std::list<MeshPoseCacheEntry>::iterator,
+                               MeshPoseCacheKeyHash> mEntries;
+
+            std::atomic<size_t> countHits, countMisses;
+
+            MeshPoseCache(void);
+            ~MeshPoseCache(void);
+
+            MeshPoseCache(const MeshPoseCache &) = delete;
+            void operator=(const MeshPoseCache &) = delete;
+
+            size_t GetEntryBytes(void) const;
+        public:
+            /**
+             *  Copies the pose for the given frame to 'poseOut', one transformation per bone.
+             *  Samples it first, if it's not in the cache.
+             */
+            void GetPoseAt(const size_t animationIndex, const float frame, const bool loop,
+                           MeshBoneTransformation *poseOut);
+
+            const MeshSkeleton *GetSkeleton(void) const;
+
+            size_t CountHits(void) const;
+            size_t CountMisses(void) const;
+            void ResetCounters(void);
+
+            size_t CountPoses(void);
+            size_t GetUsedBytes(void);
+            size_t GetMaxBytes(void) const;
+            void Clear(void);
+
+        friend MeshPoseCache *CreateMeshPoseCache(const MeshSkeleton *, const float stepsPerFrame, const size_t maxBytes);
+        friend void DestroyMeshPoseCache(MeshPoseCache *);
+    };
+
+    /**
+     *  The skeleton must outlive the cache.
+     */
+    MeshPoseCache *CreateMeshPoseCache(const MeshSkeleton *, const float stepsPerFrame, const size_t maxBytes);
+    void DestroyMeshPoseCache(MeshPoseCache *);
+
+    /**
+     *  Like the MeshData version, but takes the transformations from the cache.
+     *  Like the MeshData version, it only sets the bones that have a layer in the animation.
+     */
+    void GetBoneTransformationsAt(MeshPoseCache *, const std::string_view animationID,
+                                  const milliseconds msSinceStart, const float framesPerSecond, const bool loop,
+                                  std::unordered_map<std::string, MeshBoneTransformation> &);
+
+
+    /**
+     *  Skinned vertex positions, and optionally normals, for every frame of one animation.
+     *  Playing it back only interpolates between two stored frames, without any skinning.
+     *
+     *  Positions are stored as 16 bit fractions of the animation's bounding box and normals as
+     *  8 bit signed fractions, so the frames take 6 or 9 bytes per vertex.
+     *  Vertices are in skeleton order.
+     */
+    class MeshVertexAnimationCache
+    {
+        private:
+            const MeshSkeleton *pSkeleton;
+            size_t animationIndex;
+            bool loop;
+
+            size_t countFrames;
+            vec3 boundsMin, boundsScale;
+            std::vector<uint16_t> positions;  // x, y, z per vertex per frame
+            std::vector<int8_t> normals;  // idem, empty if not requested
+
+            MeshVertexAnimationCache(void);
+            ~MeshVertexAnimationCache(void);
+
+            MeshVertexAnimationCache(const MeshVertexAnimationCache &) = delete;
+            void operator=(const MeshVertexAnimationCache &) = delete;
+
+            // The two stored frames around the given time, and how far it is between them.
+            void GetFramesAt(const milliseconds msSinceStart, const float framesPerSecond,
+                             size_t &frame0Out, size_t &frame1Out, float &sOut) const;
+
+            // Passes the vertex index and its position to the output, for every vertex.
+            template <typename PositionOutput>
+            void DecodePositions(const size_t frame0, const size_t frame1, const float s, PositionOutput) const;
+        public:
+            const MeshSkeleton *GetSkeleton(void) const;
+            size_t GetAnimationIndex(void) const;
+            size_t CountFrames(void) const;
+            bool HasNormals(void) const;
+
+            /**
+             *  Bytes taken by this object, including the stored frames.
+             */
+            size_t GetMemoryUsage(void) const;
+
+            /**
+             *  Writes one position per skeleton vertex. 'normalsOut' may be NULL,
+             *  it's ignored when the cache has no normals.
+             */
+            void GetVerticesAt(const milliseconds msSinceStart, const float framesPerSecond,
+                               vec3 *positionsOut, vec3 *normalsOut) const;
+
+        friend MeshVertexAnimationCache *CreateMeshVertexAnimationCache(const MeshData *, const MeshSkeleton *,
+                                                                        const std::string_view animationID,
+                                                                        const bool loop, const bool withNormals);
+        friend void DestroyMeshVertexAnimationCache(MeshVertexAnimationCache *);
+        friend void ApplyVertexAnimation(const MeshVertexAnimationCache *, const milliseconds,
+                                         const float, MeshSkinningTable *);
+    };
+
+    /**
+     *  Skins the mesh at every frame from zero up to and including the animation's length.
+     *  The skeleton must have been compiled from the given MeshData object and must outlive the cache.
+     */
+    MeshVertexAnimationCache *CreateMeshVertexAnimationCache(const MeshData *, const MeshSkeleton *,
+                                                             const std::string_view animationID,
+                                                             const bool loop, const bool withNormals);
+    void DestroyMeshVertexAnimationCache(MeshVertexAnimationCache *);
+
+    /**
+     *  Sets the vertex positions of the table's MeshState object. The table must have been compiled
+     *  with the cache's skeleton, and can be kept for every frame, so that playing back doesn't
+     *  look up any ids or allocate.
+     */
+    void ApplyVertexAnimation(const MeshVertexAnimationCache *, const milliseconds msSinceStart,
+                              const float framesPerSecond, MeshSkinningTable *);
+}
+
+#endif  // CACHE_H
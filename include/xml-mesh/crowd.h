@@ -0,0 +1,61 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CROWD_H
+#define CROWD_H
+
+#include "skeleton.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  One animated copy of a mesh, as input for the crowd functions.
+     */
+    struct MeshInstance
+    {
+        size_t animationIndex;  // see MeshSkeleton::GetAnimationIndex
+        milliseconds msSinceStart;
+        bool loop;
+    };
+
+    /**
+     *  Evaluates many instances of the same skeleton at once.
+     *
+     *  Instances that play the same animation are grouped and sorted by frame, so that
+     *  the key frame search is shared between them. Instances at the exact same frame are
+     *  only evaluated once. The work is spread over 'countThreads' threads, or over all
+     *  cores if that is zero.
+     *
+     *  'palettesOut' must have room for countInstances * CountBones() entries.
+     *  The palette of instance i starts at entry i * CountBones().
+     */
+    void GetInstanceBonePalettes(const MeshSkeleton *, const MeshInstance *, const size_t countInstances,
+                                 const float framesPerSecond, MeshBonePaletteEntry *palettesOut,
+                                 const size_t countThreads = 0);
+
+    /**
+     *  Like GetInstanceBonePalettes, but outputs skinned positions instead.
+     *
+     *  'positionsOut' must have room for countInstances * CountVertices() entries.
+     *  The positions of instance i start at entry i * CountVertices(), in skeleton vertex order.
+     */
+    void SkinInstances(const MeshSkeleton *, const MeshInstance *, const size_t countInstances,
+                       const float framesPerSecond, vec3 *positionsOut,
+                       const size_t countThreads = 0, const MeshSkinningMode mode = MESHSKIN_LINEAR);
+}
+
+#endif  // CROWD_H
@@ -0,0 +1,138 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef DATACACHE_H
+#define DATACACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+
+#include "load.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Shared by everyone who got the same mesh from a MeshDataCache.
+     *  The last one to let go destroys it, even after the cache has been destroyed.
+     */
+    typedef std::shared_ptr<const MeshData> MeshDataHandle;
+
+    struct MeshDataCacheEntry
+    {
+        std::string key;  // for documents, this includes the whole text
+
+        std::shared_future<MeshDataHandle> future;  // only while loading
+        MeshDataHandle pMeshData;  // NULL while loading
+        size_t countBytes;
+    };
+
+    /**
+     *  Lets the parts of a program that load the same file, or the same document,
+     *  share one MeshData object. Files are known by their path, documents from
+     *  a stream by their whole text. The cache keeps that text with the mesh and
+     *  counts it against the byte limit.
+     *
+     *  A mesh that's requested while it's being loaded isn't loaded a second time.
+     *  The request waits for the first load instead. Failed loads aren't remembered,
+     *  so the next request tries again.
+     *
+     *  Meshes are counted by GetMemoryUsage, plus the size of their key. When the total grows beyond the byte limit,
+     *  the least recently used meshes that are held by the cache only are dropped.
+     *  Meshes that are still being held elsewhere stay, even if that exceeds the limit.
+     *
+     *  All functions may be called from multiple threads at once.
+     */
+    class MeshDataCache
+    {
+        private:
+            MeshLoadOptions options;
+            size_t maxBytes, usedBytes, countLoading;
+
+            std::mutex mutex;
+            std::condition_variable loadFinished;
+            std::list<MeshDataCacheEntry> entries;  // most recently used first
+            // The keys are those of the entries, which don't move in the list.
+            std::unordered_map<std::string_view, std::list<MeshDataCacheEntry>::iterator> mEntries;
+
+            std::atomic<size_t> countHits, countMisses;
+
+            MeshDataCache(void);
+            ~MeshDataCache(void);
+
+            MeshDataCache(const MeshDataCache &) = delete;
+            void operator=(const MeshDataCache &) = delete;
+
+            /**
+             *  Returns true if the caller must load the mesh and fulfil the promise.
+             *  Otherwise, the future is for the cached mesh or for a load that's already going on.
+             */
+            bool StartEntry(const std::string &key, std::promise<MeshDataHandle> &,
+                            std::shared_future<MeshDataHandle> &futureOut);
+
+            void Load(const std::string &key, const std::function<MeshData *(void)> &, std::promise<MeshDataHandle> &);
+            MeshDataHandle Get(const std::string &key, const std::function<MeshData *(void)> &);
+
+            // Must hold the mutex. The dropped meshes must be released after unlocking it.
+            void Evict(const size_t limit, std::vector<MeshDataHandle> &evictedOut);
+        public:
+            /**
+             *  Loads the file on the options' executor, unless it's already cached or loading.
+             */
+            std::shared_future<MeshDataHandle> LoadFile(const std::string &path);
+
+            /**
+             *  Loads the file on the calling thread, unless it's already cached or loading.
+             *  Throws the load's error. Don't call it from the executor's threads, because it
+             *  might have to wait for a load that's queued there.
+             */
+            MeshDataHandle GetFile(const std::string &path);
+
+            /**
+             *  Reads the document, then parses it if no identical document has been cached.
+             */
+            MeshDataHandle GetDocument(std::istream &);
+
+            size_t CountHits(void) const;
+            size_t CountMisses(void) const;
+            void ResetCounters(void);
+
+            size_t CountMeshes(void);  // including the ones that are loading
+            size_t GetUsedBytes(void);
+            size_t GetMaxBytes(void) const;
+
+            // Drops every mesh that's held by the cache only.
+            void Clear(void);
+
+        friend MeshDataCache *CreateMeshDataCache(const size_t maxBytes, const MeshLoadOptions &);
+        friend void DestroyMeshDataCache(MeshDataCache *);
+    };
+
+    /**
+     *  Meshes are loaded with the given options. Their memory resource must outlive the meshes.
+     *  The cache ignores lazyAnimations, because it counts a mesh's bytes once, when it's loaded.
+     */
+    MeshDataCache *CreateMeshDataCache(const size_t maxBytes, const MeshLoadOptions &options = MeshLoadOptions());
+
+    /**
+     *  Waits for the loads that are going on. Handles to the cached meshes remain valid.
+     */
+    void DestroyMeshDataCache(MeshDataCache *);
+}
+
+#endif  // DATACACHE_H
@@ -0,0 +1,116 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "skeleton.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  One vertex per face corner, ready to be copied to a vertex buffer.
+     */
+    struct MeshBufferVertex
+    {
+        vec3 position,
+             normal,
+             tangent;
+        MeshTexCoords texCoords;
+    };
+
+    typedef unsigned int MeshBufferIndex;
+
+    /**
+     *  Evaluates whole frames of one skeleton: samples the pose, skins the vertices and
+     *  their normals and fills a vertex buffer with it. Every buffer it needs is allocated
+     *  when it's created, so evaluating a frame doesn't touch the heap.
+     *
+     *  The buffer has one vertex per face corner, faces in MeshData order. Quads are split
+     *  into two triangles by the indices. Smooth faces get the skinned vertex normals,
+     *  the other faces get normals calculated from the skinned corner positions.
+     */
+    class MeshFrameEvaluator
+    {
+        private:
+            const MeshSkeleton *pSkeleton;
+            MeshSkinningMode mode;
+
+            std::vector<MeshBoneTransformation> pose;
+            std::vector<MeshBonePaletteEntry> palette;
+            std::vector<vec3> positions,
+                              normals,
+                              tangents;
+
+            // Per face: where its corners start, whether it's smooth. One more offset than faces.
+            std::vector<size_t> faceCornerOffsets;
+            std::vector<bool> smoothFaces;
+
+            // Per corner, in buffer order.
+            std::vector<size_t> cornerVertexIndices;
+            std::vector<MeshTexCoords> cornerTexCoords;
+
+            size_t countIndices;
+
+            MeshFrameEvaluator(void);
+            ~MeshFrameEvaluator(void);
+
+            MeshFrameEvaluator(const MeshFrameEvaluator &) = delete;
+            void operator=(const MeshFrameEvaluator &) = delete;
+
+            void FillBuffer(MeshBufferVertex *verticesOut) const;
+        public:
+            const MeshSkeleton *GetSkeleton(void) const;
+            MeshSkinningMode GetMode(void) const;
+
+            size_t CountBufferVertices(void) const;
+            size_t CountBufferIndices(void) const;
+
+        friend MeshFrameEvaluator *CreateMeshFrameEvaluator(const MeshSkeleton *, const MeshSkinningMode);
+        friend void DestroyMeshFrameEvaluator(MeshFrameEvaluator *);
+        friend void GetBufferIndices(const MeshFrameEvaluator *, MeshBufferIndex *);
+        friend void EvaluateFrame(MeshFrameEvaluator *, const MeshBoneTransformation *, MeshBufferVertex *);
+        friend void EvaluateFrame(MeshFrameEvaluator *, const size_t, const milliseconds, const float, const bool,
+                                  MeshBufferVertex *);
+    };
+
+    /**
+     *  The skeleton must be compiled with normals and must outlive the evaluator.
+     */
+    MeshFrameEvaluator *CreateMeshFrameEvaluator(const MeshSkeleton *, const MeshSkinningMode mode = MESHSKIN_LINEAR);
+    void DestroyMeshFrameEvaluator(MeshFrameEvaluator *);
+
+    /**
+     *  Writes CountBufferIndices() triangle indices. They're the same for every frame.
+     */
+    void GetBufferIndices(const MeshFrameEvaluator *, MeshBufferIndex *indicesOut);
+
+    /**
+     *  Writes CountBufferVertices() vertices for the given pose, one transformation per bone.
+     */
+    void EvaluateFrame(MeshFrameEvaluator *, const MeshBoneTransformation *pose, MeshBufferVertex *verticesOut);
+
+    /**
+     *  Writes CountBufferVertices() vertices for the given time in the animation.
+     */
+    void EvaluateFrame(MeshFrameEvaluator *, const size_t animationIndex,
+                       const milliseconds msSinceStart, const float framesPerSecond, const bool loop,
+                       MeshBufferVertex *verticesOut);
+}
+
+#endif  // FRAME_H
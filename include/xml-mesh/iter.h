@@ -19,12 +19,118 @@
 #define ITER_H
 
 #include <iterator>
+#include <memory_resource>
 #include <set>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 
 namespace XMLMesh
 {
+    /**
+     *  Ids in a mesh are interned, so two views of the same id usually have the same pointer.
+     */
+    struct MeshIDEqual
+    {
+        bool operator()(const std::string_view &a, const std::string_view &b) const
+        {
+            return (a.data() == b.data() && a.size() == b.size()) || a == b;
+        }
+    };
+
+    /**
+     *  The keys point into the mesh's interned ids, so they're only stored once.
+     *  Lookups take a string_view, so they don't need to build a string.
+     */
+    template <typename V>
+    using MeshIDMap = std::pmr::unordered_map<std::string_view, V *, std::hash<std::string_view>, MeshIDEqual>;
+
+    template <typename T>
+    using MeshPointerSet = std::pmr::set<T *>;
+
+    /**
+     *  True if the id is a decimal number without leading zeros, like the exporter
+     *  writes vertex and face ids. "01" isn't, because it's a different id than "1".
+     */
+    inline bool ParseIDNumber(const std::string_view id, size_t &number)
+    {
+        if (id.empty() || id.size() > 18 || (id[0] == '0' && id.size() > 1))
+            return false;
+
+        number = 0;
+        for (const char c : id)
+        {
+            if (c < '0' || c > '9')
+                return false;
+
+            number = number * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    /**
+     *  Exported meshes number their vertices and faces 0, 1, 2, ... As long as every id
+     *  added is such a number, no higher than the count so far (or the reserved count),
+     *  objects are found by indexing an array instead of hashing the id.
+     *  The first id that doesn't fit turns the index off for good, and lookups go
+     *  to the hashed map again.
+     */
+    template <typename T>
+    class MeshDenseIDIndex
+    {
+        private:
+            bool dense;
+            std::pmr::vector<T *> objectPs;  // NULL for numbers no object has (yet)
+        public:
+            MeshDenseIDIndex(std::pmr::memory_resource *pResource)
+            : dense(true), objectPs(pResource) {}
+
+            bool IsDense(void) const { return dense; }
+
+            void Reserve(const size_t count)
+            {
+                if (dense && count > objectPs.size())
+                    objectPs.resize(count, NULL);
+            }
+
+            void Add(const std::string_view id, T *p)
+            {
+                if (!dense)
+                    return;
+
+                size_t number;
+                if (!ParseIDNumber(id, number) || number > objectPs.size())
+                {
+                    dense = false;
+                    std::pmr::vector<T *>(objectPs.get_allocator()).swap(objectPs);
+                }
+                else if (number == objectPs.size())
+                    objectPs.push_back(p);
+                else
+                    objectPs[number] = p;
+            }
+
+            // NULL if there's no such object.
+            T *Find(const std::string_view id, const MeshIDMap<T> &mFallback) const
+            {
+                if (dense)
+                {
+                    size_t number;
+                    if (ParseIDNumber(id, number) && number < objectPs.size())
+                        return objectPs[number];
+                    else
+                        return NULL;
+                }
+
+                auto it = mFallback.find(id);
+                if (it != mFallback.end())
+                    return std::get<1>(*it);
+                else
+                    return NULL;
+            }
+    };
+
     template<typename T>
     class ConstArrayIterable
     {
@@ -45,9 +151,9 @@ namespace XMLMesh
     class ConstSetIterator
     {
         private:
-            typename std::set<T *>::const_iterator it;
+            typename MeshPointerSet<T>::const_iterator it;
         public:
-            ConstSetIterator(typename std::set<T *>::const_iterator _it)
+            ConstSetIterator(typename MeshPointerSet<T>::const_iterator _it)
             : it(_it) {}
             ConstSetIterator(const ConstSetIterator<T> &other)
             : it(other.it) {}
@@ -66,7 +172,7 @@ namespace XMLMesh
         private:
             ConstSetIterator<T> mBegin, mEnd;
         public:
-            ConstSetIterable(const std::set<T *> &s)
+            ConstSetIterable(const MeshPointerSet<T> &s)
             : mBegin(s.cbegin()), mEnd(s.cend()) {}
 
             ConstSetIterator<T> begin(void) { return mBegin; }
@@ -77,9 +183,9 @@ namespace XMLMesh
     class ConstMapValueIterator
     {
         private:
-            typename std::unordered_map<std::string, V *>::const_iterator it;
+            typename MeshIDMap<V>::const_iterator it;
         public:
-            ConstMapValueIterator(typename std::unordered_map<std::string, V *>::const_iterator _it)
+            ConstMapValueIterator(typename MeshIDMap<V>::const_iterator _it)
             : it(_it) {}
             ConstMapValueIterator(const ConstMapValueIterator<V> &other)
             : it(other.it) {}
@@ -98,7 +204,7 @@ namespace XMLMesh
         private:
             ConstMapValueIterator<V> mBegin, mEnd;
         public:
-            ConstMapValueIterable(const std::unordered_map<std::string, V *> &m)
+            ConstMapValueIterable(const MeshIDMap<V> &m)
             : mBegin(m.cbegin()), mEnd(m.cend()) {}
 
             ConstMapValueIterator<V> begin(void) { return mBegin; }
@@ -109,9 +215,9 @@ namespace XMLMesh
     class MapValueIterator
     {
         private:
-            typename std::unordered_map<std::string, V *>::const_iterator it;
+            typename MeshIDMap<V>::const_iterator it;
         public:
-            MapValueIterator(typename std::unordered_map<std::string, V *>::const_iterator _it)
+            MapValueIterator(typename MeshIDMap<V>::const_iterator _it)
             : it(_it) {}
             MapValueIterator(const MapValueIterator<V> &other)
             : it(other.it) {}
@@ -130,7 +236,7 @@ namespace XMLMesh
         private:
             MapValueIterator<V> mBegin, mEnd;
         public:
-            MapValueIterable(const std::unordered_map<std::string, V *> &m)
+            MapValueIterable(const MeshIDMap<V> &m)
             : mBegin(m.cbegin()), mEnd(m.cend()) {}
 
             MapValueIterator<V> begin(void) { return mBegin; }
@@ -0,0 +1,253 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mesh.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Thrown by a load that was cancelled, after everything it built has been freed.
+     */
+    class MeshLoadCancelled: public MeshError
+    {
+        public:
+            MeshLoadCancelled(void);
+    };
+
+
+    typedef std::function<void (void)> MeshTask;
+
+    /**
+     *  Must run every task it's given exactly once, on any thread.
+     */
+    typedef std::function<void (MeshTask)> MeshExecutor;
+
+    /**
+     *  Runs tasks on a fixed number of threads, in the order they were submitted.
+     *  The destructor waits for the submitted tasks to finish.
+     */
+    class MeshThreadPool
+    {
+        private:
+            std::vector<std::thread> threads;
+
+            std::mutex mtx;
+            std::condition_variable taskAdded;
+            std::deque<MeshTask> tasks;
+            bool stopping;
+
+            void Work(void);
+
+            MeshThreadPool(const MeshThreadPool &) = delete;
+            void operator=(const MeshThreadPool &) = delete;
+        public:
+            // Zero means one thread per core.
+            MeshThreadPool(const size_t countThreads = 0);
+            ~MeshThreadPool(void);
+
+            size_t CountThreads(void) const;
+
+            void Submit(MeshTask);
+
+            // Submits to this pool, which must outlive the executor.
+            MeshExecutor GetExecutor(void);
+    };
+
+    /**
+     *  A pool with one thread per core, started on first use and shared by all loads
+     *  that don't get an executor of their own.
+     */
+    MeshExecutor GetDefaultMeshExecutor(void);
+
+
+    enum MeshLoadPhase
+    {
+        MESHLOAD_QUEUED,
+        MESHLOAD_READING,
+        MESHLOAD_SCANNING,     // with the library's own scanner
+        MESHLOAD_PARSING_XML,  // with libxml2
+        MESHLOAD_BUILDING,
+        MESHLOAD_FINISHED
+    };
+
+    /**
+     *  Bytes of the document that the phase has gotten through. The total is zero
+     *  while it's unknown, like when reading from a stream that can't seek.
+     */
+    struct MeshLoadProgress
+    {
+        MeshLoadPhase phase;
+        size_t bytesDone,
+               bytesTotal;
+    };
+
+    typedef std::function<void (const MeshLoadProgress &)> MeshProgressCallback;
+
+    struct MeshLoadOptions
+    {
+        // Like the arguments of ParseMeshData.
+        std::pmr::memory_resource *pResource = std::pmr::get_default_resource();
+        bool useScanner = true;
+        size_t countThreads = 0;
+
+        /**
+         *  For loads from a file: only the ids and lengths of the animations are read with
+         *  the mesh. Their layers and keys are read from the file when they're first used,
+         *  (see MeshData::GetAnimation) so the file must not change while the mesh exists.
+         *  If it does, its animations throw a MeshParseError instead. A relative path is
+         *  resolved when the mesh is loaded, so the working directory may change afterwards.
+         *  The memory resource must then also allow allocations from those threads.
+         *  Documents that the scanner doesn't handle are loaded with all their animations.
+         *  A MeshDataCache always loads all animations.
+         */
+        bool lazyAnimations = false;
+
+        /**
+         *  Called by the loading threads, one call at a time, whenever the phase changes
+         *  and every 64 KiB within a phase. It must not block for long.
+         */
+        MeshProgressCallback onProgress;
+
+        // Empty for the default executor.
+        MeshExecutor executor;
+    };
+
+    class MeshLoadState;
+
+    /**
+     *  Follows a load that's running on an executor. Dropping the handle doesn't cancel it.
+     */
+    class MeshLoadHandle
+    {
+        private:
+            std::shared_ptr<MeshLoadState> pState;
+            std::future<MeshData *> future;
+        public:
+            MeshLoadHandle(std::shared_ptr<MeshLoadState>, std::future<MeshData *> &&);
+
+            /**
+             *  The load stops at its next check, frees what it built and makes the future
+             *  throw MeshLoadCancelled. A load that has already finished isn't affected.
+             */
+            void Cancel(void);
+
+            MeshLoadProgress GetProgress(void) const;
+
+            /**
+             *  Gives the MeshData object, which the caller must destroy,
+             *  or throws the error that the load ran into.
+             */
+            std::future<MeshData *> &GetFuture(void);
+    };
+
+    /**
+     *  Like ParseMeshData, but on the options' executor. The stream is read there,
+     *  so it must stay valid until the future is ready.
+     */
+    MeshLoadHandle ParseMeshDataAsync(std::istream &, const MeshLoadOptions &options = MeshLoadOptions());
+
+    /**
+     *  Opens the file on the executor. A file that can't be opened gives a MeshParseError.
+     */
+    MeshLoadHandle ParseMeshDataAsync(const std::string &path, const MeshLoadOptions &options = MeshLoadOptions());
+
+    /**
+     *  Loads on the calling thread, with the options' progress callback.
+     *  Animations are loaded with the mesh, since there's no file to read them from later.
+     */
+    MeshData *ParseMeshData(std::istream &, const MeshLoadOptions &);
+
+    /**
+     *  Loads on the calling thread, with the options' progress callback.
+     *  A file that can't be opened gives a MeshParseError.
+     */
+    MeshData *ParseMeshFile(const std::string &path, const MeshLoadOptions &options = MeshLoadOptions());
+
+
+    struct MeshBatchOptions
+    {
+        std::pmr::memory_resource *pResource = std::pmr::get_default_resource();
+        bool useScanner = true;
+
+        // Files parsed at the same time, each on one thread. Zero means one per core.
+        size_t countThreads = 0;
+
+        // Like in MeshLoadOptions.
+        bool lazyAnimations = false;
+
+        /**
+         *  Files read ahead of the parsers. This bounds the memory taken by documents
+         *  that are waiting to be parsed. Zero means two per parsing thread.
+         */
+        size_t countPrefetched = 0;
+    };
+
+    struct MeshBatchResult
+    {
+        std::string path;
+
+        // NULL if the file couldn't be loaded. Otherwise, the caller must destroy it.
+        MeshData *pMeshData;
+
+        // Rethrow it to see why the file couldn't be loaded.
+        std::exception_ptr error;
+
+        size_t countBytes;
+    };
+
+    struct MeshBatchStats
+    {
+        size_t countFiles,
+               countFailed,
+               countBytes;
+
+        // From the first read to the last parse.
+        double seconds,
+
+        // How long the reading thread was busy, reading files.
+               readSeconds;
+
+        double filesPerSecond,
+               bytesPerSecond;
+    };
+
+    /**
+     *  Reads the files, one after the other, on the calling thread and parses them
+     *  on a pool of its own while the next ones are being read.
+     *  The results are in the same order as the paths. An error in one file
+     *  doesn't stop the others from loading.
+     */
+    std::vector<MeshBatchResult> ParseMeshFiles(const std::vector<std::string> &paths,
+                                                const MeshBatchOptions &options = MeshBatchOptions(),
+                                                MeshBatchStats *pStats = NULL);
+}
+
+#endif  // LOAD_H
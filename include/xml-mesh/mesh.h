@@ -17,9 +17,12 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <iostream>
 #include <iterator>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <set>
 #include <unordered_map>
@@ -36,6 +39,9 @@ using namespace glm;
 
 #define HAS_ID(map, id) (map.find(id) != map.end())
 
+// Ids are string_views, so they're formatted with "%.*s".
+#define ID_FORMAT_ARGS(id) (int)(id).size(), (id).data()
+
 #define ERRORBUF_SIZE 1024
 
 namespace XMLMesh
@@ -70,9 +76,14 @@ namespace XMLMesh
 
     class MeshData;
     class MeshState;
+    class MeshSkinningTable;
     class MeshVertex;
     class MeshFace;
     class MeshBone;
+    class MeshMemoryAccounts;
+    struct MeshMemoryUsage;
+    class MeshIDPool;
+    class MeshLazyAnimations;
 
     typedef vec2 MeshTexCoords;
 
@@ -109,14 +120,14 @@ namespace XMLMesh
     class MeshVertex
     {
         private:
-            std::string id;
+            std::string_view id;  // interned, NUL-terminated
 
             vec3 position;  // in mesh space
 
-            std::set<MeshCorner *> cornersInvolvedPs;
-            std::set<MeshBone *> bonesPullingPs;
+            MeshPointerSet<MeshCorner> cornersInvolvedPs;
+            MeshPointerSet<MeshBone> bonesPullingPs;
 
-            MeshVertex(void);
+            MeshVertex(MeshMemoryAccounts *);
             ~MeshVertex(void);
 
             MeshVertex(const MeshVertex &) = delete;
@@ -127,6 +138,7 @@ namespace XMLMesh
             void SetPosition(const vec3 &);
             ConstSetIterable<MeshCorner> IterCorners(void) const;
             ConstSetIterable<MeshBone> IterBones(void) const;
+            size_t CountBones(void) const;
 
         friend class MeshDataBuilder;
         friend class MeshStateBuilder;
@@ -138,12 +150,12 @@ namespace XMLMesh
     class MeshFace
     {
         private:
-            std::string id;
+            std::string_view id;  // interned, NUL-terminated
             bool smooth;
-            MeshCorner *mCorners;
+            MeshCorner *mCorners;  // allocated from the same memory resource as the face
             size_t countCorners;
         protected:
-            MeshFace(const size_t numberOfCorners);
+            MeshFace(const size_t numberOfCorners, MeshMemoryAccounts *);
             ~MeshFace(void);
 
             MeshFace(const MeshFace &) = delete;
@@ -168,7 +180,7 @@ namespace XMLMesh
     class MeshTriangleFace: public MeshFace
     {
         private:
-            MeshTriangleFace(void);
+            MeshTriangleFace(MeshMemoryAccounts *);
 
             MeshTriangleFace(const MeshTriangleFace &) = delete;
             void operator=(const MeshTriangleFace &) = delete;
@@ -182,7 +194,7 @@ namespace XMLMesh
     class MeshQuadFace: public MeshFace
     {
         private:
-            MeshQuadFace(void);
+            MeshQuadFace(MeshMemoryAccounts *);
 
             MeshQuadFace(const MeshQuadFace &) = delete;
             void operator=(const MeshQuadFace &) = delete;
@@ -197,8 +209,10 @@ namespace XMLMesh
     class MeshSubset
     {
         private:
-            std::string id;
-            std::set<MeshFace *> facePs;
+            std::string_view id;  // interned, NUL-terminated
+            MeshPointerSet<MeshFace> facePs;
+
+            MeshSubset(MeshMemoryAccounts *);
         public:
             const char *GetID(void) const;
             ConstSetIterable<MeshFace> IterFaces(void) const;
@@ -212,16 +226,16 @@ namespace XMLMesh
     class MeshBone
     {
         private:
-            std::string id;
+            std::string_view id;  // interned, NUL-terminated
 
             MeshBone *pParent;  // can be null
 
             vec3 headPosition;  // in mesh space
             float weight;
 
-            std::set<MeshVertex *> vertexPs;
+            MeshPointerSet<MeshVertex> vertexPs;
 
-            MeshBone(void);
+            MeshBone(MeshMemoryAccounts *);
             ~MeshBone(void);
 
             MeshBone(const MeshBone &) = delete;
@@ -266,7 +280,9 @@ namespace XMLMesh
     {
         MeshBone *pBone;
 
-        std::unordered_map<size_t, MeshBoneKey> mKeys;
+        std::pmr::unordered_map<size_t, MeshBoneKey> mKeys;
+
+        MeshBoneLayer(std::pmr::memory_resource *);
     };
 
 
@@ -276,11 +292,14 @@ namespace XMLMesh
      */
     struct MeshSkeletalAnimation
     {
-        std::string id;
+        std::string_view id;  // interned in the MeshData object, NUL-terminated
 
         size_t length;
 
-        std::unordered_map<std::string, MeshBoneLayer> mLayers;
+        // The keys are the interned ids of the bones.
+        std::pmr::unordered_map<std::string_view, MeshBoneLayer, std::hash<std::string_view>, MeshIDEqual> mLayers;
+
+        MeshSkeletalAnimation(std::pmr::memory_resource *);
     };
 
 
@@ -288,48 +307,89 @@ namespace XMLMesh
     /**
      *  In principle, one can render meshes using a MeshData object only.
      *  For using the animations however, you'll need to derive a MeshState object.
+     *
+     *  Everything in it, including the object itself, is allocated from one memory resource.
      */
     class MeshData
     {
         private:
-            std::unordered_map<std::string, MeshVertex *> mVertices;
-            std::unordered_map<std::string, MeshFace *> mFaces;
-            std::unordered_map<std::string, MeshSubset *> mSubsets;
-            std::unordered_map<std::string, MeshBone *> mBones;
-            std::unordered_map<std::string, MeshSkeletalAnimation *> mAnimations;
-
-            MeshData(void);
+            std::pmr::memory_resource *pResource;
+            MeshMemoryAccounts *pAccounts;  // for GetMemoryUsage
+            MeshIDPool *pIDPool;
+
+            MeshIDMap<MeshVertex> mVertices;
+            MeshIDMap<MeshFace> mFaces;
+            MeshDenseIDIndex<MeshVertex> denseVertices;  // for looking up numbered ids
+            MeshDenseIDIndex<MeshFace> denseFaces;
+            MeshIDMap<MeshSubset> mSubsets;
+            MeshIDMap<MeshBone> mBones;
+            MeshIDMap<MeshSkeletalAnimation> mAnimations;
+            MeshLazyAnimations *pLazyAnimations;  // NULL unless all animations were loaded with the mesh
+
+            // Unlike its address, no other MeshData object gets the same serial number.
+            uint64_t serial;
+
+            MeshData(std::pmr::memory_resource *, MeshMemoryAccounts *);
             ~MeshData(void);
 
             MeshData(const MeshData &) = delete;
             void operator=(const MeshData &) = delete;
         public:
-            bool HasVertex(const std::string &id) const;
-            const MeshVertex *GetVertex(const std::string &id) const;
+            bool HasVertex(const std::string_view id) const;
+            const MeshVertex *GetVertex(const std::string_view id) const;
             ConstMapValueIterable<MeshVertex> IterVertices(void) const;
 
-            bool HasFace(const std::string &id) const;
-            const MeshFace *GetFace(const std::string &id) const;
+            bool HasFace(const std::string_view id) const;
+            const MeshFace *GetFace(const std::string_view id) const;
             ConstMapValueIterable<MeshFace> IterFaces(void) const;
 
-            bool HasSubset(const std::string &id) const;
-            const MeshSubset *GetSubset(const std::string &id) const;
+            bool HasSubset(const std::string_view id) const;
+            const MeshSubset *GetSubset(const std::string_view id) const;
             ConstMapValueIterable<MeshSubset> IterSubsets(void) const;
 
-            bool HasBone(const std::string &id) const;
-            const MeshBone *GetBone(const std::string &id) const;
+            bool HasBone(const std::string_view id) const;
+            const MeshBone *GetBone(const std::string_view id) const;
             ConstMapValueIterable<MeshBone> IterBones(void) const;
 
-            bool HasAnimation(const std::string &id) const;
-            const MeshSkeletalAnimation *GetAnimation(const std::string &id) const;
+            /**
+             *  For meshes that were loaded with lazy animations, (see MeshLoadOptions in load.h)
+             *  GetAnimation reads the animation's layers and keys from the file, if they haven't
+             *  been yet. IterAnimations and PreloadAnimations read all of them. Other threads may
+             *  use the mesh meanwhile. Errors in the animation are thrown then, and not earlier.
+             */
+            bool HasAnimation(const std::string_view id) const;
+            const MeshSkeletalAnimation *GetAnimation(const std::string_view id) const;
+            ConstMapValueIterable<MeshSkeletalAnimation> IterAnimations(void) const;
+            bool IsAnimationLoaded(const std::string_view id) const;
+            void PreloadAnimations(void) const;
 
             std::tuple<size_t, size_t> CountQuadsTriangles(void) const;
 
+            std::pmr::memory_resource *GetMemoryResource(void) const;
+
         friend class MeshDataBuilder;
         friend void DestroyMeshData(MeshData *);
+        friend MeshMemoryUsage GetMemoryUsage(const MeshData *);
+        friend void ApplyBoneTransformations(const MeshData *,
+                                             const std::unordered_map<std::string, MeshBoneTransformation> &,
+                                             MeshState *);
     };
 
-    MeshData *ParseMeshData(std::istream &);
+    /**
+     *  The resource must outlive the MeshData object. With a monotonic resource, it's fine
+     *  to release the resource instead of calling DestroyMeshData.
+     *
+     *  The document is read into memory first. With the scanner, documents that only use the
+     *  tags and attributes of the format are read without building an xml tree.
+     *  Anything else is parsed by libxml2, on its own heap, and freed before this returns.
+     *  Both give the same MeshData object, or the same error.
+     *
+     *  Large documents are scanned by 'countThreads' threads, or by one thread per core
+     *  if that is zero. The ids are still resolved by the calling thread.
+     */
+    MeshData *ParseMeshData(std::istream &,
+                            std::pmr::memory_resource *pResource = std::pmr::get_default_resource(),
+                            const bool useScanner = true, const size_t countThreads = 0);
     void DestroyMeshData(MeshData *);
 
 
@@ -340,44 +400,60 @@ namespace XMLMesh
     class MeshState
     {
         private:
-            std::unordered_map<std::string, MeshVertex *> mVertices;
-            std::unordered_map<std::string, MeshFace *> mFaces;
-            std::unordered_map<std::string, MeshSubset *> mSubsets;
+            std::pmr::memory_resource *pResource;
+            MeshMemoryAccounts *pAccounts;  // for GetMemoryUsage
+            MeshIDPool *pIDPool;
+
+            MeshIDMap<MeshVertex> mVertices;
+            MeshIDMap<MeshFace> mFaces;
+            MeshDenseIDIndex<MeshVertex> denseVertices;  // for looking up numbered ids
+            MeshDenseIDIndex<MeshFace> denseFaces;
+            MeshIDMap<MeshSubset> mSubsets;
 
-            MeshState(void);
+            MeshSkinningTable *pSkinningTable;  // compiled on first use
+            uint64_t skinningSerial;  // of the MeshData object that the table was compiled from
+
+            MeshState(std::pmr::memory_resource *, MeshMemoryAccounts *);
             MeshState(const MeshState &);
             ~MeshState(void);
         public:
-            bool HasVertex(const std::string &id) const;
-            MeshVertex *GetVertex(const std::string &id);
-            const MeshVertex *GetVertex(const std::string &id) const;
+            bool HasVertex(const std::string_view id) const;
+            MeshVertex *GetVertex(const std::string_view id);
+            const MeshVertex *GetVertex(const std::string_view id) const;
             ConstMapValueIterable<MeshVertex> IterVertices(void) const;
             MapValueIterable<MeshVertex> IterVertices(void);
 
-            bool HasFace(const std::string &id) const;
-            const MeshFace *GetFace(const std::string &id) const;
+            bool HasFace(const std::string_view id) const;
+            const MeshFace *GetFace(const std::string_view id) const;
             ConstMapValueIterable<MeshFace> IterFaces(void) const;
 
-            bool HasSubset(const std::string &id) const;
-            const MeshSubset *GetSubset(const std::string &id) const;
+            bool HasSubset(const std::string_view id) const;
+            const MeshSubset *GetSubset(const std::string_view id) const;
             ConstMapValueIterable<MeshSubset> IterSubsets(void) const;
 
             std::tuple<size_t, size_t> CountQuadsTriangles(void) const;
 
+            std::pmr::memory_resource *GetMemoryResource(void) const;
+
         friend class MeshStateBuilder;
         friend void DestroyMeshState(MeshState *);
+        friend MeshMemoryUsage GetMemoryUsage(const MeshState *);
         friend void ApplyBoneTransformations(const MeshData *,
                                              const std::unordered_map<std::string, MeshBoneTransformation> &,
                                              MeshState *);
     };
 
-    MeshState *DeriveMeshState(const MeshData *);
+    /**
+     *  Like ParseMeshData, everything is allocated from the given resource.
+     */
+    MeshState *DeriveMeshState(const MeshData *,
+                               std::pmr::memory_resource *pResource = std::pmr::get_default_resource());
     void DestroyMeshState(MeshState *);
 
 
     typedef unsigned long long milliseconds;
 
-    void GetBoneTransformationsAt(const MeshData *, const std::string &animationID,
+    void GetBoneTransformationsAt(const MeshData *, const std::string_view animationID,
                                   const milliseconds msSinceStart, const float framesPerSecond, const bool loop,
                                   std::unordered_map<std::string, MeshBoneTransformation> &);
 
@@ -385,6 +461,10 @@ namespace XMLMesh
 
     /**
      * Must use a MeshState object, derived from the given MeshData object.
+     *
+     * The first call compiles a skinning table for the pair and keeps it in the MeshState,
+     * so later calls don't look up vertex ids. Vertices that no bone pulls at are left in
+     * their rest position.
      */
     void ApplyBoneTransformations(const MeshData *,
                                   const std::unordered_map<std::string, MeshBoneTransformation> &,
@@ -401,7 +481,7 @@ namespace XMLMesh
      *  for smooth shading
      */
     vec3 CalculateVertexNormal(const MeshVertex *);
-    std::tuple<vec3, vec3> CalculateVertexTangentBiTangent(const MeshVertex *);
+    std::tuple<vec3, vec3> CalculateVertexTangentBitangent(const MeshVertex *);
 
     /*
      * One can flip the normals by taking their negatives. Otherwise,
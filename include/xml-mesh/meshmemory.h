@@ -0,0 +1,98 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef MESHMEMORY_H
+#define MESHMEMORY_H
+
+#include <atomic>
+#include <memory_resource>
+
+#include "mesh.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Passes allocations on to another memory resource, while counting the bytes.
+     *  Give one to ParseMeshData or DeriveMeshState to see what a mesh costs,
+     *  or wrap a monotonic or pool resource to see how full it gets.
+     *
+     *  The counters are atomic, so it may be shared between threads if the upstream resource may.
+     */
+    class MeshCountingResource: public std::pmr::memory_resource
+    {
+        private:
+            std::pmr::memory_resource *pUpstream;
+
+            std::atomic<size_t> bytesInUse,
+                                peakBytesInUse,
+                                totalBytesAllocated,
+                                countAllocations,
+                                countDeallocations;
+        protected:
+            void *do_allocate(size_t bytes, size_t alignment) override;
+            void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+            bool do_is_equal(const std::pmr::memory_resource &) const noexcept override;
+        public:
+            MeshCountingResource(std::pmr::memory_resource *pUpstream = std::pmr::get_default_resource());
+
+            MeshCountingResource(const MeshCountingResource &) = delete;
+            void operator=(const MeshCountingResource &) = delete;
+
+            std::pmr::memory_resource *GetUpstream(void) const;
+
+            // Requested bytes, not counting the upstream resource's own overhead.
+            size_t GetBytesInUse(void) const;
+            size_t GetPeakBytesInUse(void) const;
+            size_t GetTotalBytesAllocated(void) const;
+
+            size_t CountAllocations(void) const;
+            size_t CountDeallocations(void) const;
+
+            // Sets the peak back to the bytes in use and the totals to zero.
+            void ResetCounts(void);
+    };
+
+    /**
+     *  The bytes that a MeshData or MeshState object got from its memory resource,
+     *  by what they're used for. Together, they're exactly what the resource gave it.
+     *
+     *  Every distinct id is stored once, in the mesh's id pool, however many objects share it.
+     *  The pool counts under ids as a whole: the characters, with the unused room at the end
+     *  of its last block, and the set that finds them.
+     */
+    struct MeshMemoryUsage
+    {
+        size_t vertexBytes,     // the vertex objects
+               faceBytes,       // the face objects and their corners
+               adjacencyBytes,  // the corners and bones of each vertex, the vertices of each bone
+               idBytes,         // of vertices, faces, subsets, bones and animations
+               subsetBytes,     // the subset objects and their faces
+               boneBytes,       // the bone objects
+               animationBytes,  // animations with their layers and keys
+               hashTableBytes,  // nodes and buckets of the maps that find objects by id
+               skinningBytes,   // the skinning table that ApplyBoneTransformations compiles, with its skeleton
+               objectBytes;     // the MeshData or MeshState object itself, plus this bookkeeping
+
+        size_t GetTotal(void) const;
+    };
+
+    MeshMemoryUsage GetMemoryUsage(const MeshData *);
+    MeshMemoryUsage GetMemoryUsage(const MeshState *);
+}
+
+#endif  // MESHMEMORY_H
@@ -0,0 +1,224 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <vector>
+#include <cstdint>
+#include <memory_resource>
+
+#include "mesh.h"
+
+
+#define MESHBONE_NO_PARENT SIZE_MAX
+
+// Vertices with more influences than this are skinned by a generic loop.
+#define MESHSKIN_MAX_FIXED_INFLUENCES 4
+
+namespace XMLMesh
+{
+    /**
+     *  A bone transformation in mesh space, with the transformations of all
+     *  parent bones already applied to it:
+     *
+     *      position_out = rotation * position_in + translation
+     */
+    struct MeshBonePaletteEntry
+    {
+        quat rotation;
+        vec3 translation;
+    };
+
+    /**
+     *  One bone pulling at a vertex. The weights of a vertex's influences add up to 1.0.
+     */
+    struct MeshSkinInfluence
+    {
+        size_t boneIndex;
+        float weight;
+    };
+
+    struct MeshSkeletonLayer
+    {
+        size_t boneIndex;
+
+        // Sorted by frame number.
+        std::vector<size_t> keyFrames;
+        std::vector<MeshBoneTransformation> keyTransformations;
+    };
+
+    struct MeshSkeletonAnimation
+    {
+        std::string id;
+
+        size_t length;
+
+        std::vector<MeshSkeletonLayer> layers;
+    };
+
+
+    /**
+     *  A flattened copy of a MeshData object's bones, animations and vertex weights,
+     *  where everything is addressed by index instead of by id.
+     *
+     *  Bones are ordered such that parents always come before their children.
+     *  Poses and palettes are arrays with one entry per bone, in that order.
+     *
+     *  Vertices are ordered by their number of influences, so that the vertices
+     *  with the same number of influences can be skinned by one specialized loop.
+     *
+     *  The skeleton refers to the vertices and bones of the MeshData object,
+     *  so it must be destroyed before the MeshData object is.
+     */
+    class MeshSkeleton
+    {
+        private:
+            std::pmr::memory_resource *pResource;
+            const MeshData *pMeshData;
+
+            std::pmr::vector<const MeshBone *> bonePs;
+            std::pmr::vector<size_t> parentIndices;
+            std::pmr::unordered_map<std::string_view, size_t,
+                                    std::hash<std::string_view>, MeshIDEqual> mBoneIndices;
+
+            std::pmr::vector<const MeshVertex *> vertexPs;
+            std::pmr::vector<vec3> restPositions,
+                                   restNormals,
+                                   restTangents;
+            bool hasNormals;
+            std::pmr::vector<size_t> influenceOffsets;  // one more than there are vertices
+            size_t firstVertexWithInfluences[MESHSKIN_MAX_FIXED_INFLUENCES + 2];
+            std::pmr::vector<MeshSkinInfluence> influences;
+            std::pmr::unordered_map<std::string_view, size_t,
+                                    std::hash<std::string_view>, MeshIDEqual> mVertexIndices;
+
+            // The layers of the animations are on the global heap.
+            std::pmr::vector<MeshSkeletonAnimation> animations;
+            std::pmr::unordered_map<std::string_view, size_t,
+                                    std::hash<std::string_view>, MeshIDEqual> mAnimationIndices;
+
+            MeshSkeleton(std::pmr::memory_resource *);
+            ~MeshSkeleton(void);
+
+            MeshSkeleton(const MeshSkeleton &) = delete;
+            void operator=(const MeshSkeleton &) = delete;
+        public:
+            const MeshData *GetMeshData(void) const;
+
+            size_t CountBones(void) const;
+            bool HasBone(const std::string_view id) const;
+            size_t GetBoneIndex(const std::string_view id) const;
+            const MeshBone *GetBone(const size_t boneIndex) const;
+            size_t GetParentIndex(const size_t boneIndex) const;  // MESHBONE_NO_PARENT for roots
+
+            size_t CountVertices(void) const;
+            size_t GetVertexIndex(const std::string_view id) const;
+            const MeshVertex *GetVertex(const size_t vertexIndex) const;
+            ConstArrayIterable<MeshSkinInfluence> IterInfluences(const size_t vertexIndex) const;
+
+            /**
+             *  The vertices from GetFirstVertexWithInfluences(n) up to GetFirstVertexWithInfluences(n + 1)
+             *  have exactly n influences. When n is MESHSKIN_MAX_FIXED_INFLUENCES + 1, it's the first
+             *  vertex with n or more influences and the range ends at CountVertices().
+             */
+            size_t GetFirstVertexWithInfluences(const size_t countInfluences) const;
+
+            // Arrays for the skinning loops, in skeleton order.
+            const vec3 *GetRestPositions(void) const;
+            bool HasNormals(void) const;
+            const vec3 *GetRestNormals(void) const;
+            const vec3 *GetRestTangents(void) const;
+            const MeshSkinInfluence *GetInfluences(void) const;
+
+            size_t CountAnimations(void) const;
+            bool HasAnimation(const std::string_view id) const;
+            size_t GetAnimationIndex(const std::string_view id) const;
+            const MeshSkeletonAnimation *GetAnimation(const size_t animationIndex) const;
+
+        friend MeshSkeleton *CompileMeshSkeleton(const MeshData *, const bool withAnimations, const bool withNormals,
+                                                 std::pmr::memory_resource *);
+        friend void DestroyMeshSkeleton(MeshSkeleton *);
+    };
+
+    /**
+     *  Without animations, the skeleton can only be used with poses from elsewhere.
+     *  With normals, the rest normals and tangents are calculated once, so that
+     *  skinning can rotate them instead of recalculating them from the faces.
+     *
+     *  The skeleton is allocated from the resource, which must outlive it,
+     *  except for the layers of its animations.
+     */
+    MeshSkeleton *CompileMeshSkeleton(const MeshData *, const bool withAnimations = true,
+                                      const bool withNormals = false,
+                                      std::pmr::memory_resource *pResource = std::pmr::get_default_resource());
+    void DestroyMeshSkeleton(MeshSkeleton *);
+
+
+    /**
+     *  Frame number within the animation at the given time, like GetBoneTransformationsAt uses it.
+     */
+    float GetAnimationFrame(const MeshSkeleton *, const size_t animationIndex,
+                            const milliseconds msSinceStart, const float framesPerSecond, const bool loop);
+
+    /**
+     *  Fills in one transformation per bone. Bones without a layer in the animation
+     *  are set to MESHBONETRANSFORM_ID.
+     */
+    void GetSkeletonPoseAt(const MeshSkeleton *, const size_t animationIndex,
+                           const float frame, const bool loop,
+                           MeshBoneTransformation *poseOut);
+
+    /**
+     *  Converts transformations by bone id, like GetBoneTransformationsAt outputs them,
+     *  to a pose with one transformation per bone. Missing bones get MESHBONETRANSFORM_ID.
+     */
+    void GetSkeletonPose(const MeshSkeleton *,
+                         const std::unordered_map<std::string, MeshBoneTransformation> &,
+                         MeshBoneTransformation *poseOut);
+
+    /**
+     *  Converts a pose, one transformation per bone, to mesh space.
+     */
+    void GetBonePalette(const MeshSkeleton *, const MeshBoneTransformation *pose,
+                        MeshBonePaletteEntry *paletteOut);
+
+    /**
+     *  How the transformations of the bones pulling at one vertex are combined.
+     *  Dual quaternion blending keeps the volume around twisting joints, at a higher cost.
+     */
+    enum MeshSkinningMode
+    {
+        MESHSKIN_LINEAR,
+        MESHSKIN_DUAL_QUATERNION
+    };
+
+    /**
+     *  Writes one position per skeleton vertex, in skeleton order.
+     *  Vertices that no bone pulls at keep their rest position.
+     */
+    void SkinVertices(const MeshSkeleton *, const MeshBonePaletteEntry *palette, vec3 *positionsOut,
+                      const MeshSkinningMode mode = MESHSKIN_LINEAR);
+
+    /**
+     *  Like above, but also rotates the rest normals and tangents by each vertex's blended
+     *  bone rotation. The skeleton must be compiled with normals. 'tangentsOut' may be NULL.
+     */
+    void SkinVertices(const MeshSkeleton *, const MeshBonePaletteEntry *palette, vec3 *positionsOut,
+                      vec3 *normalsOut, vec3 *tangentsOut, const MeshSkinningMode mode = MESHSKIN_LINEAR);
+}
+
+#endif  // SKELETON_H
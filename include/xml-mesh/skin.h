@@ -0,0 +1,174 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef SKIN_H
+#define SKIN_H
+
+#include "skeleton.h"
+
+
+namespace XMLMesh
+{
+    class MeshVertexAnimationCache;
+
+    /**
+     *  Everything needed to skin the vertices of one MeshState object, compiled once:
+     *  the skeleton and the MeshState vertices to write to, in skeleton order.
+     *  Skinning with it doesn't look up any ids.
+     */
+    class MeshSkinningTable
+    {
+        private:
+            std::pmr::memory_resource *pResource;
+            const MeshSkeleton *pSkeleton;
+            MeshSkeleton *pOwnedSkeleton;  // NULL if shared
+            MeshState *pMeshState;
+            MeshSkinningMode mode;
+
+            std::pmr::vector<MeshVertex *> destinationPs;
+
+            // Reused on every call, so that skinning doesn't allocate.
+            std::pmr::vector<MeshBoneTransformation> pose;
+            std::pmr::vector<MeshBonePaletteEntry> palette;
+
+            MeshSkinningTable(std::pmr::memory_resource *);
+            ~MeshSkinningTable(void);
+
+            MeshSkinningTable(const MeshSkinningTable &) = delete;
+            void operator=(const MeshSkinningTable &) = delete;
+
+            void Skin(const MeshBonePaletteEntry *palette);
+        public:
+            const MeshSkeleton *GetSkeleton(void) const;
+            MeshState *GetMeshState(void);
+            MeshSkinningMode GetMode(void) const;
+
+        friend MeshSkinningTable *CompileMeshSkinningTable(const MeshSkeleton *, MeshState *, const MeshSkinningMode,
+                                                           std::pmr::memory_resource *);
+        friend void DestroyMeshSkinningTable(MeshSkinningTable *);
+        friend void ApplyBoneTransformations(const MeshData *,
+                                             const std::unordered_map<std::string, MeshBoneTransformation> &,
+                                             MeshState *);
+        friend void ApplyBoneTransformations(MeshSkinningTable *, const MeshBoneTransformation *);
+        friend void ApplyBoneTransformations(MeshSkinningTable *,
+                                             const std::unordered_map<std::string, MeshBoneTransformation> &);
+        friend void ApplyVertexAnimation(const MeshVertexAnimationCache *, const milliseconds,
+                                         const float, MeshSkinningTable *);
+    };
+
+    /**
+     *  The MeshState must be derived from the skeleton's MeshData object.
+     *  The skeleton, the MeshState and the resource must outlive the table.
+     */
+    MeshSkinningTable *CompileMeshSkinningTable(const MeshSkeleton *, MeshState *,
+                                                const MeshSkinningMode mode = MESHSKIN_LINEAR,
+                                                std::pmr::memory_resource *pResource = std::pmr::get_default_resource());
+    void DestroyMeshSkinningTable(MeshSkinningTable *);
+
+    /**
+     *  Sets the positions of the table's MeshState vertices.
+     *  The pose has one transformation per bone, in skeleton order.
+     */
+    void ApplyBoneTransformations(MeshSkinningTable *, const MeshBoneTransformation *pose);
+    void ApplyBoneTransformations(MeshSkinningTable *,
+                                  const std::unordered_map<std::string, MeshBoneTransformation> &);
+
+
+    struct MeshIncrementalSkinStatistics
+    {
+        // Of the most recent update:
+        size_t countDirtyBones,
+               countSkinnedVertices;
+
+        // Of all updates together:
+        size_t countUpdates,
+               totalDirtyBones,
+               totalSkinnedVertices;
+    };
+
+    /**
+     *  Skins a mesh while remembering the previous pose. On every update, only the bones
+     *  whose transformation changed, plus their children, are considered dirty. Only the
+     *  vertices that dirty bones pull at get skinned again.
+     *
+     *  Useful when only some bones move, like with procedural animation or animations
+     *  for a part of the body.
+     */
+    class MeshIncrementalSkinner
+    {
+        private:
+            const MeshSkeleton *pSkeleton;
+            float tolerance;
+
+            bool hasPrevious;
+            std::vector<MeshBoneTransformation> previousPose;
+            std::vector<MeshBonePaletteEntry> palette;
+            std::vector<bool> dirtyBones;
+
+            // Which vertices each bone pulls at directly.
+            std::vector<size_t> boneVertexOffsets,  // one more than there are bones
+                                boneVertexIndices;
+
+            // Which vertices were skinned in the current update.
+            std::vector<size_t> vertexUpdates;
+            size_t countUpdates;
+
+            std::vector<vec3> positions;
+            std::vector<MeshVertex *> stateVertexPs;  // empty when there's no MeshState
+
+            MeshIncrementalSkinStatistics statistics;
+
+            MeshIncrementalSkinner(void);
+            ~MeshIncrementalSkinner(void);
+
+            MeshIncrementalSkinner(const MeshIncrementalSkinner &) = delete;
+            void operator=(const MeshIncrementalSkinner &) = delete;
+        public:
+            /**
+             *  Takes one transformation per bone. Transformations that differ less than the tolerance
+             *  from the previous update, in every component, count as unchanged.
+             */
+            void Update(const MeshBoneTransformation *pose);
+
+            /**
+             *  Forgets the previous pose, so that the next update skins every vertex.
+             */
+            void Reset(void);
+
+            /**
+             *  One position per skeleton vertex, as of the most recent update.
+             */
+            const vec3 *GetPositions(void) const;
+
+            const MeshIncrementalSkinStatistics &GetStatistics(void) const;
+            void ResetStatistics(void);
+
+        friend MeshIncrementalSkinner *CreateMeshIncrementalSkinner(const MeshSkeleton *, MeshState *,
+                                                                    const float tolerance);
+        friend void DestroyMeshIncrementalSkinner(MeshIncrementalSkinner *);
+    };
+
+    /**
+     *  The MeshState may be NULL. If given, it must be derived from the skeleton's MeshData object
+     *  and the skinner will update its vertex positions too.
+     *  Both must outlive the skinner.
+     */
+    MeshIncrementalSkinner *CreateMeshIncrementalSkinner(const MeshSkeleton *, MeshState *,
+                                                         const float tolerance = 0.0f);
+    void DestroyMeshIncrementalSkinner(MeshIncrementalSkinner *);
+}
+
+#endif  // SKIN_H
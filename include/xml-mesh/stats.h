@@ -0,0 +1,66 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+
+
+namespace XMLMesh
+{
+    /**
+     *  How much work the animation and skinning functions did.
+     */
+    struct MeshStatistics
+    {
+        uint64_t countKeysScanned,      // keys looked at while searching for the keys around a frame
+                 countExactKeys,        // bone transformations taken from a key as-is
+                 countInterpolations,   // bone transformations interpolated between two keys
+                 countBonesEvaluated,   // bone transformations converted to mesh space
+                 countParentSteps,      // steps from a bone to its parent
+                 countVerticesSkinned,
+                 countNormalsComputed,  // calculated from faces or rotated along with their vertex
+                 countBufferBytes;      // written to vertex, index and position buffers
+    };
+
+    /**
+     *  Every thread counts in its own counters, which are only summed when asked for.
+     *
+     *  Counting is off by default. Then every count costs one relaxed atomic load.
+     */
+    void EnableMeshStatistics(const bool enable);
+    bool IsMeshStatisticsEnabled(void);
+
+    /**
+     *  Summed over all threads, since the last reset. Threads that have ended are included.
+     */
+    MeshStatistics GetMeshStatistics(void);
+
+    /**
+     *  Of the calling thread only, since the last reset.
+     */
+    MeshStatistics GetThreadMeshStatistics(void);
+
+    /**
+     *  Sets all counters back to zero. Returns what GetMeshStatistics would have returned
+     *  just before, so that periodic exports don't lose the counts in between.
+     */
+    MeshStatistics ResetMeshStatistics(void);
+}
+
+#endif  // STATS_H
@@ -0,0 +1,51 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+
+
+// Zones kept per thread. When a thread records more, its oldest zones are overwritten.
+#define MESHTRACE_BUFFER_SIZE 65536
+
+namespace XMLMesh
+{
+    /**
+     *  The library's main stages (parsing, building, pose sampling, skinning, normals,
+     *  buffer filling) are marked as zones. When tracing is enabled, every thread records
+     *  the zones it runs in its own ring buffer, without locking.
+     *
+     *  Tracing is off by default. Then a zone costs one relaxed atomic load.
+     */
+    void EnableMeshTracing(const bool enable);
+    bool IsMeshTracingEnabled(void);
+
+    /**
+     *  Writes the recorded zones as Chrome trace JSON, for chrome://tracing or Perfetto.
+     *  Zones that are overwritten while writing are left out.
+     */
+    void WriteMeshTrace(std::ostream &);
+
+    /**
+     *  Forgets the zones recorded so far.
+     */
+    void ClearMeshTrace(void);
+}
+
+#endif  // TRACE_H
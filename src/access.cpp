@@ -16,6 +16,7 @@
 
 #include "mesh.h"
 #include "iter.h"
+#include "lazy.h"
 
 
 namespace XMLMesh
@@ -47,7 +48,7 @@ namespace XMLMesh
 
     const char *MeshVertex::GetID(void) const
     {
-        return id.c_str();
+        return id.data();
     }
 
     vec3 MeshVertex::GetPosition(void) const
@@ -69,6 +70,11 @@ namespace XMLMesh
         return ConstSetIterable<MeshBone>(bonesPullingPs);
     }
 
+    size_t MeshVertex::CountBones(void) const
+    {
+        return bonesPullingPs.size();
+    }
+
     ConstArrayIterable<MeshCorner> MeshFace::IterCorners(void) const
     {
         return ConstArrayIterable<MeshCorner>(mCorners, countCorners);
@@ -76,7 +82,7 @@ namespace XMLMesh
 
     const char *MeshFace::GetID(void) const
     {
-        return id.c_str();
+        return id.data();
     }
 
     bool MeshFace::IsSmooth(void) const
@@ -96,7 +102,7 @@ namespace XMLMesh
 
     const char *MeshBone::GetID(void) const
     {
-        return id.c_str();
+        return id.data();
     }
 
     bool MeshBone::HasParent(void) const
@@ -124,39 +130,42 @@ namespace XMLMesh
         return ConstSetIterable<MeshVertex>(vertexPs);
     }
 
-    bool MeshData::HasVertex(const std::string &id) const
+    bool MeshData::HasVertex(const std::string_view id) const
     {
-        return HAS_ID(mVertices, id);
+        return denseVertices.Find(id, mVertices) != NULL;
     }
-    const MeshVertex *MeshData::GetVertex(const std::string &id) const
+    const MeshVertex *MeshData::GetVertex(const std::string_view id) const
     {
-        if (!HAS_ID(mVertices, id))
-            throw MeshKeyError("No such vertex: %s", id.c_str());
+        MeshVertex *p = denseVertices.Find(id, mVertices);
+        if (p == NULL)
+            throw MeshKeyError("No such vertex: %.*s", ID_FORMAT_ARGS(id));
 
-        return mVertices.at(id);
+        return p;
     }
     ConstMapValueIterable<MeshVertex> MeshData::IterVertices(void) const
     {
         return ConstMapValueIterable<MeshVertex>(mVertices);
     }
 
-    bool MeshState::HasVertex(const std::string &id) const
+    bool MeshState::HasVertex(const std::string_view id) const
     {
-        return HAS_ID(mVertices, id);
+        return denseVertices.Find(id, mVertices) != NULL;
     }
-    MeshVertex *MeshState::GetVertex(const std::string &id)
+    MeshVertex *MeshState::GetVertex(const std::string_view id)
     {
-        if (!HAS_ID(mVertices, id))
-            throw MeshKeyError("No such vertex: %s", id.c_str());
+        MeshVertex *p = denseVertices.Find(id, mVertices);
+        if (p == NULL)
+            throw MeshKeyError("No such vertex: %.*s", ID_FORMAT_ARGS(id));
 
-        return mVertices.at(id);
+        return p;
     }
-    const MeshVertex *MeshState::GetVertex(const std::string &id) const
+    const MeshVertex *MeshState::GetVertex(const std::string_view id) const
     {
-        if (!HAS_ID(mVertices, id))
-            throw MeshKeyError("No such vertex: %s", id.c_str());
+        MeshVertex *p = denseVertices.Find(id, mVertices);
+        if (p == NULL)
+            throw MeshKeyError("No such vertex: %.*s", ID_FORMAT_ARGS(id));
 
-        return mVertices.at(id);
+        return p;
     }
     ConstMapValueIterable<MeshVertex> MeshState::IterVertices(void) const
     {
@@ -167,46 +176,48 @@ namespace XMLMesh
         return MapValueIterable<MeshVertex>(mVertices);
     }
 
-    bool MeshData::HasFace(const std::string &id) const
+    bool MeshData::HasFace(const std::string_view id) const
     {
-        return HAS_ID(mFaces, id);
+        return denseFaces.Find(id, mFaces) != NULL;
     }
-    const MeshFace *MeshData::GetFace(const std::string &id) const
+    const MeshFace *MeshData::GetFace(const std::string_view id) const
     {
-        if (!HAS_ID(mFaces, id))
-            throw MeshKeyError("No such face: %s", id.c_str());
+        MeshFace *p = denseFaces.Find(id, mFaces);
+        if (p == NULL)
+            throw MeshKeyError("No such face: %.*s", ID_FORMAT_ARGS(id));
 
-        return mFaces.at(id);
+        return p;
     }
     ConstMapValueIterable<MeshFace> MeshData::IterFaces(void) const
     {
         return ConstMapValueIterable<MeshFace>(mFaces);
     }
 
-    bool MeshState::HasFace(const std::string &id) const
+    bool MeshState::HasFace(const std::string_view id) const
     {
-        return HAS_ID(mFaces, id);
+        return denseFaces.Find(id, mFaces) != NULL;
     }
-    const MeshFace *MeshState::GetFace(const std::string &id) const
+    const MeshFace *MeshState::GetFace(const std::string_view id) const
     {
-        if (!HAS_ID(mFaces, id))
-            throw MeshKeyError("No such face: %s", id.c_str());
+        MeshFace *p = denseFaces.Find(id, mFaces);
+        if (p == NULL)
+            throw MeshKeyError("No such face: %.*s", ID_FORMAT_ARGS(id));
 
-        return mFaces.at(id);
+        return p;
     }
     ConstMapValueIterable<MeshFace> MeshState::IterFaces(void) const
     {
         return ConstMapValueIterable<MeshFace>(mFaces);
     }
 
-    bool MeshData::HasSubset(const std::string &id) const
+    bool MeshData::HasSubset(const std::string_view id) const
     {
         return HAS_ID(mSubsets, id);
     }
-    const MeshSubset *MeshData::GetSubset(const std::string &id) const
+    const MeshSubset *MeshData::GetSubset(const std::string_view id) const
     {
         if (!HAS_ID(mSubsets, id))
-            throw MeshKeyError("No such subset: %s", id.c_str());
+            throw MeshKeyError("No such subset: %.*s", ID_FORMAT_ARGS(id));
 
         return mSubsets.at(id);
     }
@@ -215,14 +226,14 @@ namespace XMLMesh
         return ConstMapValueIterable<MeshSubset>(mSubsets);
     }
 
-    bool MeshState::HasSubset(const std::string &id) const
+    bool MeshState::HasSubset(const std::string_view id) const
     {
         return HAS_ID(mSubsets, id);
     }
-    const MeshSubset *MeshState::GetSubset(const std::string &id) const
+    const MeshSubset *MeshState::GetSubset(const std::string_view id) const
     {
         if (!HAS_ID(mSubsets, id))
-            throw MeshKeyError("No such subset: %s", id.c_str());
+            throw MeshKeyError("No such subset: %.*s", ID_FORMAT_ARGS(id));
 
         return mSubsets.at(id);
     }
@@ -231,14 +242,14 @@ namespace XMLMesh
         return ConstMapValueIterable<MeshSubset>(mSubsets);
     }
 
-    bool MeshData::HasBone(const std::string &id) const
+    bool MeshData::HasBone(const std::string_view id) const
     {
         return HAS_ID(mBones, id);
     }
-    const MeshBone *MeshData::GetBone(const std::string &id) const
+    const MeshBone *MeshData::GetBone(const std::string_view id) const
     {
         if (!HAS_ID(mBones, id))
-            throw MeshKeyError("No such bone: %s", id.c_str());
+            throw MeshKeyError("No such bone: %.*s", ID_FORMAT_ARGS(id));
 
         return mBones.at(id);
     }
@@ -247,16 +258,42 @@ namespace XMLMesh
         return ConstMapValueIterable<MeshBone>(mBones);
     }
 
-    bool MeshData::HasAnimation(const std::string &id) const
+    bool MeshData::HasAnimation(const std::string_view id) const
     {
         return HAS_ID(mAnimations, id);
     }
-    const MeshSkeletalAnimation *MeshData::GetAnimation(const std::string &id) const
+    const MeshSkeletalAnimation *MeshData::GetAnimation(const std::string_view id) const
     {
         if (!HAS_ID(mAnimations, id))
-            throw MeshKeyError("No such animation: %s", id.c_str());
+            throw MeshKeyError("No such animation: %.*s", ID_FORMAT_ARGS(id));
+
+        MeshSkeletalAnimation *pAnimation = mAnimations.at(id);
+        if (pLazyAnimations != NULL)
+            pLazyAnimations->Load(const_cast<MeshData *>(this), pAnimation);
+
+        return pAnimation;
+    }
+    ConstMapValueIterable<MeshSkeletalAnimation> MeshData::IterAnimations(void) const
+    {
+        PreloadAnimations();
 
-        return mAnimations.at(id);
+        return ConstMapValueIterable<MeshSkeletalAnimation>(mAnimations);
+    }
+    bool MeshData::IsAnimationLoaded(const std::string_view id) const
+    {
+        if (!HAS_ID(mAnimations, id))
+            throw MeshKeyError("No such animation: %.*s", ID_FORMAT_ARGS(id));
+
+        return pLazyAnimations == NULL || pLazyAnimations->IsLoaded(mAnimations.at(id));
+    }
+    void MeshData::PreloadAnimations(void) const
+    {
+        if (pLazyAnimations == NULL)
+            return;
+
+        // Loading an animation only changes its own layers, not the map.
+        for (const auto &pair : mAnimations)
+            pLazyAnimations->Load(const_cast<MeshData *>(this), std::get<1>(pair));
     }
 
     std::tuple<size_t, size_t> MeshData::CountQuadsTriangles(void) const
@@ -279,6 +316,15 @@ namespace XMLMesh
                 nTriangles++;
         return std::make_tuple(nQuads, nTriangles);
     }
+    std::pmr::memory_resource *MeshData::GetMemoryResource(void) const
+    {
+        return pResource;
+    }
+    std::pmr::memory_resource *MeshState::GetMemoryResource(void) const
+    {
+        return pResource;
+    }
+
     std::tuple<size_t, size_t> MeshSubset::CountQuadsTriangles(void) const
     {
         size_t nQuads = 0, nTriangles = 0;
@@ -291,7 +337,7 @@ namespace XMLMesh
     }
     const char *MeshSubset::GetID(void) const
     {
-        return id.c_str();
+        return id.data();
     }
     ConstSetIterable<MeshFace> MeshSubset::IterFaces(void) const
     {
@@ -0,0 +1,99 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <atomic>
+#include <memory_resource>
+
+#include "meshmemory.h"
+
+
+namespace XMLMesh
+{
+    // One per field of MeshMemoryUsage, in the same order.
+    enum MeshMemoryCategory
+    {
+        MESHMEMORY_VERTICES,
+        MESHMEMORY_FACES,
+        MESHMEMORY_ADJACENCY,
+        MESHMEMORY_IDS,
+        MESHMEMORY_SUBSETS,
+        MESHMEMORY_BONES,
+        MESHMEMORY_ANIMATIONS,
+        MESHMEMORY_HASH_TABLES,
+        MESHMEMORY_SKINNING,
+        MESHMEMORY_OBJECT,
+
+        COUNT_MESHMEMORY_CATEGORIES
+    };
+
+    /**
+     *  Passes allocations on to the mesh's memory resource, counting the bytes in use.
+     */
+    class MeshAccountResource: public std::pmr::memory_resource
+    {
+        private:
+            std::pmr::memory_resource *pUpstream;
+            std::atomic<size_t> bytesInUse;
+        protected:
+            void *do_allocate(size_t bytes, size_t alignment) override
+            {
+                void *p = pUpstream->allocate(bytes, alignment);
+                bytesInUse.fetch_add(bytes, std::memory_order_relaxed);
+                return p;
+            }
+            void do_deallocate(void *p, size_t bytes, size_t alignment) override
+            {
+                pUpstream->deallocate(p, bytes, alignment);
+                bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+            }
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+            {
+                return this == &other;
+            }
+        public:
+            MeshAccountResource(std::pmr::memory_resource *p): pUpstream(p), bytesInUse(0) {}
+
+            MeshAccountResource(const MeshAccountResource &) = delete;
+            void operator=(const MeshAccountResource &) = delete;
+
+            size_t GetBytesInUse(void) const { return bytesInUse.load(std::memory_order_relaxed); }
+    };
+
+    /**
+     *  Every MeshData and MeshState object has one, allocated from its memory resource.
+     *  Each part of the mesh allocates from the account of its category.
+     */
+    class MeshMemoryAccounts
+    {
+        private:
+            MeshAccountResource accounts[COUNT_MESHMEMORY_CATEGORIES];
+        public:
+            MeshMemoryAccounts(std::pmr::memory_resource *p): accounts{p, p, p, p, p, p, p, p, p, p}
+            {
+                static_assert(COUNT_MESHMEMORY_CATEGORIES == 10, "one initializer per category");
+            }
+
+            MeshAccountResource *Get(const MeshMemoryCategory category) { return accounts + category; }
+            const MeshAccountResource *Get(const MeshMemoryCategory category) const { return accounts + category; }
+    };
+
+    MeshMemoryUsage GetMemoryUsage(const MeshMemoryAccounts *);
+}
+#endif  // ACCOUNTING_H
@@ -21,52 +21,76 @@
 
 #include "mesh.h"
 #include "build.h"
+#include "animate.h"
+#include "tracing.h"
+#include "counting.h"
 
 
 namespace XMLMesh
 {
-    MeshState *DeriveMeshState(const MeshData *pMeshData)
+    MeshState *DeriveMeshState(const MeshData *pMeshData, std::pmr::memory_resource *pResource)
     {
-        MeshStateBuilder builder;
+        MeshTraceZone zone("DeriveMeshState");
+
+        MeshStateBuilder builder(pResource);
+
+        size_t countVertices = 0, countQuads, countTriangles;
+        ConstMapValueIterable<MeshVertex> vertices = pMeshData->IterVertices();
+        for (ConstMapValueIterator<MeshVertex> it = vertices.begin(); it != vertices.end(); ++it)
+            countVertices++;
+        std::tie(countQuads, countTriangles) = pMeshData->CountQuadsTriangles();
+        builder.ReserveNumberedIDs(countVertices, countQuads + countTriangles);
 
         // First copy the vertices.
-        for (const MeshVertex *pVertex : pMeshData->IterVertices())
         {
-            builder.AddVertex(pVertex->GetID(), pVertex->GetPosition());
+            MeshTraceZone phaseZone("derive vertices");
+
+            for (const MeshVertex *pVertex : pMeshData->IterVertices())
+            {
+                builder.AddVertex(pVertex->GetID(), pVertex->GetPosition());
+            }
         }
 
         MeshTexCoords txs[4];
-        std::string vertexIDs[4];
+        std::string_view vertexIDs[4];
         size_t i;
 
         // Next copy the faces, that connect the vertices.
-        for (const MeshFace *pFace : pMeshData->IterFaces())
         {
-            if (pFace->CountCorners() > 4 || pFace->CountCorners() < 3)
-                throw MeshKeyError("face %s has %u corners", pFace->GetID(), pFace->CountCorners());
+            MeshTraceZone phaseZone("derive faces");
 
-            for (i = 0; i < pFace->CountCorners(); i++)
+            for (const MeshFace *pFace : pMeshData->IterFaces())
             {
-                txs[i] = pFace->GetCorners()[i].GetTexCoords();
-                vertexIDs[i] = pFace->GetCorners()[i].GetVertex()->GetID();
-            }
+                if (pFace->CountCorners() > 4 || pFace->CountCorners() < 3)
+                    throw MeshKeyError("face %s has %u corners", pFace->GetID(), pFace->CountCorners());
 
-            if (pFace->CountCorners() == 4)
-                builder.AddQuad(pFace->GetID(), pFace->IsSmooth(), txs, vertexIDs);
-            else if (pFace->CountCorners() == 3)
-                builder.AddTriangle(pFace->GetID(), pFace->IsSmooth(), txs, vertexIDs);
+                for (i = 0; i < pFace->CountCorners(); i++)
+                {
+                    txs[i] = pFace->GetCorners()[i].GetTexCoords();
+                    vertexIDs[i] = pFace->GetCorners()[i].GetVertex()->GetID();
+                }
+
+                if (pFace->CountCorners() == 4)
+                    builder.AddQuad(pFace->GetID(), pFace->IsSmooth(), txs, vertexIDs);
+                else if (pFace->CountCorners() == 3)
+                    builder.AddTriangle(pFace->GetID(), pFace->IsSmooth(), txs, vertexIDs);
+            }
         }
 
         // Finally copy the subset, holding the faces.
-        for (const MeshSubset *pSubset : pMeshData->IterSubsets())
         {
-            builder.AddSubset(pSubset->GetID());
-            for (const MeshFace *pFace : pSubset->IterFaces())
+            MeshTraceZone phaseZone("derive subsets");
+
+            for (const MeshSubset *pSubset : pMeshData->IterSubsets())
             {
-                if (pFace->CountCorners() == 4)
-                    builder.AddQuadToSubset(pSubset->GetID(), pFace->GetID());
-                else if (pFace->CountCorners() == 3)
-                    builder.AddTriangleToSubset(pSubset->GetID(), pFace->GetID());
+                builder.AddSubset(pSubset->GetID());
+                for (const MeshFace *pFace : pSubset->IterFaces())
+                {
+                    if (pFace->CountCorners() == 4)
+                        builder.AddQuadToSubset(pSubset->GetID(), pFace->GetID());
+                    else if (pFace->CountCorners() == 3)
+                        builder.AddTriangleToSubset(pSubset->GetID(), pFace->GetID());
+                }
             }
         }
 
@@ -130,6 +154,9 @@ namespace XMLMesh
         if (frameFirst < 0 || frameLast > animationLength)
             throw MeshKeyError("Layer has no keys");
 
+        // Both loops go over all keys.
+        CountMeshWork(MESHCOUNTER_KEYS_SCANNED, 2 * pLayer->mKeys.size());
+
         // Determine previous and next key frame.
         framePrev = INT_MIN;
         frameNext = INT_MAX;
@@ -187,10 +214,12 @@ namespace XMLMesh
             distanceToNext = float(frameNext) - frame;
     }
 
-    void GetBoneTransformationsAt(const MeshData *pMeshData, const std::string &animationID,
+    void GetBoneTransformationsAt(const MeshData *pMeshData, const std::string_view animationID,
                                   const milliseconds ms, const float framesPerSecond, const bool loop,
                                   std::unordered_map<std::string, MeshBoneTransformation> &transformationsOut)
     {
+        MeshTraceZone zone("GetBoneTransformationsAt");
+
         const MeshSkeletalAnimation *pAnimation = pMeshData->GetAnimation(animationID);
 
         float frame;
@@ -200,6 +229,7 @@ namespace XMLMesh
             frame = ClampFrame(ms, framesPerSecond, pAnimation->length);
 
         std::string boneID;
+        size_t countExactKeys = 0;
         int framePrev, frameNext;
         float distanceToPrev, distanceToNext;
         const MeshBoneLayer *pLayer;
@@ -217,6 +247,7 @@ namespace XMLMesh
             {
                 const MeshBoneKey *pKey = &(pLayer->mKeys.at(framePrev));
                 transformationsOut[boneID] = pKey->transformation;
+                countExactKeys++;
             }
             else  // Need to interpolate between two key frames.
             {
@@ -228,49 +259,10 @@ namespace XMLMesh
                                                          distanceToPrev / (distanceToPrev + distanceToNext));
             }
         }
+
+        CountMeshWork(MESHCOUNTER_EXACT_KEYS, countExactKeys);
+        CountMeshWork(MESHCOUNTER_INTERPOLATIONS, pAnimation->mLayers.size() - countExactKeys);
     }
 
     const MeshBoneTransformation MESHBONETRANSFORM_ID = {quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(0.0f)};
-
-
-    void ApplyBoneTransformations(const MeshData *pMeshData,
-                                  const std::unordered_map<std::string, MeshBoneTransformation> &boneTransformations,
-                                  MeshState *pMeshState)
-    {
-        float pullWeight;
-        vec3 transformedPosition, pivot;
-        MeshBoneTransformation t;
-        for (const MeshVertex *pVertex : pMeshData->IterVertices())
-        {
-            float sumWeight = 0.0f;
-            vec3 sumPosition(0.0f);
-
-            for (const MeshBone *pBone : pVertex->IterBones())
-            {
-                pullWeight = pBone->GetWeight();
-                transformedPosition = pVertex->GetPosition();
-
-                while (pBone != NULL)
-                {
-                    if (HAS_ID(boneTransformations, pBone->GetID()))
-                    {
-                        t = boneTransformations.at(pBone->GetID());
-
-                        pivot = pBone->GetHeadPosition();
-
-                        transformedPosition = t.rotation * (transformedPosition - pivot) + pivot + t.translation;
-                    }
-                    // else assume in rest position
-
-                    pBone = pBone->GetParent();
-                }
-
-                sumPosition += transformedPosition * pullWeight;
-                sumWeight += pullWeight;
-            }
-
-            // Average over all bones pulling directly at this vertex.
-            pMeshState->GetVertex(pVertex->GetID())->SetPosition(sumPosition / sumWeight);
-        }
-    }
 }
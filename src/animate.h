@@ -0,0 +1,292 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANIMATE_H
+#define ANIMATE_H
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mesh.h"
+#include "skeleton.h"
+#include "counting.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Converts a time to a frame number in an animation of the given length.
+     */
+    float ModulateFrame(const milliseconds ms, const float framesPerSecond, const size_t loopFrames);
+    float ClampFrame(const milliseconds ms, const float framesPerSecond, const size_t totalFrames);
+
+    /**
+     *  The number of keys in the layer at or before the given frame.
+     */
+    size_t CountKeysUntil(const MeshSkeletonLayer &, const float frame);
+
+    /**
+     *  Like PickKeyFrames + Interpolate, for a layer of which the keys until the frame have
+     *  already been counted.
+     */
+    MeshBoneTransformation SampleSkeletonLayer(const MeshSkeletonLayer &, const size_t animationLength,
+                                               const float frame, const bool loop, const size_t countKeysUntil);
+
+    /**
+     *  Weighted average of the positions that the influencing bones move the vertex to.
+     *
+     *  If pRotationOut isn't NULL, it's set to the normalized weighted average of the bone
+     *  rotations, for rotating normals.
+     */
+    inline vec3 BlendLinear(const vec3 &restPosition, const MeshSkinInfluence *influences,
+                            const size_t countInfluences, const MeshBonePaletteEntry *palette,
+                            quat *pRotationOut = NULL)
+    {
+        const quat &pivot = palette[influences[0].boneIndex].rotation;
+
+        vec3 sumPosition(0.0f);
+        quat sumRotation(0.0f, 0.0f, 0.0f, 0.0f);
+        for (size_t i = 0; i < countInfluences; i++)
+        {
+            const MeshBonePaletteEntry &entry = palette[influences[i].boneIndex];
+
+            sumPosition += influences[i].weight * (entry.rotation * restPosition + entry.translation);
+
+            // q and -q are the same rotation, take the one closest to the first bone's.
+            if (pRotationOut != NULL)
+                sumRotation = sumRotation + std::copysign(influences[i].weight, dot(pivot, entry.rotation)) * entry.rotation;
+        }
+
+        if (pRotationOut != NULL)
+            *pRotationOut = sumRotation * (1.0f / std::sqrt(dot(sumRotation, sumRotation)));
+
+        return sumPosition;
+    }
+
+    /**
+     *  Blends the bone transformations as dual quaternions and moves the vertex by the result.
+     *  Unlike linear blending, this doesn't shrink the mesh around twisting joints.
+     *
+     *  If pRotationOut isn't NULL, it's set to the rotation part of the blend.
+     */
+    inline vec3 BlendDualQuaternion(const vec3 &restPosition, const MeshSkinInfluence *influences,
+                                    const size_t countInfluences, const MeshBonePaletteEntry *palette,
+                                    quat *pRotationOut = NULL)
+    {
+        // Real part in [0..3], dual part in [4..7], both as (w, x, y, z).
+        float sum[8], weight;
+        size_t i;
+
+        const quat &pivot = palette[influences[0].boneIndex].rotation;
+#ifdef __SSE2__
+        // One register for each part. The dual part is built from three products of shuffled lanes.
+        const __m128 signFirst = _mm_setr_ps(-0.0f, 0.0f, 0.0f, 0.0f);
+        __m128 sumReal = _mm_setzero_ps(),
+               sumDual = _mm_setzero_ps();
+        for (i = 0; i < countInfluences; i++)
+        {
+            const MeshBonePaletteEntry &entry = palette[influences[i].boneIndex];
+            const quat &r = entry.rotation;
+            const vec3 &t = entry.translation;
+
+            const __m128 real = _mm_setr_ps(r.w, r.x, r.y, r.z),
+                         translation = _mm_setr_ps(t.x, t.y, t.z, 0.0f);
+
+            /*
+             *  dual = 0.5 * (0, t) * rotation, without the 0.5, as the sum of
+             *  (-tx*x, tx*w, ty*w, tz*w) + (-ty*y, ty*z, tz*x, tx*y) - (tz*z, tz*y, tx*z, ty*x)
+             */
+            const __m128 t0 = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(2, 1, 0, 0)),
+                         r0 = _mm_shuffle_ps(real, real, _MM_SHUFFLE(0, 0, 0, 1)),
+                         t1 = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(0, 2, 1, 1)),
+                         r1 = _mm_shuffle_ps(real, real, _MM_SHUFFLE(2, 1, 3, 2)),
+                         t2 = _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(1, 0, 2, 2)),
+                         r2 = _mm_shuffle_ps(real, real, _MM_SHUFFLE(1, 3, 2, 3));
+            const __m128 dual = _mm_sub_ps(_mm_xor_ps(signFirst, _mm_add_ps(_mm_mul_ps(t0, r0), _mm_mul_ps(t1, r1))),
+                                           _mm_mul_ps(t2, r2));
+
+            // q and -q are the same rotation, take the one closest to the first bone's.
+            weight = std::copysign(influences[i].weight, dot(pivot, r));
+
+            sumReal = _mm_add_ps(sumReal, _mm_mul_ps(_mm_set1_ps(weight), real));
+            sumDual = _mm_add_ps(sumDual, _mm_mul_ps(_mm_set1_ps(0.5f * weight), dual));
+        }
+        _mm_storeu_ps(sum, sumReal);
+        _mm_storeu_ps(sum + 4, sumDual);
+#else
+        float dq[8];
+        size_t j;
+
+        for (j = 0; j < 8; j++)
+            sum[j] = 0.0f;
+
+        for (i = 0; i < countInfluences; i++)
+        {
+            const MeshBonePaletteEntry &entry = palette[influences[i].boneIndex];
+            const quat &r = entry.rotation;
+            const vec3 &t = entry.translation;
+
+            // dual = 0.5 * (0, t) * rotation
+            dq[0] = r.w; dq[1] = r.x; dq[2] = r.y; dq[3] = r.z;
+            dq[4] = -0.5f * (t.x * r.x + t.y * r.y + t.z * r.z);
+            dq[5] = 0.5f * (t.x * r.w + t.y * r.z - t.z * r.y);
+            dq[6] = 0.5f * (t.y * r.w + t.z * r.x - t.x * r.z);
+            dq[7] = 0.5f * (t.z * r.w + t.x * r.y - t.y * r.x);
+
+            // q and -q are the same rotation, take the one closest to the first bone's.
+            weight = std::copysign(influences[i].weight, dot(pivot, r));
+
+            for (j = 0; j < 8; j++)
+                sum[j] += weight * dq[j];
+        }
+#endif
+
+        const float scale = 1.0f / std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2] + sum[3] * sum[3]);
+        for (i = 0; i < 8; i++)
+            sum[i] *= scale;
+
+        const quat rotation(sum[0], sum[1], sum[2], sum[3]);
+        const vec3 real(sum[1], sum[2], sum[3]),
+                   dual(sum[5], sum[6], sum[7]);
+
+        // translation = 2 * dual * conjugate(real)
+        const vec3 translation = 2.0f * (sum[0] * dual - sum[4] * real + cross(real, dual));
+
+        if (pRotationOut != NULL)
+            *pRotationOut = rotation;
+
+        return rotation * restPosition + translation;
+    }
+
+    /**
+     *  The skinned position of one skeleton vertex.
+     *  If pRotationOut isn't NULL, it's set to the vertex's blended bone rotation.
+     */
+    vec3 SkinVertex(const MeshSkeleton *, const MeshBonePaletteEntry *palette, const size_t vertexIndex,
+                    const MeshSkinningMode mode = MESHSKIN_LINEAR, quat *pRotationOut = NULL);
+
+    /**
+     *  Skinning kernel for vertices with a fixed number of influences. The loop has a constant
+     *  trip count, so the compiler unrolls it. The weights are normalized already.
+     */
+    template <MeshSkinningMode mode, bool withRotation, size_t countInfluences>
+    inline vec3 SkinFixed(const vec3 &restPosition, const MeshSkinInfluence *influences,
+                          const MeshBonePaletteEntry *palette, quat &rotationOut)
+    {
+        if constexpr (countInfluences == 0)  // No bones: the vertex stays where it is.
+        {
+            if constexpr (withRotation)
+                rotationOut = quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+            return restPosition;
+        }
+        else if constexpr (countInfluences == 1)  // One bone, with weight 1.0: a rigid transformation, in any mode.
+        {
+            const MeshBonePaletteEntry &entry = palette[influences[0].boneIndex];
+
+            if constexpr (withRotation)
+                rotationOut = entry.rotation;
+
+            return entry.rotation * restPosition + entry.translation;
+        }
+        else if constexpr (mode == MESHSKIN_DUAL_QUATERNION)
+            return BlendDualQuaternion(restPosition, influences, countInfluences, palette,
+                                       withRotation ? &rotationOut : NULL);
+        else
+            return BlendLinear(restPosition, influences, countInfluences, palette,
+                               withRotation ? &rotationOut : NULL);
+    }
+
+    /**
+     *  Skins the skeleton vertices with countInfluences influences and up, calling
+     *  output(vertexIndex, position) for each of them, or output(vertexIndex, position, rotation)
+     *  if withRotation is set.
+     */
+    template <MeshSkinningMode mode, bool withRotation, size_t countInfluences, typename Output>
+    inline void SkinVertexRanges(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette, Output &output)
+    {
+        size_t vertexIndex;
+        vec3 position;
+        quat rotation;
+
+        if constexpr (countInfluences > MESHSKIN_MAX_FIXED_INFLUENCES)
+        {
+            for (vertexIndex = pSkeleton->GetFirstVertexWithInfluences(countInfluences);
+                 vertexIndex < pSkeleton->CountVertices(); vertexIndex++)
+            {
+                if constexpr (withRotation)
+                {
+                    position = SkinVertex(pSkeleton, palette, vertexIndex, mode, &rotation);
+                    output(vertexIndex, position, rotation);
+                }
+                else
+                    output(vertexIndex, SkinVertex(pSkeleton, palette, vertexIndex, mode));
+            }
+        }
+        else
+        {
+            const size_t begin = pSkeleton->GetFirstVertexWithInfluences(countInfluences),
+                         end = pSkeleton->GetFirstVertexWithInfluences(countInfluences + 1);
+            if (begin < end)
+            {
+                // In this range, every vertex has the same number of influences.
+                const vec3 *restPositions = pSkeleton->GetRestPositions();
+                const MeshSkinInfluence *influences = pSkeleton->IterInfluences(begin).begin();
+
+                for (vertexIndex = begin; vertexIndex < end; vertexIndex++, influences += countInfluences)
+                {
+                    position = SkinFixed<mode, withRotation, countInfluences>(restPositions[vertexIndex],
+                                                                              influences, palette, rotation);
+                    if constexpr (withRotation)
+                        output(vertexIndex, position, rotation);
+                    else
+                        output(vertexIndex, position);
+                }
+            }
+
+            SkinVertexRanges<mode, withRotation, countInfluences + 1>(pSkeleton, palette, output);
+        }
+    }
+
+    template <typename Output>
+    inline void SkinSkeletonVertices(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette,
+                                     const MeshSkinningMode mode, Output &output)
+    {
+        if (mode == MESHSKIN_DUAL_QUATERNION)
+            SkinVertexRanges<MESHSKIN_DUAL_QUATERNION, false, 0>(pSkeleton, palette, output);
+        else
+            SkinVertexRanges<MESHSKIN_LINEAR, false, 0>(pSkeleton, palette, output);
+
+        CountMeshWork(MESHCOUNTER_VERTICES_SKINNED, pSkeleton->CountVertices());
+    }
+
+    template <typename Output>
+    inline void SkinSkeletonVerticesWithRotations(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette,
+                                                  const MeshSkinningMode mode, Output &output)
+    {
+        if (mode == MESHSKIN_DUAL_QUATERNION)
+            SkinVertexRanges<MESHSKIN_DUAL_QUATERNION, true, 0>(pSkeleton, palette, output);
+        else
+            SkinVertexRanges<MESHSKIN_LINEAR, true, 0>(pSkeleton, palette, output);
+
+        CountMeshWork(MESHCOUNTER_VERTICES_SKINNED, pSkeleton->CountVertices());
+    }
+}
+#endif  // ANIMATE_H
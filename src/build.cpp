@@ -15,29 +15,58 @@
 */
 
 
+#include <atomic>
+
 #include "build.h"
+#include "skin.h"
+#include "accounting.h"
+#include "idpool.h"
+#include "lazy.h"
+
+
+// Faces are destroyed through MeshFace pointers.
+static_assert(sizeof(XMLMesh::MeshQuadFace) == sizeof(XMLMesh::MeshFace)
+              && sizeof(XMLMesh::MeshTriangleFace) == sizeof(XMLMesh::MeshFace),
+              "face classes must not add members");
 
 
 namespace XMLMesh
 {
+    template <typename T>
+    void *Allocate(std::pmr::memory_resource *pResource, const size_t count = 1)
+    {
+        return pResource->allocate(count * sizeof(T), alignof(T));
+    }
+
+    template <typename T>
+    void Deallocate(std::pmr::memory_resource *pResource, T *p, const size_t count = 1)
+    {
+        pResource->deallocate(p, count * sizeof(T), alignof(T));
+    }
+
     MeshCorner::MeshCorner(void)
     {
     }
     MeshCorner::~MeshCorner(void)
     {
     }
-    MeshVertex::MeshVertex(void)
+    MeshVertex::MeshVertex(MeshMemoryAccounts *pAccounts)
+    : cornersInvolvedPs(pAccounts->Get(MESHMEMORY_ADJACENCY)),
+      bonesPullingPs(pAccounts->Get(MESHMEMORY_ADJACENCY))
     {
     }
     MeshVertex::~MeshVertex(void)
     {
     }
-    MeshFace::MeshFace(const size_t nCorners)
+    MeshFace::MeshFace(const size_t nCorners, MeshMemoryAccounts *pAccounts)
     {
         countCorners = nCorners;
-        mCorners = new MeshCorner[nCorners];
+        mCorners = (MeshCorner *)Allocate<MeshCorner>(pAccounts->Get(MESHMEMORY_FACES), nCorners);
 
         size_t i, iPrev, iNext;
+        for (i = 0; i < nCorners; i++)
+            new (mCorners + i) MeshCorner;
+
         for (i = 0; i < nCorners; i++)
         {
             iPrev = (i + nCorners - 1) % nCorners;
@@ -50,182 +79,231 @@ namespace XMLMesh
     }
     MeshFace::~MeshFace(void)
     {
-        delete[] mCorners;
+        // Their memory is freed by DestroyMeshData or DestroyMeshState, which know the memory resource.
+        size_t i;
+        for (i = 0; i < countCorners; i++)
+            mCorners[i].~MeshCorner();
     }
-    MeshTriangleFace::MeshTriangleFace(void): MeshFace(3)
+    MeshTriangleFace::MeshTriangleFace(MeshMemoryAccounts *pAccounts): MeshFace(3, pAccounts)
     {
     }
-    MeshQuadFace::MeshQuadFace(void): MeshFace(4)
+    MeshQuadFace::MeshQuadFace(MeshMemoryAccounts *pAccounts): MeshFace(4, pAccounts)
     {
     }
-    MeshBone::MeshBone(void): pParent(NULL)
+    MeshSubset::MeshSubset(MeshMemoryAccounts *pAccounts)
+    : facePs(pAccounts->Get(MESHMEMORY_SUBSETS))
+    {
+    }
+    MeshBone::MeshBone(MeshMemoryAccounts *pAccounts)
+    : pParent(NULL), vertexPs(pAccounts->Get(MESHMEMORY_ADJACENCY))
     {
     }
     MeshBone::~MeshBone(void)
     {
     }
-    MeshData::MeshData(void)
+    MeshBoneLayer::MeshBoneLayer(std::pmr::memory_resource *pResource): pBone(NULL), mKeys(pResource)
+    {
+    }
+    MeshSkeletalAnimation::MeshSkeletalAnimation(std::pmr::memory_resource *pResource)
+    : mLayers(pResource)
+    {
+    }
+    std::atomic<uint64_t> countMeshDataSerials(0);
+
+    MeshData::MeshData(std::pmr::memory_resource *p, MeshMemoryAccounts *pA)
+    : pResource(p), pAccounts(pA), pIDPool(NULL),
+      mVertices(pA->Get(MESHMEMORY_HASH_TABLES)), mFaces(pA->Get(MESHMEMORY_HASH_TABLES)),
+      denseVertices(pA->Get(MESHMEMORY_HASH_TABLES)), denseFaces(pA->Get(MESHMEMORY_HASH_TABLES)),
+      mSubsets(pA->Get(MESHMEMORY_HASH_TABLES)), mBones(pA->Get(MESHMEMORY_HASH_TABLES)),
+      mAnimations(pA->Get(MESHMEMORY_HASH_TABLES)), pLazyAnimations(NULL), serial(++countMeshDataSerials)
     {
     }
     MeshData::~MeshData(void)
     {
     }
-    MeshState::MeshState(void)
+    MeshState::MeshState(std::pmr::memory_resource *p, MeshMemoryAccounts *pA)
+    : pResource(p), pAccounts(pA), pIDPool(NULL),
+      mVertices(pA->Get(MESHMEMORY_HASH_TABLES)), mFaces(pA->Get(MESHMEMORY_HASH_TABLES)),
+      denseVertices(pA->Get(MESHMEMORY_HASH_TABLES)), denseFaces(pA->Get(MESHMEMORY_HASH_TABLES)),
+      mSubsets(pA->Get(MESHMEMORY_HASH_TABLES)), pSkinningTable(NULL), skinningSerial(0)
     {
     }
     MeshState::~MeshState(void)
     {
     }
 
-    MeshDataBuilder::MeshDataBuilder(void)
+    MeshDataBuilder::MeshDataBuilder(std::pmr::memory_resource *pResource): document(NULL)
     {
-        pMeshData = new MeshData;
+        MeshMemoryAccounts *pAccounts = new (Allocate<MeshMemoryAccounts>(pResource)) MeshMemoryAccounts(pResource);
+        pMeshData = new (Allocate<MeshData>(pAccounts->Get(MESHMEMORY_OBJECT))) MeshData(pResource, pAccounts);
+        pMeshData->pIDPool = new (Allocate<MeshIDPool>(pAccounts->Get(MESHMEMORY_IDS)))
+                             MeshIDPool(pAccounts->Get(MESHMEMORY_IDS));
     }
 
-    void MeshDataBuilder::AddVertex(const std::string &id, const vec3 &position)
+    MeshDataBuilder::MeshDataBuilder(MeshData *p): pMeshData(p), document(NULL)
+    {
+    }
+
+    void MeshDataBuilder::LoadAnimationsLazily(const char *d, const size_t length, const std::string &path)
+    {
+        document = d;
+
+        MeshAccountResource *pAccount = pMeshData->pAccounts->Get(MESHMEMORY_ANIMATIONS);
+        pMeshData->pLazyAnimations = new (Allocate<MeshLazyAnimations>(pAccount)) MeshLazyAnimations(path, length, pAccount);
+    }
+
+    void MeshDataBuilder::AddVertex(const std::string_view id, const vec3 &position)
     {
         if (pMeshData->HasVertex(id))
-            throw MeshKeyError("duplicate vertex %s", id.c_str());
+            throw MeshKeyError("duplicate vertex %.*s", ID_FORMAT_ARGS(id));
 
-        MeshVertex *pVertex = new MeshVertex;
-        pVertex->id = id;
+        MeshVertex *pVertex = new (Allocate<MeshVertex>(pMeshData->pAccounts->Get(MESHMEMORY_VERTICES))) MeshVertex(pMeshData->pAccounts);
+        pVertex->id = pMeshData->pIDPool->Intern(id);
         pVertex->position = position;
 
-        pMeshData->mVertices.emplace(id, pVertex);
+        pMeshData->mVertices.emplace(pVertex->id, pVertex);
+        pMeshData->denseVertices.Add(pVertex->id, pVertex);
     }
-    void MeshDataBuilder::AddQuad(const std::string id, const bool smooth,
-                                  const MeshTexCoords *txs, const std::string *vertexIDs)
+    void MeshDataBuilder::AddQuad(const std::string_view id, const bool smooth,
+                                  const MeshTexCoords *txs, const std::string_view *vertexIDs)
     {
         if (pMeshData->HasFace(id))
-            throw MeshKeyError("duplicate face %s", id.c_str());
+            throw MeshKeyError("duplicate face %.*s", ID_FORMAT_ARGS(id));
 
-        MeshQuadFace *pQuad = new MeshQuadFace;
+        MeshQuadFace *pQuad = new (Allocate<MeshQuadFace>(pMeshData->pAccounts->Get(MESHMEMORY_FACES))) MeshQuadFace(pMeshData->pAccounts);
         pQuad->smooth = smooth;
-        pQuad->id = id;
+        pQuad->id = pMeshData->pIDPool->Intern(id);
 
         // The corners have been created and linked together in the constructor.
 
+        // Put in the maps first, so that the face is destroyed with the rest if a vertex is missing.
+        pMeshData->mFaces.emplace(pQuad->id, pQuad);
+        pMeshData->denseFaces.Add(pQuad->id, pQuad);
+
         size_t i;
         for (i = 0; i < 4; i++)
         {
-            if (!HAS_ID(pMeshData->mVertices, vertexIDs[i]))
-                throw MeshKeyError("No such vertex %s", vertexIDs[i].c_str());
+            MeshVertex *pVertex = pMeshData->denseVertices.Find(vertexIDs[i], pMeshData->mVertices);
+            if (pVertex == NULL)
+                throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(vertexIDs[i]));
 
-            pQuad->mCorners[i].pVertex = pMeshData->mVertices.at(vertexIDs[i]);
-            pQuad->mCorners[i].pVertex->cornersInvolvedPs.insert(&(pQuad->mCorners[i]));
+            pQuad->mCorners[i].pVertex = pVertex;
+            pVertex->cornersInvolvedPs.insert(&(pQuad->mCorners[i]));
             pQuad->mCorners[i].texCoords = txs[i];
         }
-
-        pMeshData->mFaces.emplace(id, pQuad);
     }
-    void MeshDataBuilder::AddTriangle(const std::string id, const bool smooth,
-                                      const MeshTexCoords *txs, const std::string *vertexIDs)
+    void MeshDataBuilder::AddTriangle(const std::string_view id, const bool smooth,
+                                      const MeshTexCoords *txs, const std::string_view *vertexIDs)
     {
         if (pMeshData->HasFace(id))
-            throw MeshKeyError("duplicate face %s", id.c_str());
+            throw MeshKeyError("duplicate face %.*s", ID_FORMAT_ARGS(id));
 
-        MeshTriangleFace *pTriangle = new MeshTriangleFace;
+        MeshTriangleFace *pTriangle = new (Allocate<MeshTriangleFace>(pMeshData->pAccounts->Get(MESHMEMORY_FACES)))
+                                     MeshTriangleFace(pMeshData->pAccounts);
         pTriangle->smooth = smooth;
-        pTriangle->id = id;
+        pTriangle->id = pMeshData->pIDPool->Intern(id);
 
         // The corners have been created and linked together in the constructor.
 
+        // Put in the maps first, so that the face is destroyed with the rest if a vertex is missing.
+        pMeshData->mFaces.emplace(pTriangle->id, pTriangle);
+        pMeshData->denseFaces.Add(pTriangle->id, pTriangle);
+
         size_t i;
         for (i = 0; i < 3; i++)
         {
-            if (!HAS_ID(pMeshData->mVertices, vertexIDs[i]))
-                throw MeshKeyError("No such vertex %s", vertexIDs[i].c_str());
+            MeshVertex *pVertex = pMeshData->denseVertices.Find(vertexIDs[i], pMeshData->mVertices);
+            if (pVertex == NULL)
+                throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(vertexIDs[i]));
 
-            pTriangle->mCorners[i].pVertex = pMeshData->mVertices.at(vertexIDs[i]);
-            pTriangle->mCorners[i].pVertex->cornersInvolvedPs.insert(&(pTriangle->mCorners[i]));
+            pTriangle->mCorners[i].pVertex = pVertex;
+            pVertex->cornersInvolvedPs.insert(&(pTriangle->mCorners[i]));
             pTriangle->mCorners[i].texCoords = txs[i];
         }
-
-        pMeshData->mFaces.emplace(id, pTriangle);
     }
 
-    void MeshDataBuilder::AddSubset(const std::string &id)
+    void MeshDataBuilder::AddSubset(const std::string_view id)
     {
         if (pMeshData->HasSubset(id))
-            throw MeshKeyError("duplicate subset %s", id.c_str());
+            throw MeshKeyError("duplicate subset %.*s", ID_FORMAT_ARGS(id));
 
-        MeshSubset *pSubset = new MeshSubset;
-        pSubset->id = id;
+        MeshSubset *pSubset = new (Allocate<MeshSubset>(pMeshData->pAccounts->Get(MESHMEMORY_SUBSETS))) MeshSubset(pMeshData->pAccounts);
+        pSubset->id = pMeshData->pIDPool->Intern(id);
 
-        pMeshData->mSubsets.emplace(id, pSubset);
+        pMeshData->mSubsets.emplace(pSubset->id, pSubset);
     }
-    void MeshDataBuilder::AddQuadToSubset(const std::string &subsetID, const std::string &quadID)
+    void MeshDataBuilder::AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID)
     {
         if (!HAS_ID(pMeshData->mSubsets, subsetID))
-            throw MeshKeyError("No such subset %s", subsetID.c_str());
+            throw MeshKeyError("No such subset %.*s", ID_FORMAT_ARGS(subsetID));
 
-        if (!HAS_ID(pMeshData->mFaces, quadID))
-            throw MeshKeyError("No such quad %s", quadID.c_str());
+        MeshFace *pFace = pMeshData->denseFaces.Find(quadID, pMeshData->mFaces);
+        if (pFace == NULL)
+            throw MeshKeyError("No such quad %.*s", ID_FORMAT_ARGS(quadID));
 
         MeshSubset *pSubset = pMeshData->mSubsets.at(subsetID);
-        MeshFace *pFace = pMeshData->mFaces.at(quadID);
         if (pFace->CountCorners() != 4)
-            throw MeshKeyError("%s is not a quad", quadID.c_str());
+            throw MeshKeyError("%.*s is not a quad", ID_FORMAT_ARGS(quadID));
         pSubset->facePs.insert(pFace);
     }
-    void MeshDataBuilder::AddTriangleToSubset(const std::string &subsetID, const std::string &triangleID)
+    void MeshDataBuilder::AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID)
     {
         if (!HAS_ID(pMeshData->mSubsets, subsetID))
-            throw MeshKeyError("No such subset %s", subsetID.c_str());
+            throw MeshKeyError("No such subset %.*s", ID_FORMAT_ARGS(subsetID));
 
-        if (!HAS_ID(pMeshData->mFaces, triangleID))
-            throw MeshKeyError("No such triangle %s", triangleID.c_str());
+        MeshFace *pFace = pMeshData->denseFaces.Find(triangleID, pMeshData->mFaces);
+        if (pFace == NULL)
+            throw MeshKeyError("No such triangle %.*s", ID_FORMAT_ARGS(triangleID));
 
         MeshSubset *pSubset = pMeshData->mSubsets.at(subsetID);
-        MeshFace *pFace = pMeshData->mFaces.at(triangleID);
         if (pFace->CountCorners() != 3)
-            throw MeshKeyError("%s is not a triangle", triangleID.c_str());
+            throw MeshKeyError("%.*s is not a triangle", ID_FORMAT_ARGS(triangleID));
         pSubset->facePs.insert(pFace);
     }
-    void MeshDataBuilder::AddBone(const std::string &id, const vec3 &headPosition, const float weight)
+    void MeshDataBuilder::AddBone(const std::string_view id, const vec3 &headPosition, const float weight)
     {
         if (pMeshData->HasBone(id))
-            throw MeshKeyError("Duplicate bone %1%", id.c_str());
+            throw MeshKeyError("Duplicate bone %.*s", ID_FORMAT_ARGS(id));
 
-        MeshBone *pBone = new MeshBone;
-        pBone->id = id;
+        MeshBone *pBone = new (Allocate<MeshBone>(pMeshData->pAccounts->Get(MESHMEMORY_BONES))) MeshBone(pMeshData->pAccounts);
+        pBone->id = pMeshData->pIDPool->Intern(id);
         pBone->headPosition = headPosition;
         pBone->weight = weight;
 
-        pMeshData->mBones.emplace(id, pBone);
+        pMeshData->mBones.emplace(pBone->id, pBone);
     }
-    void MeshDataBuilder::ConnectBoneToVertex(const std::string &boneID, const std::string &vertexID)
+    void MeshDataBuilder::ConnectBoneToVertex(const std::string_view boneID, const std::string_view vertexID)
     {
         if (!HAS_ID(pMeshData->mBones, boneID))
-            throw MeshKeyError("No such bone %s", boneID.c_str());
+            throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(boneID));
 
-        if (!HAS_ID(pMeshData->mVertices, vertexID))
-            throw MeshKeyError("No such vertex %s", vertexID.c_str());
+        MeshVertex *pVertex = pMeshData->denseVertices.Find(vertexID, pMeshData->mVertices);
+        if (pVertex == NULL)
+            throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(vertexID));
 
         MeshBone *pBone = pMeshData->mBones.at(boneID);
-        MeshVertex *pVertex = pMeshData->mVertices.at(vertexID);
 
         pVertex->bonesPullingPs.insert(pBone);
         pBone->vertexPs.insert(pVertex);
     }
-    void MeshDataBuilder::ConnectBones(const std::string &parentID, const std::string &childID)
+    void MeshDataBuilder::ConnectBones(const std::string_view parentID, const std::string_view childID)
     {
         if (!HAS_ID(pMeshData->mBones, parentID))
-            throw MeshKeyError("No such bone %s", parentID.c_str());
+            throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(parentID));
 
         if (!HAS_ID(pMeshData->mBones, childID))
-            throw MeshKeyError("No such bone %s", childID.c_str());
+            throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(childID));
 
         MeshBone *pParent = pMeshData->mBones.at(parentID),
                  *pChild = pMeshData->mBones.at(childID);
 
         pChild->pParent = pParent;
     }
-    void MeshDataBuilder::AddKey(const std::string &animationID, const std::string &boneID,
+    void MeshDataBuilder::AddKey(const std::string_view animationID, const std::string_view boneID,
                                  const size_t frame, const MeshBoneTransformation &t)
     {
         if(!HAS_ID(pMeshData->mAnimations, animationID))
-            throw MeshKeyError("No such animation %s", animationID.c_str());
+            throw MeshKeyError("No such animation %.*s", ID_FORMAT_ARGS(animationID));
 
         MeshSkeletalAnimation *pAnimation = pMeshData->mAnimations.at(animationID);
 
@@ -233,36 +311,410 @@ namespace XMLMesh
             AddLayer(animationID, boneID);
 
         if (HAS_ID(pAnimation->mLayers.at(boneID).mKeys, frame))
-            throw MeshKeyError("Duplicate key for animation %s layer %s frame %u",
-                               animationID.c_str(), boneID.c_str(), frame);
+            throw MeshKeyError("Duplicate key for animation %.*s layer %.*s frame %u",
+                               ID_FORMAT_ARGS(animationID), ID_FORMAT_ARGS(boneID), frame);
 
         pAnimation->mLayers.at(boneID).mKeys[frame].frame = frame;
         pAnimation->mLayers.at(boneID).mKeys[frame].transformation = t;
     }
 
-    void MeshDataBuilder::AddLayer(const std::string &animationID, const std::string &boneID)
+    void MeshDataBuilder::AddLayer(const std::string_view animationID, const std::string_view boneID)
     {
         if(!HAS_ID(pMeshData->mAnimations, animationID))
-            throw MeshKeyError("No such animation %s", animationID.c_str());
+            throw MeshKeyError("No such animation %.*s", ID_FORMAT_ARGS(animationID));
 
         if(!HAS_ID(pMeshData->mBones, boneID))
-            throw MeshKeyError("No such bone %s", boneID.c_str());
+            throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(boneID));
 
         MeshSkeletalAnimation *pAnimation = pMeshData->mAnimations.at(animationID);
         MeshBone *pBone = pMeshData->mBones.at(boneID);
 
-        pAnimation->mLayers[boneID].pBone = pBone;
+        auto it = pAnimation->mLayers.find(boneID);
+        if (it == pAnimation->mLayers.end())
+            it = std::get<0>(pAnimation->mLayers.emplace(std::piecewise_construct,
+                                                         std::forward_as_tuple(pBone->id),
+                                                         std::forward_as_tuple(pMeshData->pAccounts->Get(MESHMEMORY_ANIMATIONS))));
+        std::get<1>(*it).pBone = pBone;
     }
-    void MeshDataBuilder::AddAnimation(const std::string &id, const size_t length)
+    void MeshDataBuilder::AddAnimation(const std::string_view id, const size_t length)
     {
         if (pMeshData->HasAnimation(id))
-            throw MeshKeyError("Duplicate animation %s", id.c_str());
+            throw MeshKeyError("Duplicate animation %.*s", ID_FORMAT_ARGS(id));
 
-        MeshSkeletalAnimation *pAnimation = new MeshSkeletalAnimation;
+        MeshSkeletalAnimation *pAnimation = new (Allocate<MeshSkeletalAnimation>(pMeshData->pAccounts->Get(MESHMEMORY_ANIMATIONS)))
+                                            MeshSkeletalAnimation(pMeshData->pAccounts->Get(MESHMEMORY_ANIMATIONS));
         pAnimation->length = length;
-        pAnimation->id = id;
+        pAnimation->id = pMeshData->pIDPool->Intern(id);
+
+        pMeshData->mAnimations.emplace(pAnimation->id, pAnimation);
+    }
+
+    void MeshDataRecords::AddVertex(const std::string_view id, const vec3 &position)
+    {
+        vertices.push_back({id, position});
+    }
+    void MeshDataRecords::AddFace(const std::string_view id, const bool smooth, const size_t countCorners,
+                                  const MeshTexCoords *txs, const std::string_view *vertexIDs)
+    {
+        faces.emplace_back();
+
+        Face &face = faces.back();
+        face.id = id;
+        face.smooth = smooth;
+        face.countCorners = countCorners;
+
+        size_t i;
+        for (i = 0; i < countCorners; i++)
+        {
+            face.texCoords[i] = txs[i];
+            face.vertexIDs[i] = vertexIDs[i];
+        }
+    }
+    void MeshDataRecords::AddQuad(const std::string_view id, const bool smooth,
+                                  const MeshTexCoords *txs, const std::string_view *vertexIDs)
+    {
+        AddFace(id, smooth, 4, txs, vertexIDs);
+    }
+    void MeshDataRecords::AddTriangle(const std::string_view id, const bool smooth,
+                                      const MeshTexCoords *txs, const std::string_view *vertexIDs)
+    {
+        AddFace(id, smooth, 3, txs, vertexIDs);
+    }
+    void MeshDataRecords::AddSubset(const std::string_view id)
+    {
+        subsetIDs.push_back(id);
+    }
+    void MeshDataRecords::AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID)
+    {
+        subsetFaces.push_back({subsetID, quadID, 4});
+    }
+    void MeshDataRecords::AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID)
+    {
+        subsetFaces.push_back({subsetID, triangleID, 3});
+    }
+    void MeshDataRecords::AddBone(const std::string_view id, const vec3 &headPosition, const float weight)
+    {
+        bones.push_back({id, headPosition, weight});
+    }
+    void MeshDataRecords::ConnectBoneToVertex(const std::string_view boneID, const std::string_view vertexID)
+    {
+        boneVertices.push_back({boneID, vertexID, 0});
+    }
+    void MeshDataRecords::ConnectBones(const std::string_view parentID, const std::string_view childID)
+    {
+        boneParents.push_back({parentID, childID, bones.size()});
+    }
+    void MeshDataRecords::AddKey(const std::string_view animationID, const std::string_view boneID,
+                                 const size_t frame, const MeshBoneTransformation &t)
+    {
+        keys.push_back({animationID, boneID, frame, t});
+    }
+    void MeshDataRecords::AddLayer(const std::string_view animationID, const std::string_view boneID)
+    {
+        layers.push_back({animationID, boneID, 0});
+    }
+    void MeshDataRecords::AddAnimation(const std::string_view animationID, const size_t length)
+    {
+        animations.push_back({animationID, length, std::string_view()});
+    }
+    void MeshDataRecords::AddLazyAnimation(const std::string_view animationID, const size_t length,
+                                           const std::string_view contents)
+    {
+        animations.push_back({animationID, length, contents});
+    }
+
+    /**
+     *  Looks up ids, but remembers the last one. Consecutive records often belong
+     *  to the same owner, whose id then points to the same text.
+     */
+    template <typename T>
+    class MeshLastIDLookup
+    {
+        private:
+            const MeshIDMap<T> &m;
+            std::string_view lastID;
+            T *pLast;
+        public:
+            MeshLastIDLookup(const MeshIDMap<T> &_m): m(_m), pLast(NULL) {}
+
+            // NULL if there's no such object.
+            T *Find(const std::string_view id)
+            {
+                if (pLast != NULL && id.data() == lastID.data() && id.size() == lastID.size())
+                    return pLast;
+
+                auto it = m.find(id);
+                if (it == m.end())
+                    return NULL;
+
+                lastID = id;
+                pLast = std::get<1>(*it);
+                return pLast;
+            }
+    };
+
+    void MeshDataBuilder::AddRecords(const MeshDataRecords *records, const size_t countRecords)
+    {
+        MeshMemoryAccounts *pAccounts = pMeshData->pAccounts;
+        MeshIDPool *pIDPool = pMeshData->pIDPool;
+
+        size_t countVertices = 0, countFaces = 0, countSubsets = 0, countBones = 0, countAnimations = 0, i, j;
+        for (i = 0; i < countRecords; i++)
+        {
+            countVertices += records[i].vertices.size();
+            countFaces += records[i].faces.size();
+            countSubsets += records[i].subsetIDs.size();
+            countBones += records[i].bones.size();
+            countAnimations += records[i].animations.size();
+        }
+
+        countVertices += pMeshData->mVertices.size();
+        countFaces += pMeshData->mFaces.size();
+        pMeshData->mVertices.reserve(countVertices);
+        pMeshData->denseVertices.Reserve(countVertices);
+        pMeshData->mFaces.reserve(countFaces);
+        pMeshData->denseFaces.Reserve(countFaces);
+        pMeshData->mSubsets.reserve(pMeshData->mSubsets.size() + countSubsets);
+        pMeshData->mBones.reserve(pMeshData->mBones.size() + countBones);
+        pMeshData->mAnimations.reserve(pMeshData->mAnimations.size() + countAnimations);
+        pIDPool->Reserve(pIDPool->CountIDs() + countVertices + countFaces + countSubsets + countBones + countAnimations);
+
+        // Objects are put in the maps before their references are looked up,
+        // so that DestroyMeshData frees them if a lookup fails.
+
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Vertex &record : records[i].vertices)
+            {
+                MeshVertex *pVertex = new (Allocate<MeshVertex>(pAccounts->Get(MESHMEMORY_VERTICES))) MeshVertex(pAccounts);
+                pVertex->id = pIDPool->Intern(record.id);
+                pVertex->position = record.position;
+
+                if (!std::get<1>(pMeshData->mVertices.emplace(pVertex->id, pVertex)))
+                {
+                    pVertex->~MeshVertex();
+                    Deallocate(pAccounts->Get(MESHMEMORY_VERTICES), pVertex);
+                    throw MeshKeyError("duplicate vertex %.*s", ID_FORMAT_ARGS(record.id));
+                }
+                pMeshData->denseVertices.Add(pVertex->id, pVertex);
+            }
+        }
+
+        std::vector<MeshFace *> addedFacePs;
+        addedFacePs.reserve(countFaces - pMeshData->mFaces.size());
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Face &record : records[i].faces)
+            {
+                MeshFace *pFace;
+                if (record.countCorners == 4)
+                    pFace = new (Allocate<MeshQuadFace>(pAccounts->Get(MESHMEMORY_FACES))) MeshQuadFace(pAccounts);
+                else
+                    pFace = new (Allocate<MeshTriangleFace>(pAccounts->Get(MESHMEMORY_FACES))) MeshTriangleFace(pAccounts);
+                pFace->smooth = record.smooth;
+                pFace->id = pIDPool->Intern(record.id);
+
+                if (!std::get<1>(pMeshData->mFaces.emplace(pFace->id, pFace)))
+                {
+                    MeshCorner *corners = pFace->mCorners;
+                    pFace->~MeshFace();
+                    Deallocate(pAccounts->Get(MESHMEMORY_FACES), corners, record.countCorners);
+                    Deallocate(pAccounts->Get(MESHMEMORY_FACES), pFace);
+                    throw MeshKeyError("duplicate face %.*s", ID_FORMAT_ARGS(record.id));
+                }
+                pMeshData->denseFaces.Add(pFace->id, pFace);
+                addedFacePs.push_back(pFace);
+
+                for (j = 0; j < record.countCorners; j++)
+                {
+                    MeshVertex *pVertex = pMeshData->denseVertices.Find(record.vertexIDs[j], pMeshData->mVertices);
+                    if (pVertex == NULL)
+                        throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(record.vertexIDs[j]));
+
+                    pFace->mCorners[j].pVertex = pVertex;
+                    pFace->mCorners[j].texCoords = record.texCoords[j];
+                }
+            }
+        }
+
+        // Corners are mostly allocated in increasing order, so inserting them at the end is cheap.
+        for (MeshFace *pFace : addedFacePs)
+        {
+            for (j = 0; j < pFace->countCorners; j++)
+            {
+                MeshPointerSet<MeshCorner> &cornerPs = pFace->mCorners[j].pVertex->cornersInvolvedPs;
+                cornerPs.insert(cornerPs.end(), &(pFace->mCorners[j]));
+            }
+        }
+
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const std::string_view id : records[i].subsetIDs)
+            {
+                MeshSubset *pSubset = new (Allocate<MeshSubset>(pAccounts->Get(MESHMEMORY_SUBSETS))) MeshSubset(pAccounts);
+                pSubset->id = pIDPool->Intern(id);
+
+                if (!std::get<1>(pMeshData->mSubsets.emplace(pSubset->id, pSubset)))
+                {
+                    pSubset->~MeshSubset();
+                    Deallocate(pAccounts->Get(MESHMEMORY_SUBSETS), pSubset);
+                    throw MeshKeyError("duplicate subset %.*s", ID_FORMAT_ARGS(id));
+                }
+            }
+        }
+
+        MeshLastIDLookup<MeshSubset> subsetLookup(pMeshData->mSubsets);
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Link &record : records[i].subsetFaces)
+            {
+                MeshSubset *pSubset = subsetLookup.Find(record.ownerID);
+                if (pSubset == NULL)
+                    throw MeshKeyError("No such subset %.*s", ID_FORMAT_ARGS(record.ownerID));
+
+                const char *faceType = record.countCorners == 4 ? "quad" : "triangle";
+                MeshFace *pFace = pMeshData->denseFaces.Find(record.id, pMeshData->mFaces);
+                if (pFace == NULL)
+                    throw MeshKeyError("No such %s %.*s", faceType, ID_FORMAT_ARGS(record.id));
+
+                if (pFace->CountCorners() != record.countCorners)
+                    throw MeshKeyError("%.*s is not a %s", ID_FORMAT_ARGS(record.id), faceType);
+
+                pSubset->facePs.insert(pSubset->facePs.end(), pFace);
+            }
+        }
 
-        pMeshData->mAnimations.emplace(id, pAnimation);
+        // A bone's parent must have been added before it.
+        MeshLastIDLookup<MeshBone> boneLookup(pMeshData->mBones);
+        for (i = 0; i < countRecords; i++)
+        {
+            auto itParent = records[i].boneParents.begin();
+            size_t countAdded = 0;
+            for (const MeshDataRecords::Bone &record : records[i].bones)
+            {
+                MeshBone *pBone = new (Allocate<MeshBone>(pAccounts->Get(MESHMEMORY_BONES))) MeshBone(pAccounts);
+                pBone->id = pIDPool->Intern(record.id);
+                pBone->headPosition = record.headPosition;
+                pBone->weight = record.weight;
+
+                if (!std::get<1>(pMeshData->mBones.emplace(pBone->id, pBone)))
+                {
+                    pBone->~MeshBone();
+                    Deallocate(pAccounts->Get(MESHMEMORY_BONES), pBone);
+                    throw MeshKeyError("Duplicate bone %.*s", ID_FORMAT_ARGS(record.id));
+                }
+                countAdded++;
+
+                for (; itParent != records[i].boneParents.end() && itParent->countBones <= countAdded; itParent++)
+                    ConnectBones(itParent->parentID, itParent->childID);
+            }
+            for (; itParent != records[i].boneParents.end(); itParent++)
+                ConnectBones(itParent->parentID, itParent->childID);
+        }
+
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Link &record : records[i].boneVertices)
+            {
+                MeshBone *pBone = boneLookup.Find(record.ownerID);
+                if (pBone == NULL)
+                    throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(record.ownerID));
+
+                MeshVertex *pVertex = pMeshData->denseVertices.Find(record.id, pMeshData->mVertices);
+                if (pVertex == NULL)
+                    throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(record.id));
+
+                pVertex->bonesPullingPs.insert(pBone);
+                pBone->vertexPs.insert(pBone->vertexPs.end(), pVertex);
+            }
+        }
+
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Animation &record : records[i].animations)
+            {
+                MeshSkeletalAnimation *pAnimation = new (Allocate<MeshSkeletalAnimation>(pAccounts->Get(MESHMEMORY_ANIMATIONS)))
+                                                    MeshSkeletalAnimation(pAccounts->Get(MESHMEMORY_ANIMATIONS));
+                pAnimation->length = record.length;
+                pAnimation->id = pIDPool->Intern(record.id);
+
+                if (!std::get<1>(pMeshData->mAnimations.emplace(pAnimation->id, pAnimation)))
+                {
+                    pAnimation->~MeshSkeletalAnimation();
+                    Deallocate(pAccounts->Get(MESHMEMORY_ANIMATIONS), pAnimation);
+                    throw MeshKeyError("Duplicate animation %.*s", ID_FORMAT_ARGS(record.id));
+                }
+
+                if (record.contents.data() != NULL)
+                    pMeshData->pLazyAnimations->Add(pAnimation, record.contents.data() - document, record.contents);
+            }
+        }
+
+        AddAnimationRecords(records, countRecords);
+    }
+
+    void MeshDataBuilder::AddAnimationRecords(const MeshDataRecords *records, const size_t countRecords)
+    {
+        MeshMemoryAccounts *pAccounts = pMeshData->pAccounts;
+
+        size_t i;
+        MeshLastIDLookup<MeshBone> boneLookup(pMeshData->mBones);
+        MeshLastIDLookup<MeshSkeletalAnimation> animationLookup(pMeshData->mAnimations);
+        for (i = 0; i < countRecords; i++)
+        {
+            for (const MeshDataRecords::Link &record : records[i].layers)
+            {
+                MeshSkeletalAnimation *pAnimation = animationLookup.Find(record.ownerID);
+                if (pAnimation == NULL)
+                    throw MeshKeyError("No such animation %.*s", ID_FORMAT_ARGS(record.ownerID));
+
+                MeshBone *pBone = boneLookup.Find(record.id);
+                if (pBone == NULL)
+                    throw MeshKeyError("No such bone %.*s", ID_FORMAT_ARGS(record.id));
+
+                auto it = pAnimation->mLayers.find(pBone->id);
+                if (it == pAnimation->mLayers.end())
+                    it = std::get<0>(pAnimation->mLayers.emplace(std::piecewise_construct,
+                                                                 std::forward_as_tuple(pBone->id),
+                                                                 std::forward_as_tuple(pAccounts->Get(MESHMEMORY_ANIMATIONS))));
+                std::get<1>(*it).pBone = pBone;
+            }
+        }
+
+        for (i = 0; i < countRecords; i++)
+        {
+            std::string_view lastAnimationID, lastBoneID;
+            MeshBoneLayer *pLayer = NULL;
+            for (const MeshDataRecords::Key &record : records[i].keys)
+            {
+                // The keys of one layer follow each other, with the same ids.
+                if (pLayer == NULL || record.animationID.data() != lastAnimationID.data()
+                        || record.boneID.data() != lastBoneID.data()
+                        || record.animationID.size() != lastAnimationID.size()
+                        || record.boneID.size() != lastBoneID.size())
+                {
+                    MeshSkeletalAnimation *pAnimation = animationLookup.Find(record.animationID);
+                    if (pAnimation == NULL)
+                        throw MeshKeyError("No such animation %.*s", ID_FORMAT_ARGS(record.animationID));
+
+                    if (!HAS_ID(pAnimation->mLayers, record.boneID))
+                        AddLayer(record.animationID, record.boneID);
+
+                    pLayer = &(pAnimation->mLayers.at(record.boneID));
+                    lastAnimationID = record.animationID;
+                    lastBoneID = record.boneID;
+                }
+
+                auto result = pLayer->mKeys.try_emplace(record.frame);
+                if (!std::get<1>(result))
+                    throw MeshKeyError("Duplicate key for animation %.*s layer %.*s frame %u",
+                                       ID_FORMAT_ARGS(record.animationID), ID_FORMAT_ARGS(record.boneID), record.frame);
+
+                MeshBoneKey &key = std::get<1>(*std::get<0>(result));
+                key.frame = record.frame;
+                key.transformation = record.transformation;
+            }
+        }
     }
 
     MeshData *MeshDataBuilder::GetMeshData(void)
@@ -275,130 +727,183 @@ namespace XMLMesh
         if (pMeshData == NULL)
             return;
 
+        std::pmr::memory_resource *pResource = pMeshData->pResource;
+        MeshMemoryAccounts *pAccounts = pMeshData->pAccounts;
+
+        if (pMeshData->pLazyAnimations != NULL)
+        {
+            pMeshData->pLazyAnimations->~MeshLazyAnimations();
+            Deallocate(pAccounts->Get(MESHMEMORY_ANIMATIONS), pMeshData->pLazyAnimations);
+        }
+
         for (const auto &pair : pMeshData->mAnimations)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshSkeletalAnimation();
+            Deallocate(pAccounts->Get(MESHMEMORY_ANIMATIONS), std::get<1>(pair));
+        }
 
         for (const auto &pair : pMeshData->mBones)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshBone();
+            Deallocate(pAccounts->Get(MESHMEMORY_BONES), std::get<1>(pair));
+        }
 
         for (const auto &pair : pMeshData->mSubsets)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshSubset();
+            Deallocate(pAccounts->Get(MESHMEMORY_SUBSETS), std::get<1>(pair));
+        }
 
         for (const auto &pair : pMeshData->mFaces)
-            delete std::get<1>(pair);
+        {
+            MeshFace *pFace = std::get<1>(pair);
+            MeshCorner *corners = pFace->mCorners;
+            const size_t countCorners = pFace->countCorners;
+
+            pFace->~MeshFace();
+            Deallocate(pAccounts->Get(MESHMEMORY_FACES), corners, countCorners);
+            Deallocate(pAccounts->Get(MESHMEMORY_FACES), pFace);
+        }
 
         for (const auto &pair : pMeshData->mVertices)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshVertex();
+            Deallocate(pAccounts->Get(MESHMEMORY_VERTICES), std::get<1>(pair));
+        }
+
+        pMeshData->pIDPool->~MeshIDPool();
+        Deallocate(pAccounts->Get(MESHMEMORY_IDS), pMeshData->pIDPool);
+
+        pMeshData->~MeshData();
+        Deallocate(pAccounts->Get(MESHMEMORY_OBJECT), pMeshData);
 
-        delete pMeshData;
+        pAccounts->~MeshMemoryAccounts();
+        Deallocate(pResource, pAccounts);
     }
 
-    MeshStateBuilder::MeshStateBuilder(void)
+    MeshStateBuilder::MeshStateBuilder(std::pmr::memory_resource *pResource)
     {
-        pMeshState = new MeshState;
+        MeshMemoryAccounts *pAccounts = new (Allocate<MeshMemoryAccounts>(pResource)) MeshMemoryAccounts(pResource);
+        pMeshState = new (Allocate<MeshState>(pAccounts->Get(MESHMEMORY_OBJECT))) MeshState(pResource, pAccounts);
+        pMeshState->pIDPool = new (Allocate<MeshIDPool>(pAccounts->Get(MESHMEMORY_IDS)))
+                              MeshIDPool(pAccounts->Get(MESHMEMORY_IDS));
     }
 
-    void MeshStateBuilder::AddVertex(const std::string &id, const vec3 &position)
+    void MeshStateBuilder::AddVertex(const std::string_view id, const vec3 &position)
     {
         if (pMeshState->HasVertex(id))
-            throw MeshKeyError("duplicate vertex %s", id.c_str());
+            throw MeshKeyError("duplicate vertex %.*s", ID_FORMAT_ARGS(id));
 
-        MeshVertex *pVertex = new MeshVertex;
-        pVertex->id = id;
+        MeshVertex *pVertex = new (Allocate<MeshVertex>(pMeshState->pAccounts->Get(MESHMEMORY_VERTICES))) MeshVertex(pMeshState->pAccounts);
+        pVertex->id = pMeshState->pIDPool->Intern(id);
         pVertex->position = position;
 
-        pMeshState->mVertices.emplace(id, pVertex);
+        pMeshState->mVertices.emplace(pVertex->id, pVertex);
+        pMeshState->denseVertices.Add(pVertex->id, pVertex);
     }
-    void MeshStateBuilder::AddQuad(const std::string id, const bool smooth,
-                                   const MeshTexCoords *txs, const std::string *vertexIDs)
+    void MeshStateBuilder::AddQuad(const std::string_view id, const bool smooth,
+                                   const MeshTexCoords *txs, const std::string_view *vertexIDs)
     {
         if (pMeshState->HasFace(id))
-            throw MeshKeyError("duplicate face %s", id.c_str());
+            throw MeshKeyError("duplicate face %.*s", ID_FORMAT_ARGS(id));
 
-        MeshQuadFace *pQuad = new MeshQuadFace;
+        MeshQuadFace *pQuad = new (Allocate<MeshQuadFace>(pMeshState->pAccounts->Get(MESHMEMORY_FACES))) MeshQuadFace(pMeshState->pAccounts);
         pQuad->smooth = smooth;
-        pQuad->id = id;
+        pQuad->id = pMeshState->pIDPool->Intern(id);
 
         // The corners have been created and linked together in the constructor.
 
+        // Put in the maps first, so that the face is destroyed with the rest if a vertex is missing.
+        pMeshState->mFaces.emplace(pQuad->id, pQuad);
+        pMeshState->denseFaces.Add(pQuad->id, pQuad);
+
         size_t i;
         for (i = 0; i < 4; i++)
         {
-            if (!HAS_ID(pMeshState->mVertices, vertexIDs[i]))
-                throw MeshKeyError("No such vertex %s", vertexIDs[i].c_str());
+            MeshVertex *pVertex = pMeshState->denseVertices.Find(vertexIDs[i], pMeshState->mVertices);
+            if (pVertex == NULL)
+                throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(vertexIDs[i]));
 
-            pQuad->mCorners[i].pVertex = pMeshState->mVertices.at(vertexIDs[i]);
-            pQuad->mCorners[i].pVertex->cornersInvolvedPs.insert(&(pQuad->mCorners[i]));
+            pQuad->mCorners[i].pVertex = pVertex;
+            pVertex->cornersInvolvedPs.insert(&(pQuad->mCorners[i]));
             pQuad->mCorners[i].texCoords = txs[i];
         }
-
-        pMeshState->mFaces.emplace(id, pQuad);
     }
-    void MeshStateBuilder::AddTriangle(const std::string id, const bool smooth,
-                                       const MeshTexCoords *txs, const std::string *vertexIDs)
+    void MeshStateBuilder::AddTriangle(const std::string_view id, const bool smooth,
+                                       const MeshTexCoords *txs, const std::string_view *vertexIDs)
     {
         if (pMeshState->HasFace(id))
-            throw MeshKeyError("duplicate face %s", id.c_str());
+            throw MeshKeyError("duplicate face %.*s", ID_FORMAT_ARGS(id));
 
-        MeshTriangleFace *pTriangle = new MeshTriangleFace;
+        MeshTriangleFace *pTriangle = new (Allocate<MeshTriangleFace>(pMeshState->pAccounts->Get(MESHMEMORY_FACES)))
+                                     MeshTriangleFace(pMeshState->pAccounts);
         pTriangle->smooth = smooth;
-        pTriangle->id = id;
+        pTriangle->id = pMeshState->pIDPool->Intern(id);
 
         // The corners have been created and linked together in the constructor.
 
+        // Put in the maps first, so that the face is destroyed with the rest if a vertex is missing.
+        pMeshState->mFaces.emplace(pTriangle->id, pTriangle);
+        pMeshState->denseFaces.Add(pTriangle->id, pTriangle);
+
         size_t i;
         for (i = 0; i < 3; i++)
         {
-            if (!HAS_ID(pMeshState->mVertices, vertexIDs[i]))
-                throw MeshKeyError("No such vertex %s", vertexIDs[i].c_str());
+            MeshVertex *pVertex = pMeshState->denseVertices.Find(vertexIDs[i], pMeshState->mVertices);
+            if (pVertex == NULL)
+                throw MeshKeyError("No such vertex %.*s", ID_FORMAT_ARGS(vertexIDs[i]));
 
-            pTriangle->mCorners[i].pVertex = pMeshState->mVertices.at(vertexIDs[i]);
-            pTriangle->mCorners[i].pVertex->cornersInvolvedPs.insert(&(pTriangle->mCorners[i]));
+            pTriangle->mCorners[i].pVertex = pVertex;
+            pVertex->cornersInvolvedPs.insert(&(pTriangle->mCorners[i]));
             pTriangle->mCorners[i].texCoords = txs[i];
         }
-
-        pMeshState->mFaces.emplace(id, pTriangle);
     }
 
-    void MeshStateBuilder::AddSubset(const std::string &id)
+    void MeshStateBuilder::AddSubset(const std::string_view id)
     {
         if (pMeshState->HasSubset(id))
-            throw MeshKeyError("duplicate subset %s", id.c_str());
+            throw MeshKeyError("duplicate subset %.*s", ID_FORMAT_ARGS(id));
 
-        MeshSubset *pSubset = new MeshSubset;
-        pSubset->id = id;
+        MeshSubset *pSubset = new (Allocate<MeshSubset>(pMeshState->pAccounts->Get(MESHMEMORY_SUBSETS))) MeshSubset(pMeshState->pAccounts);
+        pSubset->id = pMeshState->pIDPool->Intern(id);
 
-        pMeshState->mSubsets.emplace(id, pSubset);
+        pMeshState->mSubsets.emplace(pSubset->id, pSubset);
     }
-    void MeshStateBuilder::AddQuadToSubset(const std::string &subsetID, const std::string &quadID)
+    void MeshStateBuilder::AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID)
     {
         if (!HAS_ID(pMeshState->mSubsets, subsetID))
-            throw MeshKeyError("No such subset %s", subsetID.c_str());
+            throw MeshKeyError("No such subset %.*s", ID_FORMAT_ARGS(subsetID));
 
-        if (!HAS_ID(pMeshState->mFaces, quadID))
-            throw MeshKeyError("No such quad %s", quadID.c_str());
+        MeshFace *pFace = pMeshState->denseFaces.Find(quadID, pMeshState->mFaces);
+        if (pFace == NULL)
+            throw MeshKeyError("No such quad %.*s", ID_FORMAT_ARGS(quadID));
 
         MeshSubset *pSubset = pMeshState->mSubsets.at(subsetID);
-        MeshFace *pFace = pMeshState->mFaces.at(quadID);
         if (pFace->CountCorners() != 4)
-            throw MeshKeyError("%s is not a quad", quadID.c_str());
+            throw MeshKeyError("%.*s is not a quad", ID_FORMAT_ARGS(quadID));
         pSubset->facePs.insert(pFace);
     }
-    void MeshStateBuilder::AddTriangleToSubset(const std::string &subsetID, const std::string &triangleID)
+    void MeshStateBuilder::AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID)
     {
         if (!HAS_ID(pMeshState->mSubsets, subsetID))
-            throw MeshKeyError("No such subset %s", subsetID.c_str());
+            throw MeshKeyError("No such subset %.*s", ID_FORMAT_ARGS(subsetID));
 
-        if (!HAS_ID(pMeshState->mFaces, triangleID))
-            throw MeshKeyError("No such triangle %s", triangleID.c_str());
+        MeshFace *pFace = pMeshState->denseFaces.Find(triangleID, pMeshState->mFaces);
+        if (pFace == NULL)
+            throw MeshKeyError("No such triangle %.*s", ID_FORMAT_ARGS(triangleID));
 
         MeshSubset *pSubset = pMeshState->mSubsets.at(subsetID);
-        MeshFace *pFace = pMeshState->mFaces.at(triangleID);
         if (pFace->CountCorners() != 3)
-            throw MeshKeyError("%s is not a triangle", triangleID.c_str());
+            throw MeshKeyError("%.*s is not a triangle", ID_FORMAT_ARGS(triangleID));
         pSubset->facePs.insert(pFace);
     }
 
+    void MeshStateBuilder::ReserveNumberedIDs(const size_t countVertices, const size_t countFaces)
+    {
+        pMeshState->denseVertices.Reserve(countVertices);
+        pMeshState->denseFaces.Reserve(countFaces);
+    }
+
     MeshState *MeshStateBuilder::GetMeshState(void)
     {
         return pMeshState;
@@ -409,15 +914,41 @@ namespace XMLMesh
         if (pMeshState == NULL)
             return;
 
+        DestroyMeshSkinningTable(pMeshState->pSkinningTable);
+
+        std::pmr::memory_resource *pResource = pMeshState->pResource;
+        MeshMemoryAccounts *pAccounts = pMeshState->pAccounts;
+
         for (const auto &pair : pMeshState->mSubsets)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshSubset();
+            Deallocate(pAccounts->Get(MESHMEMORY_SUBSETS), std::get<1>(pair));
+        }
 
         for (const auto &pair : pMeshState->mFaces)
-            delete std::get<1>(pair);
+        {
+            MeshFace *pFace = std::get<1>(pair);
+            MeshCorner *corners = pFace->mCorners;
+            const size_t countCorners = pFace->countCorners;
+
+            pFace->~MeshFace();
+            Deallocate(pAccounts->Get(MESHMEMORY_FACES), corners, countCorners);
+            Deallocate(pAccounts->Get(MESHMEMORY_FACES), pFace);
+        }
 
         for (const auto &pair : pMeshState->mVertices)
-            delete std::get<1>(pair);
+        {
+            std::get<1>(pair)->~MeshVertex();
+            Deallocate(pAccounts->Get(MESHMEMORY_VERTICES), std::get<1>(pair));
+        }
+
+        pMeshState->pIDPool->~MeshIDPool();
+        Deallocate(pAccounts->Get(MESHMEMORY_IDS), pMeshState->pIDPool);
+
+        pMeshState->~MeshState();
+        Deallocate(pAccounts->Get(MESHMEMORY_OBJECT), pMeshState);
 
-        delete pMeshState;
+        pAccounts->~MeshMemoryAccounts();
+        Deallocate(pResource, pAccounts);
     }
 }
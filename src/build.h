@@ -21,30 +21,159 @@
 #include "mesh.h"
 
 
+#include <vector>
+
+
 namespace XMLMesh
 {
+    /**
+     *  Builder calls, appended to flat arrays, to be made all at once by MeshDataBuilder::AddRecords.
+     *  The ids aren't copied, so they must stay valid until then.
+     */
+    class MeshDataRecords
+    {
+        private:
+            struct Vertex
+            {
+                std::string_view id;
+                vec3 position;
+            };
+
+            struct Face
+            {
+                std::string_view id;
+                bool smooth;
+                size_t countCorners;
+                MeshTexCoords texCoords[4];
+                std::string_view vertexIDs[4];
+            };
+
+            struct Bone
+            {
+                std::string_view id;
+                vec3 headPosition;
+                float weight;
+            };
+
+            // A face in a subset, a vertex pulled by a bone or a layer of an animation.
+            struct Link
+            {
+                std::string_view ownerID, id;
+                size_t countCorners;  // of subset faces
+            };
+
+            // 'countBones' were added before the call, the parent must be one of them.
+            struct BoneParent
+            {
+                std::string_view parentID, childID;
+                size_t countBones;
+            };
+
+            struct Animation
+            {
+                std::string_view id;
+                size_t length;
+
+                // Between the start and end tag, for animations that are loaded on first use.
+                std::string_view contents;
+            };
+
+            struct Key
+            {
+                std::string_view animationID, boneID;
+                size_t frame;
+                MeshBoneTransformation transformation;
+            };
+
+            std::vector<Vertex> vertices;
+            std::vector<Face> faces;
+            std::vector<std::string_view> subsetIDs;
+            std::vector<Link> subsetFaces;
+            std::vector<Bone> bones;
+            std::vector<Link> boneVertices;
+            std::vector<BoneParent> boneParents;
+            std::vector<Animation> animations;
+            std::vector<Link> layers;
+            std::vector<Key> keys;
+
+            void AddFace(const std::string_view id, const bool smooth, const size_t countCorners,
+                         const MeshTexCoords *, const std::string_view *vertexIDs);
+        public:
+            void AddVertex(const std::string_view id, const vec3 &position);
+            void AddQuad(const std::string_view id, const bool smooth,
+                         const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddTriangle(const std::string_view id, const bool smooth,
+                             const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddSubset(const std::string_view id);
+            void AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID);
+            void AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID);
+            void AddBone(const std::string_view id, const vec3 &headPosition, const float weight);
+            void ConnectBoneToVertex(const std::string_view boneID, const std::string_view vertexID);
+            void ConnectBones(const std::string_view parentID, const std::string_view childID);
+            void AddKey(const std::string_view animationID, const std::string_view boneID,
+                        const size_t frame, const MeshBoneTransformation &);
+            void AddLayer(const std::string_view animationID, const std::string_view boneID);
+            void AddAnimation(const std::string_view animationID, const size_t length);
+
+            // Without contents, it's the same as AddAnimation.
+            void AddLazyAnimation(const std::string_view animationID, const size_t length,
+                                  const std::string_view contents);
+
+        friend class MeshDataBuilder;
+    };
+
+
     class MeshDataBuilder
     {
         private:
             MeshData *pMeshData;
+
+            const char *document;  // for the offsets of lazy animations
         public:
-            MeshDataBuilder(void);
-
-            void AddVertex(const std::string &id, const vec3 &position);
-            void AddQuad(const std::string id, const bool smooth,
-                         const MeshTexCoords *, const std::string *vertexIDs);
-            void AddTriangle(const std::string id, const bool smooth,
-                             const MeshTexCoords *, const std::string *vertexIDs);
-            void AddSubset(const std::string &id);
-            void AddQuadToSubset(const std::string &subsetID, const std::string &quadID);
-            void AddTriangleToSubset(const std::string &subsetID, const std::string &triangleID);
-            void AddBone(const std::string &id, const vec3 &headPosition, const float weight);
-            void ConnectBoneToVertex(const std::string &boneID, const std::string &vertexID);
-            void ConnectBones(const std::string &parentID, const std::string &childID);
-            void AddKey(const std::string &animationID, const std::string &boneID,
+            // The MeshData object and everything in it is allocated from the resource.
+            MeshDataBuilder(std::pmr::memory_resource *pResource = std::pmr::get_default_resource());
+
+            // Continues with a mesh that has already been built.
+            MeshDataBuilder(MeshData *);
+
+            /**
+             *  Animations that are recorded with contents will be loaded from the file on first use.
+             *  Their contents must be in the given document, which was read from the file.
+             */
+            void LoadAnimationsLazily(const char *document, const size_t length, const std::string &path);
+
+            void AddVertex(const std::string_view id, const vec3 &position);
+            void AddQuad(const std::string_view id, const bool smooth,
+                         const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddTriangle(const std::string_view id, const bool smooth,
+                             const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddSubset(const std::string_view id);
+            void AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID);
+            void AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID);
+            void AddBone(const std::string_view id, const vec3 &headPosition, const float weight);
+            void ConnectBoneToVertex(const std::string_view boneID, const std::string_view vertexID);
+            void ConnectBones(const std::string_view parentID, const std::string_view childID);
+            void AddKey(const std::string_view animationID, const std::string_view boneID,
                         const size_t frame, const MeshBoneTransformation &);
-            void AddLayer(const std::string &animationID, const std::string &boneID);
-            void AddAnimation(const std::string &animationID, const size_t length);
+            void AddLayer(const std::string_view animationID, const std::string_view boneID);
+            void AddAnimation(const std::string_view animationID, const size_t length);
+
+            /**
+             *  Makes the recorded calls of consecutive parts of a document, in phases: first all
+             *  vertices, then the faces, subsets, bones and animations, like the libxml2 parser
+             *  does. Every id is looked up once, in the mesh's own maps, which are sized up front.
+             *  The corners of the vertices are linked in bulk, after all faces have been added.
+             *
+             *  Throws the same errors as the separate calls would, for the same mistakes.
+             *  When there's more than one, which comes first may differ.
+             */
+            void AddRecords(const MeshDataRecords *, const size_t countRecords);
+
+            /**
+             *  Only makes the recorded layer and key calls, which don't touch anything but the
+             *  animations. Other threads may use the rest of the mesh meanwhile.
+             */
+            void AddAnimationRecords(const MeshDataRecords *, const size_t countRecords);
 
             MeshData *GetMeshData(void);
     };
@@ -55,16 +184,22 @@ namespace XMLMesh
         private:
             MeshState *pMeshState;
         public:
-            MeshStateBuilder(void);
-
-            void AddVertex(const std::string &id, const vec3 &position);
-            void AddQuad(const std::string id, const bool smooth,
-                         const MeshTexCoords *, const std::string *vertexIDs);
-            void AddTriangle(const std::string id, const bool smooth,
-                             const MeshTexCoords *, const std::string *vertexIDs);
-            void AddSubset(const std::string &id);
-            void AddQuadToSubset(const std::string &subsetID, const std::string &quadID);
-            void AddTriangleToSubset(const std::string &subsetID, const std::string &triangleID);
+            MeshStateBuilder(std::pmr::memory_resource *pResource = std::pmr::get_default_resource());
+
+            void AddVertex(const std::string_view id, const vec3 &position);
+            void AddQuad(const std::string_view id, const bool smooth,
+                         const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddTriangle(const std::string_view id, const bool smooth,
+                             const MeshTexCoords *, const std::string_view *vertexIDs);
+            void AddSubset(const std::string_view id);
+            void AddQuadToSubset(const std::string_view subsetID, const std::string_view quadID);
+            void AddTriangleToSubset(const std::string_view subsetID, const std::string_view triangleID);
+
+            /**
+             *  Lets ids numbered below the counts come in any order, and still be
+             *  looked up by number. DeriveMeshState copies them in hash order.
+             */
+            void ReserveNumberedIDs(const size_t countVertices, const size_t countFaces);
 
             MeshState *GetMeshState(void);
     };
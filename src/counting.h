@@ -0,0 +1,63 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef COUNTING_H
+#define COUNTING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "stats.h"
+
+
+namespace XMLMesh
+{
+    // One per field of MeshStatistics, in the same order.
+    enum MeshCounter
+    {
+        MESHCOUNTER_KEYS_SCANNED,
+        MESHCOUNTER_EXACT_KEYS,
+        MESHCOUNTER_INTERPOLATIONS,
+        MESHCOUNTER_BONES_EVALUATED,
+        MESHCOUNTER_PARENT_STEPS,
+        MESHCOUNTER_VERTICES_SKINNED,
+        MESHCOUNTER_NORMALS_COMPUTED,
+        MESHCOUNTER_BUFFER_BYTES,
+
+        COUNT_MESHCOUNTERS
+    };
+
+    extern std::atomic<bool> meshStatisticsEnabled;
+
+    inline bool IsCountingMeshWork(void)
+    {
+        return meshStatisticsEnabled.load(std::memory_order_relaxed);
+    }
+
+    void AddToThreadCounter(const MeshCounter, const uint64_t amount);
+
+    /**
+     *  Hot loops should add up their work locally and count it once, after the loop.
+     *  If the amount takes work to calculate, check IsCountingMeshWork first.
+     */
+    inline void CountMeshWork(const MeshCounter counter, const uint64_t amount)
+    {
+        if (IsCountingMeshWork())
+            AddToThreadCounter(counter, amount);
+    }
+}
+#endif  // COUNTING_H
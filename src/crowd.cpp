@@ -0,0 +1,221 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <vector>
+#include <algorithm>
+
+#include "crowd.h"
+#include "animate.h"
+#include "parallel.h"
+#include "tracing.h"
+#include "counting.h"
+
+
+// Instances per task, for spreading the work over the threads.
+#define INSTANCE_CHUNK_SIZE 64
+
+
+namespace XMLMesh
+{
+    struct InstanceFrame
+    {
+        size_t instanceIndex;
+        float frame;
+    };
+
+    /**
+     *  Writes palettes directly to the output.
+     */
+    class PaletteOutput
+    {
+        private:
+            MeshBonePaletteEntry *palettes;
+            size_t countBones;
+        public:
+            PaletteOutput(MeshBonePaletteEntry *p, const size_t n): palettes(p), countBones(n) {}
+
+            MeshBonePaletteEntry *GetPaletteBuffer(const size_t instanceIndex, MeshBonePaletteEntry *)
+            {
+                return palettes + instanceIndex * countBones;
+            }
+            void Write(const size_t, const MeshBonePaletteEntry *)
+            {
+            }
+            void Copy(const size_t instanceIndex, const size_t fromInstanceIndex)
+            {
+                std::copy(palettes + fromInstanceIndex * countBones,
+                          palettes + (fromInstanceIndex + 1) * countBones,
+                          palettes + instanceIndex * countBones);
+            }
+    };
+
+    /**
+     *  Skins the mesh with palettes from a scratch buffer.
+     */
+    class PositionOutput
+    {
+        private:
+            const MeshSkeleton *pSkeleton;
+            vec3 *positions;
+            size_t countVertices;
+            MeshSkinningMode mode;
+        public:
+            PositionOutput(const MeshSkeleton *pS, vec3 *p, const MeshSkinningMode m)
+            : pSkeleton(pS), positions(p), countVertices(pS->CountVertices()), mode(m) {}
+
+            MeshBonePaletteEntry *GetPaletteBuffer(const size_t, MeshBonePaletteEntry *scratch)
+            {
+                return scratch;
+            }
+            void Write(const size_t instanceIndex, const MeshBonePaletteEntry *palette)
+            {
+                SkinVertices(pSkeleton, palette, positions + instanceIndex * countVertices, mode);
+                CountMeshWork(MESHCOUNTER_BUFFER_BYTES, countVertices * sizeof(vec3));
+            }
+            void Copy(const size_t instanceIndex, const size_t fromInstanceIndex)
+            {
+                std::copy(positions + fromInstanceIndex * countVertices,
+                          positions + (fromInstanceIndex + 1) * countVertices,
+                          positions + instanceIndex * countVertices);
+                CountMeshWork(MESHCOUNTER_BUFFER_BYTES, countVertices * sizeof(vec3));
+            }
+    };
+
+    template <typename Output>
+    void EvaluateInstances(const MeshSkeleton *pSkeleton, const MeshInstance *instances, const size_t countInstances,
+                           const float framesPerSecond, Output &output, const size_t countThreads)
+    {
+        MeshTraceZone zone("EvaluateInstances");
+
+        std::vector<InstanceFrame> order(countInstances);
+        size_t i;
+        for (i = 0; i < countInstances; i++)
+        {
+            if (instances[i].animationIndex >= pSkeleton->CountAnimations())
+                throw MeshKeyError("No such animation index: %u", instances[i].animationIndex);
+
+            order[i].instanceIndex = i;
+            order[i].frame = GetAnimationFrame(pSkeleton, instances[i].animationIndex,
+                                               instances[i].msSinceStart, framesPerSecond, instances[i].loop);
+        }
+
+        // Group the instances by animation, then sort them by frame.
+        std::sort(order.begin(), order.end(),
+                  [instances](const InstanceFrame &a, const InstanceFrame &b)
+                  {
+                      const MeshInstance &instanceA = instances[a.instanceIndex],
+                                         &instanceB = instances[b.instanceIndex];
+
+                      if (instanceA.animationIndex != instanceB.animationIndex)
+                          return instanceA.animationIndex < instanceB.animationIndex;
+                      if (instanceA.loop != instanceB.loop)
+                          return instanceB.loop;
+                      return a.frame < b.frame;
+                  });
+
+        const size_t countChunks = (countInstances + INSTANCE_CHUNK_SIZE - 1) / INSTANCE_CHUNK_SIZE;
+
+        ParallelFor(countChunks, countThreads,
+            [&](const size_t chunkIndex)
+            {
+                MeshTraceZone chunkZone("instance chunk");
+
+                std::vector<MeshBoneTransformation> pose(pSkeleton->CountBones());
+                std::vector<MeshBonePaletteEntry> scratch(pSkeleton->CountBones());
+                std::vector<size_t> countsKeysUntil;
+
+                const size_t begin = chunkIndex * INSTANCE_CHUNK_SIZE,
+                             end = std::min(begin + INSTANCE_CHUNK_SIZE, countInstances);
+                const MeshInstance *pPrevious = NULL;
+                float previousFrame = 0.0f;
+                size_t previousIndex = 0,
+                       countKeysScanned = 0,
+                       j, layerIndex;
+                for (j = begin; j < end; j++)
+                {
+                    const MeshInstance &instance = instances[order[j].instanceIndex];
+                    const float frame = order[j].frame;
+                    const MeshSkeletonAnimation *pAnimation = pSkeleton->GetAnimation(instance.animationIndex);
+
+                    bool sameGroup = pPrevious != NULL && pPrevious->animationIndex == instance.animationIndex
+                                                       && pPrevious->loop == instance.loop;
+                    if (sameGroup && previousFrame == frame)
+                    {
+                        output.Copy(order[j].instanceIndex, previousIndex);
+                        continue;
+                    }
+
+                    if (sameGroup)
+                    {
+                        // Frames only go up within a group, so the key search can resume where it was.
+                        for (layerIndex = 0; layerIndex < pAnimation->layers.size(); layerIndex++)
+                        {
+                            const std::vector<size_t> &keyFrames = pAnimation->layers[layerIndex].keyFrames;
+                            while (countsKeysUntil[layerIndex] < keyFrames.size()
+                                   && float(keyFrames[countsKeysUntil[layerIndex]]) <= frame)
+                            {
+                                countsKeysUntil[layerIndex]++;
+                                countKeysScanned++;
+                            }
+                        }
+
+                        // Plus the key that stopped each search.
+                        countKeysScanned += pAnimation->layers.size();
+                    }
+                    else
+                    {
+                        countsKeysUntil.resize(pAnimation->layers.size());
+                        for (layerIndex = 0; layerIndex < pAnimation->layers.size(); layerIndex++)
+                            countsKeysUntil[layerIndex] = CountKeysUntil(pAnimation->layers[layerIndex], frame);
+                    }
+
+                    std::fill(pose.begin(), pose.end(), MESHBONETRANSFORM_ID);
+                    for (layerIndex = 0; layerIndex < pAnimation->layers.size(); layerIndex++)
+                    {
+                        const MeshSkeletonLayer &layer = pAnimation->layers[layerIndex];
+                        pose[layer.boneIndex] = SampleSkeletonLayer(layer, pAnimation->length, frame,
+                                                                    instance.loop, countsKeysUntil[layerIndex]);
+                    }
+
+                    MeshBonePaletteEntry *palette = output.GetPaletteBuffer(order[j].instanceIndex, scratch.data());
+                    GetBonePalette(pSkeleton, pose.data(), palette);
+                    output.Write(order[j].instanceIndex, palette);
+
+                    pPrevious = &instance;
+                    previousFrame = frame;
+                    previousIndex = order[j].instanceIndex;
+                }
+
+                CountMeshWork(MESHCOUNTER_KEYS_SCANNED, countKeysScanned);
+            });
+    }
+
+    void GetInstanceBonePalettes(const MeshSkeleton *pSkeleton, const MeshInstance *instances, const size_t countInstances,
+                                 const float framesPerSecond, MeshBonePaletteEntry *palettesOut,
+                                 const size_t countThreads)
+    {
+        PaletteOutput output(palettesOut, pSkeleton->CountBones());
+        EvaluateInstances(pSkeleton, instances, countInstances, framesPerSecond, output, countThreads);
+    }
+
+    void SkinInstances(const MeshSkeleton *pSkeleton, const MeshInstance *instances, const size_t countInstances,
+                       const float framesPerSecond, vec3 *positionsOut,
+                       const size_t countThreads, const MeshSkinningMode mode)
+    {
+        PositionOutput output(pSkeleton, positionsOut, mode);
+        EvaluateInstances(pSkeleton, instances, countInstances, framesPerSecond, output, countThreads);
+    }
+}
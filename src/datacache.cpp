@@ -0,0 +1,237 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "datacache.h"
+#include "meshmemory.h"
+#include "loading.h"
+
+
+namespace XMLMesh
+{
+    MeshDataCache::MeshDataCache(void): usedBytes(0), countLoading(0), countHits(0), countMisses(0)
+    {
+    }
+    MeshDataCache::~MeshDataCache(void)
+    {
+    }
+
+    bool MeshDataCache::StartEntry(const std::string &key, std::promise<MeshDataHandle> &promise,
+                                   std::shared_future<MeshDataHandle> &futureOut)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (HAS_ID(mEntries, key))
+        {
+            std::list<MeshDataCacheEntry>::iterator it = mEntries.at(key);
+
+            // Mark as most recently used.
+            entries.splice(entries.begin(), entries, it);
+            countHits++;
+
+            if (it->pMeshData)
+            {
+                std::promise<MeshDataHandle> ready;
+                ready.set_value(it->pMeshData);
+                futureOut = ready.get_future().share();
+            }
+            else
+                futureOut = it->future;
+
+            return false;
+        }
+
+        countMisses++;
+
+        entries.emplace_front();
+        entries.front().key = key;
+        entries.front().future = promise.get_future().share();
+        entries.front().countBytes = 0;
+        mEntries.emplace(entries.front().key, entries.begin());
+        countLoading++;
+
+        futureOut = entries.front().future;
+        return true;
+    }
+
+    void MeshDataCache::Load(const std::string &key, const std::function<MeshData *(void)> &load,
+                             std::promise<MeshDataHandle> &promise)
+    {
+        MeshDataHandle pMeshData;
+        std::exception_ptr error;
+        try
+        {
+            pMeshData = MeshDataHandle(load(), DestroyMeshData);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::vector<MeshDataHandle> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // Entries that are loading are never evicted.
+            std::list<MeshDataCacheEntry>::iterator it = mEntries.at(key);
+            if (pMeshData)
+            {
+                // This one is held here too, so it's not evicted yet.
+                it->pMeshData = pMeshData;
+                it->future = std::shared_future<MeshDataHandle>();
+                it->countBytes = GetMemoryUsage(pMeshData.get()).GetTotal() + it->key.size();
+                usedBytes += it->countBytes;
+
+                Evict(maxBytes, evicted);
+            }
+            else
+            {
+                mEntries.erase(key);
+                entries.erase(it);
+            }
+
+            // Notified with the lock held, because the cache may be destroyed right after unlocking it.
+            countLoading--;
+            loadFinished.notify_all();
+        }
+
+        if (pMeshData)
+            promise.set_value(pMeshData);
+        else
+            promise.set_exception(error);
+    }
+
+    MeshDataHandle MeshDataCache::Get(const std::string &key, const std::function<MeshData *(void)> &load)
+    {
+        std::promise<MeshDataHandle> promise;
+        std::shared_future<MeshDataHandle> future;
+        if (StartEntry(key, promise, future))
+            Load(key, load, promise);
+
+        return future.get();
+    }
+
+    void MeshDataCache::Evict(const size_t limit, std::vector<MeshDataHandle> &evictedOut)
+    {
+        std::list<MeshDataCacheEntry>::iterator it = entries.end();
+        while (usedBytes > limit && it != entries.begin())
+        {
+            it--;
+
+            // Not loading and not held by anyone else.
+            if (it->pMeshData && it->pMeshData.use_count() == 1)
+            {
+                evictedOut.push_back(it->pMeshData);
+                usedBytes -= it->countBytes;
+                mEntries.erase(it->key);
+                it = entries.erase(it);
+            }
+        }
+    }
+
+    std::shared_future<MeshDataHandle> MeshDataCache::LoadFile(const std::string &path)
+    {
+        const std::string key = "file:" + path;
+
+        // Shared, because std::function needs a task that can be copied.
+        std::shared_ptr<std::promise<MeshDataHandle>> pPromise = std::make_shared<std::promise<MeshDataHandle>>();
+        std::shared_future<MeshDataHandle> future;
+        if (!StartEntry(key, *pPromise, future))
+            return future;
+
+        const MeshExecutor executor = options.executor ? options.executor : GetDefaultMeshExecutor();
+        executor([this, key, path, pPromise](void)
+        {
+            Load(key, [this, &path](void) { return ParseMeshFile(path, options); }, *pPromise);
+        });
+
+        return future;
+    }
+
+    MeshDataHandle MeshDataCache::GetFile(const std::string &path)
+    {
+        return Get("file:" + path, [this, &path](void) { return ParseMeshFile(path, options); });
+    }
+
+    MeshDataHandle MeshDataCache::GetDocument(std::istream &is)
+    {
+        std::string text;
+        ReadText(is, text, NULL);
+
+        // A hash could collide and give the mesh of another document.
+        return Get("document:" + text, [this, &text](void)
+        {
+            MeshLoadState state(options.onProgress);
+            return ParseMeshText(text, options.pResource, options.useScanner, options.countThreads, &state);
+        });
+    }
+
+    size_t MeshDataCache::CountHits(void) const
+    {
+        return countHits;
+    }
+    size_t MeshDataCache::CountMisses(void) const
+    {
+        return countMisses;
+    }
+    void MeshDataCache::ResetCounters(void)
+    {
+        countHits = 0;
+        countMisses = 0;
+    }
+
+    size_t MeshDataCache::CountMeshes(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    size_t MeshDataCache::GetUsedBytes(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return usedBytes;
+    }
+    size_t MeshDataCache::GetMaxBytes(void) const
+    {
+        return maxBytes;
+    }
+    void MeshDataCache::Clear(void)
+    {
+        std::vector<MeshDataHandle> evicted;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Evict(0, evicted);
+    }
+
+    MeshDataCache *CreateMeshDataCache(const size_t maxBytes, const MeshLoadOptions &options)
+    {
+        MeshDataCache *pCache = new MeshDataCache;
+        pCache->options = options;
+        pCache->options.lazyAnimations = false;  // animations read later wouldn't be counted
+        pCache->maxBytes = maxBytes;
+
+        return pCache;
+    }
+
+    void DestroyMeshDataCache(MeshDataCache *pCache)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pCache->mutex);
+            pCache->loadFinished.wait(lock, [pCache](void) { return pCache->countLoading == 0; });
+        }
+
+        delete pCache;
+    }
+}
@@ -16,8 +16,10 @@
 
 
 #include <cstdarg>
+#include <cstring>
 
 #include "mesh.h"
+#include "load.h"
 
 
 namespace XMLMesh
@@ -40,6 +42,10 @@ namespace XMLMesh
 
         va_end(pArgs);
     }
+    MeshLoadCancelled::MeshLoadCancelled(void)
+    {
+        strncpy(buffer, "mesh loading was cancelled", ERRORBUF_SIZE);
+    }
     const char *MeshError::what(void) const noexcept
     {
         return buffer;
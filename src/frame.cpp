@@ -0,0 +1,179 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "frame.h"
+#include "tracing.h"
+#include "counting.h"
+
+
+namespace XMLMesh
+{
+    MeshFrameEvaluator::MeshFrameEvaluator(void): countIndices(0)
+    {
+    }
+    MeshFrameEvaluator::~MeshFrameEvaluator(void)
+    {
+    }
+
+    const MeshSkeleton *MeshFrameEvaluator::GetSkeleton(void) const
+    {
+        return pSkeleton;
+    }
+    MeshSkinningMode MeshFrameEvaluator::GetMode(void) const
+    {
+        return mode;
+    }
+    size_t MeshFrameEvaluator::CountBufferVertices(void) const
+    {
+        return cornerVertexIndices.size();
+    }
+    size_t MeshFrameEvaluator::CountBufferIndices(void) const
+    {
+        return countIndices;
+    }
+
+    MeshFrameEvaluator *CreateMeshFrameEvaluator(const MeshSkeleton *pSkeleton, const MeshSkinningMode mode)
+    {
+        if (!pSkeleton->HasNormals())
+            throw MeshKeyError("The skeleton was compiled without normals");
+
+        MeshFrameEvaluator *pEvaluator = new MeshFrameEvaluator;
+        pEvaluator->pSkeleton = pSkeleton;
+        pEvaluator->mode = mode;
+
+        try
+        {
+            pEvaluator->pose.resize(pSkeleton->CountBones());
+            pEvaluator->palette.resize(pSkeleton->CountBones());
+            pEvaluator->positions.resize(pSkeleton->CountVertices());
+            pEvaluator->normals.resize(pSkeleton->CountVertices());
+            pEvaluator->tangents.resize(pSkeleton->CountVertices());
+
+            pEvaluator->faceCornerOffsets.push_back(0);
+            for (const MeshFace *pFace : pSkeleton->GetMeshData()->IterFaces())
+            {
+                for (const MeshCorner &corner : pFace->IterCorners())
+                {
+                    pEvaluator->cornerVertexIndices.push_back(pSkeleton->GetVertexIndex(corner.GetVertex()->GetID()));
+                    pEvaluator->cornerTexCoords.push_back(corner.GetTexCoords());
+                }
+
+                // Triangle fan: a triangle has one, a quad has two.
+                pEvaluator->countIndices += 3 * (pFace->CountCorners() - 2);
+
+                pEvaluator->faceCornerOffsets.push_back(pEvaluator->cornerVertexIndices.size());
+                pEvaluator->smoothFaces.push_back(pFace->IsSmooth());
+            }
+        }
+        catch (...)
+        {
+            delete pEvaluator;
+
+            std::rethrow_exception(std::current_exception());
+        }
+
+        return pEvaluator;
+    }
+
+    void DestroyMeshFrameEvaluator(MeshFrameEvaluator *pEvaluator)
+    {
+        delete pEvaluator;
+    }
+
+    void GetBufferIndices(const MeshFrameEvaluator *pEvaluator, MeshBufferIndex *indicesOut)
+    {
+        size_t faceIndex, i, indexNumber = 0;
+        MeshBufferIndex first;
+        for (faceIndex = 0; faceIndex < pEvaluator->smoothFaces.size(); faceIndex++)
+        {
+            first = pEvaluator->faceCornerOffsets[faceIndex];
+            for (i = first + 2; i < pEvaluator->faceCornerOffsets[faceIndex + 1]; i++)
+            {
+                indicesOut[indexNumber++] = first;
+                indicesOut[indexNumber++] = i - 1;
+                indicesOut[indexNumber++] = i;
+            }
+        }
+
+        CountMeshWork(MESHCOUNTER_BUFFER_BYTES, indexNumber * sizeof(MeshBufferIndex));
+    }
+
+    void MeshFrameEvaluator::FillBuffer(MeshBufferVertex *verticesOut) const
+    {
+        MeshTraceZone zone("fill buffer");
+
+        const size_t countFaces = smoothFaces.size();
+        size_t faceIndex, begin, end, i, prev, next, countFlatFaces = 0;
+        vec3 faceNormal;
+
+        for (faceIndex = 0; faceIndex < countFaces; faceIndex++)
+        {
+            begin = faceCornerOffsets[faceIndex];
+            end = faceCornerOffsets[faceIndex + 1];
+
+            if (!smoothFaces[faceIndex])
+            {
+                // Like CalculateFaceNormal, but on the skinned positions.
+                faceNormal = vec3(0.0f);
+                for (i = begin; i < end; i++)
+                {
+                    prev = (i == begin) ? end - 1 : i - 1;
+                    next = (i + 1 == end) ? begin : i + 1;
+
+                    const vec3 &position = positions[cornerVertexIndices[i]];
+                    faceNormal += normalize(cross(position - positions[cornerVertexIndices[prev]],
+                                                  positions[cornerVertexIndices[next]] - position));
+                }
+                faceNormal = normalize(faceNormal);
+                countFlatFaces++;
+            }
+
+            for (i = begin; i < end; i++)
+            {
+                const size_t vertexIndex = cornerVertexIndices[i];
+
+                verticesOut[i].position = positions[vertexIndex];
+                verticesOut[i].normal = smoothFaces[faceIndex] ? normals[vertexIndex] : faceNormal;
+                verticesOut[i].tangent = tangents[vertexIndex];
+                verticesOut[i].texCoords = cornerTexCoords[i];
+            }
+        }
+
+        CountMeshWork(MESHCOUNTER_NORMALS_COMPUTED, countFlatFaces);
+        CountMeshWork(MESHCOUNTER_BUFFER_BYTES, cornerVertexIndices.size() * sizeof(MeshBufferVertex));
+    }
+
+    void EvaluateFrame(MeshFrameEvaluator *pEvaluator, const MeshBoneTransformation *pose, MeshBufferVertex *verticesOut)
+    {
+        MeshTraceZone zone("EvaluateFrame");
+
+        GetBonePalette(pEvaluator->pSkeleton, pose, pEvaluator->palette.data());
+        SkinVertices(pEvaluator->pSkeleton, pEvaluator->palette.data(), pEvaluator->positions.data(),
+                     pEvaluator->normals.data(), pEvaluator->tangents.data(), pEvaluator->mode);
+        pEvaluator->FillBuffer(verticesOut);
+    }
+
+    void EvaluateFrame(MeshFrameEvaluator *pEvaluator, const size_t animationIndex,
+                       const milliseconds msSinceStart, const float framesPerSecond, const bool loop,
+                       MeshBufferVertex *verticesOut)
+    {
+        GetSkeletonPoseAt(pEvaluator->pSkeleton, animationIndex,
+                          GetAnimationFrame(pEvaluator->pSkeleton, animationIndex, msSinceStart, framesPerSecond, loop),
+                          loop, pEvaluator->pose.data());
+        EvaluateFrame(pEvaluator, pEvaluator->pose.data(), verticesOut);
+    }
+}
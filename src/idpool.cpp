@@ -0,0 +1,54 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cstring>
+
+#include "idpool.h"
+
+
+namespace XMLMesh
+{
+    MeshIDPool::MeshIDPool(std::pmr::memory_resource *pResource): characters(pResource), ids(pResource)
+    {
+    }
+
+    std::string_view MeshIDPool::Intern(const std::string_view id)
+    {
+        auto it = ids.find(id);
+        if (it != ids.end())
+            return *it;
+
+        char *p = (char *)characters.allocate(id.size() + 1, 1);
+        memcpy(p, id.data(), id.size());
+        p[id.size()] = '\0';
+
+        const std::string_view interned(p, id.size());
+        ids.insert(interned);
+
+        return interned;
+    }
+
+    void MeshIDPool::Reserve(const size_t countIDs)
+    {
+        ids.reserve(countIDs);
+    }
+
+    size_t MeshIDPool::CountIDs(void) const
+    {
+        return ids.size();
+    }
+}
@@ -0,0 +1,55 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef IDPOOL_H
+#define IDPOOL_H
+
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+
+#include "iter.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Stores every distinct id of a mesh once. The views it hands out stay valid,
+     *  and NUL-terminated, for as long as the pool exists.
+     *
+     *  The same text always gives the same pointer, so interned ids can be compared by pointer.
+     */
+    class MeshIDPool
+    {
+        private:
+            std::pmr::monotonic_buffer_resource characters;
+            std::pmr::unordered_set<std::string_view, std::hash<std::string_view>, MeshIDEqual> ids;
+        public:
+            MeshIDPool(std::pmr::memory_resource *);
+
+            MeshIDPool(const MeshIDPool &) = delete;
+            void operator=(const MeshIDPool &) = delete;
+
+            std::string_view Intern(const std::string_view id);
+
+            // Makes room for this many distinct ids in total.
+            void Reserve(const size_t countIDs);
+
+            size_t CountIDs(void) const;
+    };
+}
+#endif  // IDPOOL_H
@@ -0,0 +1,112 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <fstream>
+
+#include "lazy.h"
+#include "build.h"
+#include "scan.h"
+#include "tracing.h"
+
+
+namespace XMLMesh
+{
+    MeshLazyAnimations::MeshLazyAnimations(const std::string &p, const size_t s, std::pmr::memory_resource *pResource)
+    : path(pResource), fileSize(s), mLocations(pResource)
+    {
+        std::error_code error;
+        const std::filesystem::path absolutePath = std::filesystem::absolute(p, error);
+        path = error ? p : absolutePath.string();
+
+        // When the time can't be read now, it won't compare equal later.
+        fileTime = std::filesystem::last_write_time(absolutePath, error);
+    }
+
+    void MeshLazyAnimations::Add(const MeshSkeletalAnimation *pAnimation, const size_t offset, const std::string_view contents)
+    {
+        mLocations.emplace(std::piecewise_construct, std::forward_as_tuple(pAnimation),
+                           std::forward_as_tuple(offset, contents.size(), std::hash<std::string_view>()(contents)));
+    }
+
+    bool MeshLazyAnimations::IsLoaded(const MeshSkeletalAnimation *pAnimation) const
+    {
+        auto it = mLocations.find(pAnimation);
+        return it == mLocations.end() || std::get<1>(*it).loaded.load(std::memory_order_acquire);
+    }
+
+    void MeshLazyAnimations::Load(MeshData *pMeshData, MeshSkeletalAnimation *pAnimation)
+    {
+        // The locations are only added while parsing, so they can be looked up without the lock.
+        auto it = mLocations.find(pAnimation);
+        if (it == mLocations.end() || std::get<1>(*it).loaded.load(std::memory_order_acquire))
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Location &location = std::get<1>(*it);
+        if (location.loaded.load(std::memory_order_relaxed))  // another thread was first
+            return;
+
+        MeshTraceZone zone("load animation");
+
+        std::string text(location.length, '\0');
+        {
+            std::error_code error;
+            const std::filesystem::file_time_type time = std::filesystem::last_write_time(path.c_str(), error);
+
+            std::ifstream is(path.c_str(), std::ios::binary);
+            if (error || time != fileTime
+                    || !is.is_open() || !is.seekg(0, std::ios::end) || size_t(is.tellg()) != fileSize
+                    || !is.seekg(location.offset) || !is.read(&text[0], location.length)
+                    || std::hash<std::string_view>()(text) != location.contentsHash)
+                throw MeshParseError("cannot read animation %s from %s, or the file has changed",
+                                     pAnimation->id.data(), path.c_str());
+        }
+
+        // Like ParseMeshData, libxml2 gets what the scanner doesn't handle, and tells what's wrong.
+        MeshDataBuilder builder(pMeshData);
+        try
+        {
+            MeshDataRecords records;
+            bool scanned = ScanMeshAnimation(text.data(), text.size(), pAnimation->id, records);
+            if (scanned)
+            {
+                try
+                {
+                    builder.AddAnimationRecords(&records, 1);
+                }
+                catch (const MeshError &)
+                {
+                    scanned = false;
+                }
+            }
+
+            if (!scanned)
+            {
+                pAnimation->mLayers.clear();
+                ParseMeshAnimation(text, pAnimation->id, builder);
+            }
+        }
+        catch (...)
+        {
+            pAnimation->mLayers.clear();
+            throw;
+        }
+
+        location.loaded.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,74 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "mesh.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Where the contents of a mesh's animations are in its file, so that they can be
+     *  loaded on first use. Only the layers and keys of the animation are built then,
+     *  one animation at a time, while other threads may be using the rest of the mesh.
+     */
+    class MeshLazyAnimations
+    {
+        private:
+            struct Location
+            {
+                size_t offset, length;  // between the start and end tag
+                size_t contentsHash;  // to notice that the file has changed, even to the same size
+                std::atomic<bool> loaded;
+
+                Location(const size_t o, const size_t l, const size_t h)
+                : offset(o), length(l), contentsHash(h), loaded(false) {}
+            };
+
+            std::pmr::string path;  // absolute, so that the working directory may change
+
+            // To notice that the file has changed.
+            size_t fileSize;
+            std::filesystem::file_time_type fileTime;
+
+            std::mutex mutex;
+            std::pmr::unordered_map<const MeshSkeletalAnimation *, Location> mLocations;
+        public:
+            MeshLazyAnimations(const std::string &path, const size_t fileSize, std::pmr::memory_resource *);
+
+            // The contents are the ones that were read from the file, at the offset.
+            void Add(const MeshSkeletalAnimation *, const size_t offset, const std::string_view contents);
+
+            bool IsLoaded(const MeshSkeletalAnimation *) const;
+
+            /**
+             *  Does nothing if the animation has been loaded already. When loading fails,
+             *  the animation is left without layers and the next call tries again.
+             *  Throws a MeshParseError if the file's size, time or contents have changed.
+             */
+            void Load(MeshData *, MeshSkeletalAnimation *);
+    };
+}
+
+#endif  // LAZY_H
@@ -0,0 +1,379 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <chrono>
+#include <fstream>
+
+#include "loading.h"
+#include "parallel.h"
+#include "tracing.h"
+
+
+namespace XMLMesh
+{
+    MeshThreadPool::MeshThreadPool(const size_t countThreads): stopping(false)
+    {
+        size_t i;
+        for (i = 0; i < CountWorkerThreads(countThreads); i++)
+            threads.emplace_back(&MeshThreadPool::Work, this);
+    }
+
+    MeshThreadPool::~MeshThreadPool(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        taskAdded.notify_all();
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    void MeshThreadPool::Work(void)
+    {
+        while (true)
+        {
+            MeshTask task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                taskAdded.wait(lock, [this](void) { return stopping || !tasks.empty(); });
+
+                // When stopping, the remaining tasks are still run.
+                if (tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    size_t MeshThreadPool::CountThreads(void) const
+    {
+        return threads.size();
+    }
+
+    void MeshThreadPool::Submit(MeshTask task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(task));
+        }
+        taskAdded.notify_one();
+    }
+
+    MeshExecutor MeshThreadPool::GetExecutor(void)
+    {
+        return [this](MeshTask task) { Submit(std::move(task)); };
+    }
+
+    MeshExecutor GetDefaultMeshExecutor(void)
+    {
+        static MeshThreadPool pool;
+
+        return pool.GetExecutor();
+    }
+
+
+    MeshLoadState::MeshLoadState(const MeshProgressCallback &callback)
+    : onProgress(callback), cancelled(false), phase(MESHLOAD_QUEUED), bytesDone(0), bytesTotal(0)
+    {
+    }
+
+    void MeshLoadState::Report(void)
+    {
+        if (!onProgress)
+            return;
+
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        onProgress(GetProgress());
+    }
+
+    void MeshLoadState::Cancel(void)
+    {
+        cancelled = true;
+    }
+
+    void MeshLoadState::CheckCancelled(void) const
+    {
+        if (cancelled.load(std::memory_order_relaxed))
+            throw MeshLoadCancelled();
+    }
+
+    MeshLoadProgress MeshLoadState::GetProgress(void) const
+    {
+        MeshLoadProgress progress;
+        progress.phase = phase;
+        progress.bytesDone = bytesDone;
+        progress.bytesTotal = bytesTotal;
+        return progress;
+    }
+
+    void MeshLoadState::StartPhase(const MeshLoadPhase p, const size_t total)
+    {
+        CheckCancelled();
+
+        bytesDone = 0;
+        bytesTotal = total;
+        phase = p;
+        Report();
+    }
+
+    void MeshLoadState::SetBytesDone(const size_t bytes)
+    {
+        CheckCancelled();
+
+        bytesDone = bytes;
+        Report();
+    }
+
+    void MeshLoadState::AddBytesDone(const size_t bytes)
+    {
+        CheckCancelled();
+
+        bytesDone += bytes;
+        Report();
+    }
+
+    void MeshLoadState::Finish(void)
+    {
+        CheckCancelled();
+
+        bytesDone = bytesTotal.load();
+        phase = MESHLOAD_FINISHED;
+        Report();
+    }
+
+
+    MeshLoadHandle::MeshLoadHandle(std::shared_ptr<MeshLoadState> p, std::future<MeshData *> &&f)
+    : pState(p), future(std::move(f))
+    {
+    }
+
+    void MeshLoadHandle::Cancel(void)
+    {
+        pState->Cancel();
+    }
+
+    MeshLoadProgress MeshLoadHandle::GetProgress(void) const
+    {
+        return pState->GetProgress();
+    }
+
+    std::future<MeshData *> &MeshLoadHandle::GetFuture(void)
+    {
+        return future;
+    }
+
+    MeshLoadHandle StartLoad(const MeshLoadOptions &options, const std::function<MeshData *(MeshLoadState *)> &load)
+    {
+        std::shared_ptr<MeshLoadState> pState = std::make_shared<MeshLoadState>(options.onProgress);
+
+        // std::function needs a task that can be copied.
+        std::shared_ptr<std::promise<MeshData *>> pPromise = std::make_shared<std::promise<MeshData *>>();
+        MeshLoadHandle handle(pState, pPromise->get_future());
+
+        const MeshExecutor executor = options.executor ? options.executor : GetDefaultMeshExecutor();
+        executor([pState, pPromise, load](void)
+        {
+            // ParseMeshData frees what it built before it throws.
+            try
+            {
+                pState->CheckCancelled();
+                pPromise->set_value(load(pState.get()));
+            }
+            catch (...)
+            {
+                pPromise->set_exception(std::current_exception());
+            }
+        });
+
+        return handle;
+    }
+
+    MeshLoadHandle ParseMeshDataAsync(std::istream &is, const MeshLoadOptions &options)
+    {
+        std::istream *pStream = &is;
+        std::pmr::memory_resource *pResource = options.pResource;
+        const bool useScanner = options.useScanner;
+        const size_t countThreads = options.countThreads;
+
+        return StartLoad(options, [=](MeshLoadState *pState)
+        {
+            return ParseMeshData(*pStream, pResource, useScanner, countThreads, pState);
+        });
+    }
+
+    MeshLoadHandle ParseMeshDataAsync(const std::string &path, const MeshLoadOptions &options)
+    {
+        return StartLoad(options, [path, options](MeshLoadState *pState)
+        {
+            return ParseMeshFile(path, options, pState);
+        });
+    }
+
+    MeshData *ParseMeshData(std::istream &is, const MeshLoadOptions &options)
+    {
+        MeshLoadState state(options.onProgress);
+
+        return ParseMeshData(is, options.pResource, options.useScanner, options.countThreads, &state);
+    }
+
+    MeshData *ParseMeshFile(const std::string &path, const MeshLoadOptions &options, MeshLoadState *pLoad)
+    {
+        MeshTraceZone zone("ParseMeshFile");
+
+        std::string text;
+        {
+            MeshTraceZone readZone("read xml");
+
+            std::ifstream is(path, std::ios::binary);
+            if (!is.is_open())
+                throw MeshParseError("cannot open %s", path.c_str());
+
+            ReadText(is, text, pLoad);
+        }
+
+        return ParseMeshText(text, options.pResource, options.useScanner, options.countThreads, pLoad,
+                             options.lazyAnimations ? path : std::string());
+    }
+
+    MeshData *ParseMeshFile(const std::string &path, const MeshLoadOptions &options)
+    {
+        MeshLoadState state(options.onProgress);
+
+        return ParseMeshFile(path, options, &state);
+    }
+
+    typedef std::chrono::steady_clock BatchClock;
+
+    double GetBatchSeconds(const BatchClock::time_point start, const BatchClock::time_point end)
+    {
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    std::vector<MeshBatchResult> ParseMeshFiles(const std::vector<std::string> &paths,
+                                                const MeshBatchOptions &options, MeshBatchStats *pStats)
+    {
+        MeshTraceZone zone("ParseMeshFiles");
+
+        const BatchClock::time_point start = BatchClock::now();
+        double readSeconds = 0.0;
+
+        std::vector<MeshBatchResult> results(paths.size());
+
+        std::mutex mtx;
+        std::condition_variable parsed;
+        size_t countWaiting = 0;
+        {
+            // Destroyed before the results, after it has run all the parsing tasks.
+            MeshThreadPool pool(options.countThreads);
+
+            const size_t countPrefetched = options.countPrefetched > 0 ? options.countPrefetched : 2 * pool.CountThreads();
+
+            size_t i;
+            for (i = 0; i < paths.size(); i++)
+            {
+                MeshBatchResult &result = results[i];
+                result.path = paths[i];
+                result.pMeshData = NULL;
+                result.countBytes = 0;
+
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    parsed.wait(lock, [&](void) { return countWaiting < countPrefetched; });
+                }
+
+                // Shared, because std::function needs a task that can be copied.
+                std::shared_ptr<std::string> pText = std::make_shared<std::string>();
+
+                const BatchClock::time_point readStart = BatchClock::now();
+                try
+                {
+                    MeshTraceZone readZone("read file");
+
+                    std::ifstream is(paths[i], std::ios::binary);
+                    if (!is.is_open())
+                        throw MeshParseError("cannot open %s", paths[i].c_str());
+
+                    ReadText(is, *pText, NULL);
+                }
+                catch (...)
+                {
+                    result.error = std::current_exception();
+                }
+                readSeconds += GetBatchSeconds(readStart, BatchClock::now());
+
+                if (result.error)
+                    continue;
+
+                result.countBytes = pText->size();
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    countWaiting++;
+                }
+
+                MeshBatchResult *pResult = &result;
+                pool.Submit([&, pResult, pText](void) mutable
+                {
+                    // The pool's threads already parse files in parallel.
+                    try
+                    {
+                        pResult->pMeshData = ParseMeshText(*pText, options.pResource, options.useScanner, 1, NULL,
+                                                           options.lazyAnimations ? pResult->path : std::string());
+                    }
+                    catch (...)
+                    {
+                        pResult->error = std::current_exception();
+                    }
+
+                    // Makes room for the next prefetched file.
+                    pText.reset();
+                    {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        countWaiting--;
+                    }
+                    parsed.notify_one();
+                });
+            }
+        }
+
+        if (pStats != NULL)
+        {
+            pStats->countFiles = results.size();
+            pStats->countFailed = 0;
+            pStats->countBytes = 0;
+            for (const MeshBatchResult &result : results)
+            {
+                if (result.error)
+                    pStats->countFailed++;
+                pStats->countBytes += result.countBytes;
+            }
+
+            pStats->seconds = GetBatchSeconds(start, BatchClock::now());
+            pStats->readSeconds = readSeconds;
+            pStats->filesPerSecond = pStats->seconds > 0.0 ? pStats->countFiles / pStats->seconds : 0.0;
+            pStats->bytesPerSecond = pStats->seconds > 0.0 ? pStats->countBytes / pStats->seconds : 0.0;
+        }
+
+        return results;
+    }
+}
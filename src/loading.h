@@ -0,0 +1,84 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef LOADING_H
+#define LOADING_H
+
+#include <atomic>
+#include <mutex>
+
+#include "load.h"
+
+
+// Progress is reported, and cancellation checked, at least this often.
+#define MESHLOAD_REPORT_INTERVAL 0x10000
+
+namespace XMLMesh
+{
+    /**
+     *  Shared by a load and its handle. The parser reports its progress to it, and checks
+     *  it for cancellation, at the start of every phase and every report interval.
+     *  Parsing without a handle passes NULL instead.
+     */
+    class MeshLoadState
+    {
+        private:
+            MeshProgressCallback onProgress;
+            std::mutex callbackMutex;
+
+            std::atomic<bool> cancelled;
+            std::atomic<MeshLoadPhase> phase;
+            std::atomic<size_t> bytesDone,
+                                bytesTotal;
+
+            void Report(void);
+        public:
+            MeshLoadState(const MeshProgressCallback &);
+
+            void Cancel(void);
+
+            // Throws MeshLoadCancelled if the load has been cancelled.
+            void CheckCancelled(void) const;
+
+            MeshLoadProgress GetProgress(void) const;
+
+            void StartPhase(const MeshLoadPhase, const size_t bytesTotal);
+            void SetBytesDone(const size_t);
+
+            // For threads that each get through a part of the document.
+            void AddBytesDone(const size_t);
+
+            // Checks for cancellation one last time, then reports the end.
+            void Finish(void);
+    };
+
+    void ReadText(std::istream &, std::string &text, MeshLoadState *);
+
+    MeshData *ParseMeshData(std::istream &, std::pmr::memory_resource *, const bool useScanner,
+                            const size_t countThreads, MeshLoadState *);
+
+    /**
+     *  For documents that have already been read. When the path of the file that
+     *  it was read from is given, the scanner leaves the animations for later.
+     */
+    MeshData *ParseMeshText(const std::string &text, std::pmr::memory_resource *, const bool useScanner,
+                            const size_t countThreads, MeshLoadState *,
+                            const std::string &lazyAnimationsPath = std::string());
+
+    MeshData *ParseMeshFile(const std::string &path, const MeshLoadOptions &, MeshLoadState *);
+}
+
+#endif  // LOADING_H
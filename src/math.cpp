@@ -15,6 +15,7 @@
 */
 
 #include "mesh.h"
+#include "counting.h"
 
 
 namespace XMLMesh
@@ -47,6 +48,8 @@ namespace XMLMesh
 
     vec3 CalculateFaceNormal(const MeshFace *pFace)
     {
+        CountMeshWork(MESHCOUNTER_NORMALS_COMPUTED, 1);
+
         vec3 sum(0.0f, 0.0f, 0.0f);
         for (const MeshCorner &corner : pFace->IterCorners())
         {
@@ -71,6 +74,8 @@ namespace XMLMesh
 
     vec3 CalculateVertexNormal(const MeshVertex *pVertex)
     {
+        CountMeshWork(MESHCOUNTER_NORMALS_COMPUTED, 1);
+
         vec3 sum(0.0f, 0.0f, 0.0f);
         for (const MeshCorner *pCorner : pVertex->IterCorners())
         {
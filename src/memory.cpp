@@ -0,0 +1,124 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "meshmemory.h"
+#include "accounting.h"
+
+
+namespace XMLMesh
+{
+    MeshCountingResource::MeshCountingResource(std::pmr::memory_resource *p)
+    : pUpstream(p), bytesInUse(0), peakBytesInUse(0), totalBytesAllocated(0), countAllocations(0), countDeallocations(0)
+    {
+    }
+
+    void *MeshCountingResource::do_allocate(size_t bytes, size_t alignment)
+    {
+        void *p = pUpstream->allocate(bytes, alignment);
+
+        const size_t inUse = bytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peakBytesInUse.load(std::memory_order_relaxed);
+        while (inUse > peak && !peakBytesInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed));
+
+        totalBytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+        countAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        return p;
+    }
+
+    void MeshCountingResource::do_deallocate(void *p, size_t bytes, size_t alignment)
+    {
+        pUpstream->deallocate(p, bytes, alignment);
+
+        bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+        countDeallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool MeshCountingResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource *MeshCountingResource::GetUpstream(void) const
+    {
+        return pUpstream;
+    }
+
+    size_t MeshCountingResource::GetBytesInUse(void) const
+    {
+        return bytesInUse.load(std::memory_order_relaxed);
+    }
+    size_t MeshCountingResource::GetPeakBytesInUse(void) const
+    {
+        return peakBytesInUse.load(std::memory_order_relaxed);
+    }
+    size_t MeshCountingResource::GetTotalBytesAllocated(void) const
+    {
+        return totalBytesAllocated.load(std::memory_order_relaxed);
+    }
+
+    size_t MeshCountingResource::CountAllocations(void) const
+    {
+        return countAllocations.load(std::memory_order_relaxed);
+    }
+    size_t MeshCountingResource::CountDeallocations(void) const
+    {
+        return countDeallocations.load(std::memory_order_relaxed);
+    }
+
+    void MeshCountingResource::ResetCounts(void)
+    {
+        peakBytesInUse.store(bytesInUse.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        totalBytesAllocated.store(0, std::memory_order_relaxed);
+        countAllocations.store(0, std::memory_order_relaxed);
+        countDeallocations.store(0, std::memory_order_relaxed);
+    }
+
+    size_t MeshMemoryUsage::GetTotal(void) const
+    {
+        return vertexBytes + faceBytes + adjacencyBytes + idBytes + subsetBytes
+             + boneBytes + animationBytes + hashTableBytes + skinningBytes + objectBytes;
+    }
+
+    MeshMemoryUsage GetMemoryUsage(const MeshMemoryAccounts *pAccounts)
+    {
+        MeshMemoryUsage usage;
+        usage.vertexBytes = pAccounts->Get(MESHMEMORY_VERTICES)->GetBytesInUse();
+        usage.faceBytes = pAccounts->Get(MESHMEMORY_FACES)->GetBytesInUse();
+        usage.adjacencyBytes = pAccounts->Get(MESHMEMORY_ADJACENCY)->GetBytesInUse();
+        usage.idBytes = pAccounts->Get(MESHMEMORY_IDS)->GetBytesInUse();
+        usage.subsetBytes = pAccounts->Get(MESHMEMORY_SUBSETS)->GetBytesInUse();
+        usage.boneBytes = pAccounts->Get(MESHMEMORY_BONES)->GetBytesInUse();
+        usage.animationBytes = pAccounts->Get(MESHMEMORY_ANIMATIONS)->GetBytesInUse();
+        usage.hashTableBytes = pAccounts->Get(MESHMEMORY_HASH_TABLES)->GetBytesInUse();
+        usage.skinningBytes = pAccounts->Get(MESHMEMORY_SKINNING)->GetBytesInUse();
+
+        // The accounts themselves are allocated directly from the resource.
+        usage.objectBytes = pAccounts->Get(MESHMEMORY_OBJECT)->GetBytesInUse() + sizeof(MeshMemoryAccounts);
+
+        return usage;
+    }
+
+    MeshMemoryUsage GetMemoryUsage(const MeshData *pMeshData)
+    {
+        return GetMemoryUsage(pMeshData->pAccounts);
+    }
+    MeshMemoryUsage GetMemoryUsage(const MeshState *pMeshState)
+    {
+        return GetMemoryUsage(pMeshState->pAccounts);
+    }
+}
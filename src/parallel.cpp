@@ -0,0 +1,120 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+
+#include "parallel.h"
+#include "load.h"
+
+
+namespace XMLMesh
+{
+    size_t CountWorkerThreads(const size_t countRequested)
+    {
+        if (countRequested > 0)
+            return countRequested;
+
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     *  Shared with the helpers, because a helper may only start after ParallelFor has returned.
+     *  It then finds the loop closed and leaves, without touching the task.
+     */
+    struct ParallelLoop
+    {
+        const std::function<void (const size_t)> *pTask;
+        size_t countTasks;
+        std::atomic<size_t> nextTask;
+
+        std::mutex mtx;
+        std::condition_variable helperFinished;
+        size_t countHelpers;  // running now
+        bool closed;
+        std::exception_ptr pException;
+
+        void Work(void)
+        {
+            size_t taskIndex;
+            while ((taskIndex = nextTask++) < countTasks)
+            {
+                try
+                {
+                    (*pTask)(taskIndex);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (!pException)
+                        pException = std::current_exception();
+
+                    // Skip the remaining tasks.
+                    nextTask = countTasks;
+                }
+            }
+        }
+    };
+
+    void ParallelFor(const size_t countTasks, const size_t countThreads,
+                     const std::function<void (const size_t)> &task)
+    {
+        // Started on first use, so that no threads are created per call.
+        static MeshThreadPool pool;
+
+        std::shared_ptr<ParallelLoop> pLoop = std::make_shared<ParallelLoop>();
+        pLoop->pTask = &task;
+        pLoop->countTasks = countTasks;
+        pLoop->nextTask = 0;
+        pLoop->countHelpers = 0;
+        pLoop->closed = false;
+
+        size_t i;
+        for (i = 1; i < std::min(CountWorkerThreads(countThreads), countTasks); i++)
+            pool.Submit([pLoop](void)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(pLoop->mtx);
+                    if (pLoop->closed)
+                        return;
+                    pLoop->countHelpers++;
+                }
+
+                pLoop->Work();
+
+                {
+                    std::lock_guard<std::mutex> lock(pLoop->mtx);
+                    pLoop->countHelpers--;
+                }
+                pLoop->helperFinished.notify_one();
+            });
+
+        pLoop->Work();
+
+        // Helpers that haven't started yet, because the pool is busy, aren't waited for.
+        std::unique_lock<std::mutex> lock(pLoop->mtx);
+        pLoop->closed = true;
+        pLoop->helperFinished.wait(lock, [&pLoop](void) { return pLoop->countHelpers == 0; });
+
+        if (pLoop->pException)
+            std::rethrow_exception(pLoop->pException);
+    }
+}
@@ -0,0 +1,40 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+
+namespace XMLMesh
+{
+    /**
+     *  Resolves a requested thread count, where zero means one thread per core.
+     */
+    size_t CountWorkerThreads(const size_t countRequested);
+
+    /**
+     *  Calls 'task' once for every index below 'countTasks', using up to 'countThreads' threads.
+     *  The calling thread takes part in the work, the others come from a pool with one thread
+     *  per core, which is shared by all calls. The first exception thrown by a task is
+     *  rethrown, after all threads have finished.
+     */
+    void ParallelFor(const size_t countTasks, const size_t countThreads,
+                     const std::function<void (const size_t)> &task);
+}
+#endif  // PARALLEL_H
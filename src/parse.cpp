@@ -15,6 +15,8 @@
 */
 
 #include <list>
+#include <string>
+#include <vector>
 #include <cstring>
 #include <exception>
 #include <math.h>
@@ -24,6 +26,9 @@
 
 #include "mesh.h"
 #include "build.h"
+#include "scan.h"
+#include "tracing.h"
+#include "loading.h"
 
 
 namespace XMLMesh
@@ -124,38 +129,82 @@ namespace XMLMesh
         return l;
     }
 
-    xmlDocPtr ParseXML(std::istream &is)
+    void ReadText(std::istream &is, std::string &text, MeshLoadState *pLoad)
     {
-        const size_t bufSize = 1024;
-        std::streamsize res;
+        const size_t bufSize = 4096;
         char buf[bufSize];
+
+        // Streams that can seek tell how much there is to read.
+        size_t total = 0;
+        std::streambuf *pBuf = is.rdbuf();
+        const std::streampos start = pBuf->pubseekoff(0, std::ios::cur, std::ios::in),
+                             end = pBuf->pubseekoff(0, std::ios::end, std::ios::in);
+        if (start != std::streampos(-1) && end != std::streampos(-1))
+        {
+            pBuf->pubseekpos(start, std::ios::in);
+
+            total = end - start;
+            text.reserve(total);
+        }
+
+        if (pLoad != NULL)
+            pLoad->StartPhase(MESHLOAD_READING, total);
+
+        size_t nextReport = MESHLOAD_REPORT_INTERVAL;
+        while (is.good())
+        {
+            is.read(buf, bufSize);
+            text.append(buf, is.gcount());
+
+            if (pLoad != NULL && text.size() >= nextReport)
+            {
+                pLoad->SetBytesDone(text.size());
+                nextReport = text.size() + MESHLOAD_REPORT_INTERVAL;
+            }
+        }
+    }
+
+    xmlDocPtr ParseXML(const std::string &text, MeshLoadState *pLoad)
+    {
         int wellFormed;
 
         xmlParserCtxtPtr pCtxt;
         xmlDocPtr pDoc;
 
-        // Read the first 4 bytes.
-        is.read(buf, 4);
-        if (!is.good())
+        // The first 4 bytes tell the encoding.
+        if (text.size() < 4)
             throw MeshParseError("Error reading the first xml bytes!");
-        res = is.gcount();
 
         // Create a progressive parsing context.
-        pCtxt = xmlCreatePushParserCtxt(NULL, NULL, buf, res, NULL);
+        pCtxt = xmlCreatePushParserCtxt(NULL, NULL, text.data(), 4, NULL);
         if (!pCtxt)
             throw MeshParseError("Failed to create parser context!");
 
-        // Loop on the input, getting the document data.
-        while (is.good())
+        // Pass the rest of the document in pieces, between which the load may be cancelled.
+        size_t position = 4;
+        while (position < text.size())
         {
-            is.read(buf, bufSize);
-            res = is.gcount();
+            const size_t size = std::min(text.size() - position, (size_t)MESHLOAD_REPORT_INTERVAL);
+            xmlParseChunk(pCtxt, text.data() + position, size, 0);
+            position += size;
 
-            xmlParseChunk(pCtxt, buf, res, 0);
+            if (pLoad != NULL)
+            {
+                try
+                {
+                    pLoad->SetBytesDone(position);
+                }
+                catch (...)
+                {
+                    xmlFreeDoc(pCtxt->myDoc);
+                    xmlFreeParserCtxt(pCtxt);
+                    throw;
+                }
+            }
         }
 
-        // There is no more input, indicate the parsing is finished.
-        xmlParseChunk(pCtxt, buf, 0, 1);
+        // Indicate that the parsing is finished.
+        xmlParseChunk(pCtxt, NULL, 0, 1);
 
         // Check if it was well formed.
         pDoc = pCtxt->myDoc;
@@ -270,98 +319,188 @@ namespace XMLMesh
             b = true;
     }
 
-    void ParseStringAttrib(const xmlNodePtr pTag, const xmlChar *key, std::string &s)
+    struct XMLAttributeName
     {
-        xmlChar *pS = xmlGetProp(pTag, key);
-        if (pS == nullptr)
-            throw MeshParseError("Missing %s attribute: %s", (const char *)pTag->name, (const char *)key);
+        const char *name;
+        size_t length;
+    };
 
-        s.assign((const char *)pS);
-        xmlFree(pS);
-    }
+#define XMLATTRIBUTE(s) {s, sizeof(s) - 1}
+#define MAX_XMLATTRIBUTES 8
 
-    void ParseBoolAttrib(const xmlNodePtr pTag, const xmlChar *key, bool &b)
+    /**
+     *  Walks an element's attribute list once and stores each value in the slot of its name,
+     *  by its position in the table. Unknown attributes are skipped.
+     *
+     *  Values point into the xml tree, so they must not outlive the document.
+     *  Only values that libxml2 split up in several nodes, like ones with entity references,
+     *  need to be copied. Those are freed with the XMLAttributes object.
+     */
+    class XMLAttributes
     {
-        xmlChar *pS = xmlGetProp(pTag, key);
-        if (pS == nullptr)
-            throw MeshParseError("Missing %s attribute: %s", (const char *)pTag->name, (const char *)key);
+        private:
+            const xmlNodePtr pTag;
+            const XMLAttributeName *table;
+            const char *values[MAX_XMLATTRIBUTES];
+            std::vector<xmlChar *> copiedValues;
 
-        ParseBool((const char *)pS, b);
+            const char *Get(const size_t slot) const
+            {
+                if (values[slot] == NULL)
+                    throw MeshParseError("Missing %s attribute: %s", (const char *)pTag->name, table[slot].name);
 
-        xmlFree(pS);
-    }
+                return values[slot];
+            }
+        public:
+            template <size_t N>
+            XMLAttributes(const xmlNodePtr p, const XMLAttributeName (&names)[N])
+            : pTag(p), table(names)
+            {
+                static_assert(N <= MAX_XMLATTRIBUTES, "too many attributes in table");
 
-    void ParseFloatAttrib(const xmlNodePtr pTag, const xmlChar *key, float &f)
-    {
-        xmlChar *pS = xmlGetProp(pTag, key);
-        if (pS == nullptr)
-            throw MeshParseError("Missing %s attribute: %s", (const char *)pTag->name, (const char *)key);
+                size_t i, length;
+                for (i = 0; i < N; i++)
+                    values[i] = NULL;
 
-        if (!ParseFloat((const char *)pS, f))
-        {
-            xmlFree(pS);
-            throw MeshParseError("Malformed floating point: %s", (const char *)pS);
-        }
-        xmlFree(pS);
-    }
+                for (xmlAttrPtr pAttr = pTag->properties; pAttr != NULL; pAttr = pAttr->next)
+                {
+                    const char *name = (const char *)pAttr->name;
+                    length = strlen(name);
 
-    void ParseLengthAttrib(const xmlNodePtr pTag, const xmlChar *key, size_t &length)
-    {
-        xmlChar *pS = xmlGetProp(pTag, key);
-        if (pS == nullptr)
-            throw MeshParseError("Missing %s attribute: %s",(const char *)pTag->name, (const char *)key);
+                    for (i = 0; i < N; i++)
+                    {
+                        if (names[i].length == length && name[0] == names[i].name[0]
+                                && memcmp(name, names[i].name, length) == 0)
+                            break;
+                    }
+                    if (i >= N)
+                        continue;
+
+                    xmlNodePtr pValue = pAttr->children;
+                    if (pValue == NULL)
+                        values[i] = "";
+                    else if (pValue->next == NULL && pValue->type == XML_TEXT_NODE)
+                        values[i] = (const char *)pValue->content;
+                    else
+                    {
+                        xmlChar *pCopy = xmlNodeListGetString(pTag->doc, pValue, 1);
+                        copiedValues.push_back(pCopy);
+                        values[i] = (const char *)pCopy;
+                    }
+                }
+            }
+            ~XMLAttributes(void)
+            {
+                for (xmlChar *pCopy : copiedValues)
+                    xmlFree(pCopy);
+            }
 
-        int i = atoi((const char *)pS);
-        if (i < 0)
-        {
-            MeshParseError err("%s cannot be %s", (const char *)key, (const char *)pS);
-            xmlFree(pS);
-            throw err;
-        }
+            XMLAttributes(const XMLAttributes &) = delete;
+            void operator=(const XMLAttributes &) = delete;
 
-        length = i;
-        xmlFree(pS);
-    }
+            bool Has(const size_t slot) const
+            {
+                return values[slot] != NULL;
+            }
+
+            std::string_view GetString(const size_t slot) const
+            {
+                return Get(slot);
+            }
+
+            bool GetBool(const size_t slot) const
+            {
+                bool b;
+                ParseBool(Get(slot), b);
+                return b;
+            }
+
+            float GetFloat(const size_t slot) const
+            {
+                float f;
+                const char *s = Get(slot);
+                if (!ParseFloat(s, f))
+                    throw MeshParseError("Malformed floating point: %s", s);
+
+                return f;
+            }
+
+            size_t GetLength(const size_t slot) const
+            {
+                const char *s = Get(slot);
+                int i = atoi(s);
+                if (i < 0)
+                    throw MeshParseError("%s cannot be %s", table[slot].name, s);
+
+                return i;
+            }
+    };
+
+    const XMLAttributeName idAttributes[] = {XMLATTRIBUTE("id")};
+    enum {ATTRIB_ID};
+
+    const XMLAttributeName positionAttributes[] = {XMLATTRIBUTE("x"), XMLATTRIBUTE("y"), XMLATTRIBUTE("z")};
+    enum {ATTRIB_X, ATTRIB_Y, ATTRIB_Z};
+
+    const XMLAttributeName cornerAttributes[] = {XMLATTRIBUTE("vertex_id"), XMLATTRIBUTE("tex_u"), XMLATTRIBUTE("tex_v")};
+    enum {ATTRIB_VERTEX_ID, ATTRIB_TEX_U, ATTRIB_TEX_V};
+
+    const XMLAttributeName faceAttributes[] = {XMLATTRIBUTE("id"), XMLATTRIBUTE("smooth")};
+    enum {ATTRIB_FACE_ID, ATTRIB_SMOOTH};
+
+    const XMLAttributeName boneAttributes[] = {XMLATTRIBUTE("id"), XMLATTRIBUTE("x"), XMLATTRIBUTE("y"), XMLATTRIBUTE("z"),
+                                               XMLATTRIBUTE("weight"), XMLATTRIBUTE("parent_id")};
+    enum {ATTRIB_BONE_ID, ATTRIB_HEAD_X, ATTRIB_HEAD_Y, ATTRIB_HEAD_Z, ATTRIB_WEIGHT, ATTRIB_PARENT_ID};
+
+    const XMLAttributeName keyAttributes[] = {XMLATTRIBUTE("frame"), XMLATTRIBUTE("x"), XMLATTRIBUTE("y"), XMLATTRIBUTE("z"),
+                                              XMLATTRIBUTE("rot_x"), XMLATTRIBUTE("rot_y"), XMLATTRIBUTE("rot_z"), XMLATTRIBUTE("rot_w")};
+    enum {ATTRIB_FRAME, ATTRIB_KEY_X, ATTRIB_KEY_Y, ATTRIB_KEY_Z, ATTRIB_ROT_X, ATTRIB_ROT_Y, ATTRIB_ROT_Z, ATTRIB_ROT_W};
+
+    const XMLAttributeName layerAttributes[] = {XMLATTRIBUTE("bone_id")};
+    enum {ATTRIB_BONE_REF};
+
+    const XMLAttributeName animationAttributes[] = {XMLATTRIBUTE("id"), XMLATTRIBUTE("length")};
+    enum {ATTRIB_ANIMATION_ID, ATTRIB_LENGTH};
 
     void ParseVertex(const xmlNodePtr pVertexTag, MeshDataBuilder &builder)
     {
-        std::string id;
-        ParseStringAttrib(pVertexTag, (const xmlChar *)"id", id);
+        XMLAttributes attributes(pVertexTag, idAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_ID);
 
-        xmlNodePtr pPositionTag = FindChild(pVertexTag, "pos");
+        XMLAttributes positionAttribs(FindChild(pVertexTag, "pos"), positionAttributes);
 
         vec3 position;
-        ParseFloatAttrib(pPositionTag, (const xmlChar *)"x", position.x);
-        ParseFloatAttrib(pPositionTag, (const xmlChar *)"y", position.y);
-        ParseFloatAttrib(pPositionTag, (const xmlChar *)"z", position.z);
+        position.x = positionAttribs.GetFloat(ATTRIB_X);
+        position.y = positionAttribs.GetFloat(ATTRIB_Y);
+        position.z = positionAttribs.GetFloat(ATTRIB_Z);
 
         builder.AddVertex(id, position);
     }
 
-    void ParseCorner(const xmlNodePtr pCornerTag, MeshTexCoords &texCoords, std::string &vertexID)
+    void ParseCorner(const xmlNodePtr pCornerTag, MeshTexCoords &texCoords, std::string_view &vertexID)
     {
-        ParseStringAttrib(pCornerTag, (const xmlChar *)"vertex_id", vertexID);
+        XMLAttributes attributes(pCornerTag, cornerAttributes);
 
-        ParseFloatAttrib(pCornerTag, (const xmlChar *)"tex_u", texCoords.x);
-        ParseFloatAttrib(pCornerTag, (const xmlChar *)"tex_v", texCoords.y);
+        vertexID = attributes.GetString(ATTRIB_VERTEX_ID);
+
+        texCoords.x = attributes.GetFloat(ATTRIB_TEX_U);
+        texCoords.y = attributes.GetFloat(ATTRIB_TEX_V);
     }
 
     void ParseQuadFace(const xmlNodePtr pQuadTag, MeshDataBuilder &builder)
     {
-        std::string id;
-        ParseStringAttrib(pQuadTag, (const xmlChar *)"id", id);
-
-        bool smooth;
-        ParseBoolAttrib(pQuadTag, (const xmlChar *)"smooth", smooth);
+        XMLAttributes attributes(pQuadTag, faceAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_FACE_ID);
+        const bool smooth = attributes.GetBool(ATTRIB_SMOOTH);
 
         size_t count = 0;
         MeshTexCoords tx[4];
-        std::string vIDs[4];
+        std::string_view vertexIDs[4];
         for (xmlNodePtr pCornerTag : IterFindChildren(pQuadTag, "corner"))
         {
             if (count < 4)
             {
-                ParseCorner(pCornerTag, tx[count], vIDs[count]);
+                ParseCorner(pCornerTag, tx[count], vertexIDs[count]);
             }
             count++;
         }
@@ -369,25 +508,23 @@ namespace XMLMesh
         if (count != 4)
             throw MeshParseError("encountered a quad with %u corners", count);
 
-        builder.AddQuad(id, smooth, tx, vIDs);
+        builder.AddQuad(id, smooth, tx, vertexIDs);
     }
 
     void ParseTriangleFace(const xmlNodePtr pTriangleTag, MeshDataBuilder &builder)
     {
-        std::string id;
-        ParseStringAttrib(pTriangleTag, (const xmlChar *)"id", id);
-
-        bool smooth;
-        ParseBoolAttrib(pTriangleTag, (const xmlChar *)"smooth", smooth);
+        XMLAttributes attributes(pTriangleTag, faceAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_FACE_ID);
+        const bool smooth = attributes.GetBool(ATTRIB_SMOOTH);
 
         size_t count = 0;
         MeshTexCoords tx[3];
-        std::string vIDs[3];
+        std::string_view vertexIDs[3];
         for (xmlNodePtr pCornerTag : IterFindChildren(pTriangleTag, "corner"))
         {
             if (count < 3)
             {
-                ParseCorner(pCornerTag, tx[count], vIDs[count]);
+                ParseCorner(pCornerTag, tx[count], vertexIDs[count]);
             }
             count++;
         }
@@ -395,47 +532,42 @@ namespace XMLMesh
         if (count != 3)
             throw MeshParseError("encountered a triangle with %u corners", count);
 
-        builder.AddTriangle(id, smooth, tx, vIDs);
+        builder.AddTriangle(id, smooth, tx, vertexIDs);
     }
 
     void ParseSubset(const xmlNodePtr pSubsetTag, MeshDataBuilder &builder)
     {
-        const MeshFace *pFace;
-
-        std::string id;
-        ParseStringAttrib(pSubsetTag, (const xmlChar *)"id", id);
+        XMLAttributes attributes(pSubsetTag, idAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_ID);
 
         builder.AddSubset(id);
 
         xmlNodePtr pFacesTag = FindChild(pSubsetTag, "faces");
         for (xmlNodePtr pQuadTag : IterFindChildren(pFacesTag, "quad"))
         {
-            std::string quadID;
-            ParseStringAttrib(pQuadTag, (const xmlChar *)"id", quadID);
+            XMLAttributes quadAttributes(pQuadTag, idAttributes);
 
-            builder.AddQuadToSubset(id, quadID);
+            builder.AddQuadToSubset(id, quadAttributes.GetString(ATTRIB_ID));
         }
         for (xmlNodePtr pTriangleTag : IterFindChildren(pFacesTag, "triangle"))
         {
-            std::string triangleID;
-            ParseStringAttrib(pTriangleTag, (const xmlChar *)"id", triangleID);
+            XMLAttributes triangleAttributes(pTriangleTag, idAttributes);
 
-            builder.AddTriangleToSubset(id, triangleID);
+            builder.AddTriangleToSubset(id, triangleAttributes.GetString(ATTRIB_ID));
         }
     }
 
     void ParseBone(const xmlNodePtr pBoneTag, MeshDataBuilder &builder)
     {
-        std::string id;
-        ParseStringAttrib(pBoneTag, (const xmlChar *)"id", id);
+        XMLAttributes attributes(pBoneTag, boneAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_BONE_ID);
 
         vec3 headPosition;
-        ParseFloatAttrib(pBoneTag, (const xmlChar *)"x", headPosition.x);
-        ParseFloatAttrib(pBoneTag, (const xmlChar *)"y", headPosition.y);
-        ParseFloatAttrib(pBoneTag, (const xmlChar *)"z", headPosition.z);
+        headPosition.x = attributes.GetFloat(ATTRIB_HEAD_X);
+        headPosition.y = attributes.GetFloat(ATTRIB_HEAD_Y);
+        headPosition.z = attributes.GetFloat(ATTRIB_HEAD_Z);
 
-        float weight;
-        ParseFloatAttrib(pBoneTag, (const xmlChar *)"weight", weight);
+        const float weight = attributes.GetFloat(ATTRIB_WEIGHT);
 
         builder.AddBone(id, headPosition, weight);
 
@@ -444,52 +576,49 @@ namespace XMLMesh
             xmlNodePtr pVerticesTag = FindChild(pBoneTag, "vertices");
             for (xmlNodePtr pVertexTag : IterFindChildren(pVerticesTag, "vertex"))
             {
-                std::string vertexID;
-                ParseStringAttrib(pVertexTag, (const xmlChar *)"id", vertexID);
+                XMLAttributes vertexAttributes(pVertexTag, idAttributes);
 
-                builder.ConnectBoneToVertex(id, vertexID);
+                builder.ConnectBoneToVertex(id, vertexAttributes.GetString(ATTRIB_ID));
             }
         }
 
-        std::string parentID;
-        if (xmlHasProp(pBoneTag, (const xmlChar *)"parent_id"))
+        if (attributes.Has(ATTRIB_PARENT_ID))
         {
-            ParseStringAttrib(pBoneTag, (const xmlChar *)"parent_id", parentID);
-
-            builder.ConnectBones(parentID, id);
+            builder.ConnectBones(attributes.GetString(ATTRIB_PARENT_ID), id);
         }
     }
 
     void ParseKey(const xmlNodePtr pKeyTag,
-                  const std::string animationID, const std::string &boneID,
+                  const std::string_view animationID, const std::string_view boneID,
                   MeshDataBuilder &builder)
     {
-        size_t frame;
-        ParseLengthAttrib(pKeyTag, (const xmlChar *)"frame", frame);
+        XMLAttributes attributes(pKeyTag, keyAttributes);
+
+        const size_t frame = attributes.GetLength(ATTRIB_FRAME);
 
         MeshBoneTransformation transformation = MESHBONETRANSFORM_ID;
 
-        if (xmlHasProp(pKeyTag, (const xmlChar *)"x"))
+        if (attributes.Has(ATTRIB_KEY_X))
         {
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"x", transformation.translation.x);
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"y", transformation.translation.y);
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"z", transformation.translation.z);
+            transformation.translation.x = attributes.GetFloat(ATTRIB_KEY_X);
+            transformation.translation.y = attributes.GetFloat(ATTRIB_KEY_Y);
+            transformation.translation.z = attributes.GetFloat(ATTRIB_KEY_Z);
         }
-        if (xmlHasProp(pKeyTag, (const xmlChar *)"rot_x"))
+        if (attributes.Has(ATTRIB_ROT_X))
         {
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"rot_x", transformation.rotation.x);
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"rot_y", transformation.rotation.y);
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"rot_z", transformation.rotation.z);
-            ParseFloatAttrib(pKeyTag, (const xmlChar *)"rot_w", transformation.rotation.w);
+            transformation.rotation.x = attributes.GetFloat(ATTRIB_ROT_X);
+            transformation.rotation.y = attributes.GetFloat(ATTRIB_ROT_Y);
+            transformation.rotation.z = attributes.GetFloat(ATTRIB_ROT_Z);
+            transformation.rotation.w = attributes.GetFloat(ATTRIB_ROT_W);
         }
 
         builder.AddKey(animationID, boneID, frame, transformation);
     }
 
-    void ParseLayer(const xmlNodePtr pLayerTag, const std::string &animationID, MeshDataBuilder &builder)
+    void ParseLayer(const xmlNodePtr pLayerTag, const std::string_view animationID, MeshDataBuilder &builder)
     {
-        std::string boneID;
-        ParseStringAttrib(pLayerTag, (const xmlChar *)"bone_id", boneID);
+        XMLAttributes attributes(pLayerTag, layerAttributes);
+        const std::string_view boneID = attributes.GetString(ATTRIB_BONE_REF);
 
         builder.AddLayer(animationID, boneID);
 
@@ -501,16 +630,16 @@ namespace XMLMesh
         }
 
         if (countKeys <= 0)
-            throw MeshParseError("Layer %s in animation %s has no keys", boneID.c_str(), animationID.c_str());
+            throw MeshParseError("Layer %.*s in animation %.*s has no keys",
+                                 ID_FORMAT_ARGS(boneID), ID_FORMAT_ARGS(animationID));
     }
 
     void ParseAnimation(const xmlNodePtr pAnimationTag, MeshDataBuilder &builder)
     {
-        std::string id;
-        ParseStringAttrib(pAnimationTag, (const xmlChar *)"id", id);
+        XMLAttributes attributes(pAnimationTag, animationAttributes);
+        const std::string_view id = attributes.GetString(ATTRIB_ANIMATION_ID);
 
-        size_t length;
-        ParseLengthAttrib(pAnimationTag, (const xmlChar *)"length", length);
+        const size_t length = attributes.GetLength(ATTRIB_LENGTH);
 
         builder.AddAnimation(id, length);
 
@@ -520,14 +649,115 @@ namespace XMLMesh
         }
     }
 
-    MeshData *ParseMeshData(std::istream &is)
+    void ParseMeshAnimation(const std::string &contents, const std::string_view animationID, MeshDataBuilder &builder)
     {
-        const xmlDocPtr pDoc = ParseXML(is);
+        // Entity references and non-ascii bytes were left to the whole document's parse, when the contents were located.
+        xmlDocPtr pDoc = ParseXML("<animation>" + contents + "</animation>", NULL);
+        try
+        {
+            for (xmlNodePtr pLayerTag : IterFindChildren(xmlDocGetRootElement(pDoc), "layer"))
+            {
+                ParseLayer(pLayerTag, animationID, builder);
+            }
+        }
+        catch (...)
+        {
+            xmlFreeDoc(pDoc);
+            throw;
+        }
 
-        MeshDataBuilder builder;
+        xmlFreeDoc(pDoc);
+    }
+
+    MeshData *ParseMeshData(std::istream &is, std::pmr::memory_resource *pResource,
+                            const bool useScanner, const size_t countThreads)
+    {
+        return ParseMeshData(is, pResource, useScanner, countThreads, NULL);
+    }
+
+    MeshData *ParseMeshData(std::istream &is, std::pmr::memory_resource *pResource,
+                            const bool useScanner, const size_t countThreads, MeshLoadState *pLoad)
+    {
+        MeshTraceZone zone("ParseMeshData");
+
+        std::string text;
+        {
+            MeshTraceZone readZone("read xml");
+            ReadText(is, text, pLoad);
+        }
+
+        return ParseMeshText(text, pResource, useScanner, countThreads, pLoad);
+    }
+
+    MeshData *ParseMeshText(const std::string &text, std::pmr::memory_resource *pResource,
+                            const bool useScanner, const size_t countThreads, MeshLoadState *pLoad,
+                            const std::string &lazyAnimationsPath)
+    {
+        if (useScanner)
+        {
+            MeshTraceZone scanZone("scan xml");
+
+            MeshDataBuilder builder(pResource);
+            if (!lazyAnimationsPath.empty())
+                builder.LoadAnimationsLazily(text.data(), text.size(), lazyAnimationsPath);
+
+            bool scanned;
+            try
+            {
+                scanned = ScanMeshData(text.data(), text.size(), builder, countThreads, pLoad,
+                                       !lazyAnimationsPath.empty());
+            }
+            catch (const MeshLoadCancelled &)
+            {
+                DestroyMeshData(builder.GetMeshData());
+                throw;
+            }
+            catch (const MeshError &)
+            {
+                // libxml2 will tell whether it's the mesh or the xml that's wrong.
+                scanned = false;
+            }
+            catch (...)
+            {
+                DestroyMeshData(builder.GetMeshData());
+                throw;
+            }
+
+            if (scanned && pLoad != NULL)
+            {
+                try
+                {
+                    pLoad->Finish();
+                }
+                catch (...)
+                {
+                    DestroyMeshData(builder.GetMeshData());
+                    throw;
+                }
+            }
+
+            if (scanned)
+                return builder.GetMeshData();
+
+            DestroyMeshData(builder.GetMeshData());
+        }
+
+        xmlDocPtr pDoc;
+        {
+            MeshTraceZone xmlZone("parse xml");
+            if (pLoad != NULL)
+                pLoad->StartPhase(MESHLOAD_PARSING_XML, text.size());
+
+            pDoc = ParseXML(text, pLoad);
+        }
+
+        MeshDataBuilder builder(pResource);
 
         try
         {
+            if (pLoad != NULL)
+                pLoad->StartPhase(MESHLOAD_BUILDING, text.size());
+
             xmlNodePtr pRoot = xmlDocGetRootElement(pDoc);
             if(pRoot == nullptr)
                 throw MeshParseError("no root element found in xml tree");
@@ -536,42 +766,68 @@ namespace XMLMesh
                 throw MeshParseError("root element is not \"mesh\"");
 
             // First, parse all the vertices.
-            xmlNodePtr pVerticesTag = FindChild(pRoot, "vertices");
-            for (xmlNodePtr pVertexTag : IterFindChildren(pVerticesTag, "vertex"))
             {
-                ParseVertex(pVertexTag, builder);
+                MeshTraceZone phaseZone("build vertices");
+
+                xmlNodePtr pVerticesTag = FindChild(pRoot, "vertices");
+                for (xmlNodePtr pVertexTag : IterFindChildren(pVerticesTag, "vertex"))
+                {
+                    ParseVertex(pVertexTag, builder);
+                }
             }
 
             // Next, the faces that connect the vertices.
-            xmlNodePtr pFacesTag = FindChild(pRoot, "faces");
-            for (xmlNodePtr pQuadTag : IterFindChildren(pFacesTag, "quad"))
-            {
-                ParseQuadFace(pQuadTag, builder);
-            }
-            for (xmlNodePtr pTriangleTag : IterFindChildren(pFacesTag, "triangle"))
             {
-                ParseTriangleFace(pTriangleTag, builder);
+                MeshTraceZone phaseZone("build faces");
+                if (pLoad != NULL)
+                    pLoad->CheckCancelled();
+
+                xmlNodePtr pFacesTag = FindChild(pRoot, "faces");
+                for (xmlNodePtr pQuadTag : IterFindChildren(pFacesTag, "quad"))
+                {
+                    ParseQuadFace(pQuadTag, builder);
+                }
+                for (xmlNodePtr pTriangleTag : IterFindChildren(pFacesTag, "triangle"))
+                {
+                    ParseTriangleFace(pTriangleTag, builder);
+                }
             }
 
             // Then, the subsets that contain faces.
-            xmlNodePtr pSubsetsTag = FindChild(pRoot, "subsets");
-            for (xmlNodePtr pSubsetTag : IterFindChildren(pSubsetsTag, "subset"))
             {
-                ParseSubset(pSubsetTag, builder);
+                MeshTraceZone phaseZone("build subsets");
+                if (pLoad != NULL)
+                    pLoad->CheckCancelled();
+
+                xmlNodePtr pSubsetsTag = FindChild(pRoot, "subsets");
+                for (xmlNodePtr pSubsetTag : IterFindChildren(pSubsetsTag, "subset"))
+                {
+                    ParseSubset(pSubsetTag, builder);
+                }
             }
 
             if (HasChild(pRoot, "armature"))
             {
                 // Then the bones, (optional) which are attached to vertices.
                 xmlNodePtr pArmatureTag = FindChild(pRoot, "armature");
-                xmlNodePtr pBonesTag = FindChild(pArmatureTag, "bones");
-                for (xmlNodePtr pBoneTag : IterFindChildren(pBonesTag, "bone"))
                 {
-                    ParseBone(pBoneTag, builder);
+                    MeshTraceZone phaseZone("build bones");
+                    if (pLoad != NULL)
+                        pLoad->CheckCancelled();
+
+                    xmlNodePtr pBonesTag = FindChild(pArmatureTag, "bones");
+                    for (xmlNodePtr pBoneTag : IterFindChildren(pBonesTag, "bone"))
+                    {
+                        ParseBone(pBoneTag, builder);
+                    }
                 }
 
                 if (HasChild(pArmatureTag, "animations"))
                 {
+                    MeshTraceZone phaseZone("build animations");
+                    if (pLoad != NULL)
+                        pLoad->CheckCancelled();
+
                     // Parse the animations, involving the bones. (optional)
                     xmlNodePtr pAnimationsTag = FindChild(pArmatureTag, "animations");
                     for (xmlNodePtr pAnimationTag : IterFindChildren(pAnimationsTag, "animation"))
@@ -580,11 +836,17 @@ namespace XMLMesh
                     }
                 }
             }
+
+            if (pLoad != NULL)
+                pLoad->Finish();
         }
         catch(...)
         {
             xmlFreeDoc(pDoc);
 
+            // Including the objects that were allocated before the error.
+            DestroyMeshData(builder.GetMeshData());
+
             std::rethrow_exception(std::current_exception());
         }
 
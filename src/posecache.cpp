@@ -0,0 +1,176 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "cache.h"
+
+
+namespace XMLMesh
+{
+    bool MeshPoseCacheKey::operator==(const MeshPoseCacheKey &other) const
+    {
+        return animationIndex == other.animationIndex && loop == other.loop && step == other.step;
+    }
+
+    size_t MeshPoseCacheKeyHash::operator()(const MeshPoseCacheKey &key) const
+    {
+        return std::hash<size_t>()(key.step) ^ (std::hash<size_t>()(key.animationIndex) << 1) ^ size_t(key.loop);
+    }
+
+    MeshPoseCache::MeshPoseCache(void): usedBytes(0), countHits(0), countMisses(0)
+    {
+    }
+    MeshPoseCache::~MeshPoseCache(void)
+    {
+    }
+
+    size_t MeshPoseCache::GetEntryBytes(void) const
+    {
+        // The list node, the hash table node and the pose itself.
+        return sizeof(MeshPoseCacheEntry) + 2 * sizeof(void *)
+             + sizeof(MeshPoseCacheKey) + sizeof(std::list<MeshPoseCacheEntry>::iterator) + 2 * sizeof(void *)
+             + pSkeleton->CountBones() * sizeof(MeshBoneTransformation);
+    }
+
+    void MeshPoseCache::GetPoseAt(const size_t animationIndex, const float frame, const bool loop,
+                                  MeshBoneTransformation *poseOut)
+    {
+        const size_t countBones = pSkeleton->CountBones();
+
+        MeshPoseCacheKey key;
+        key.animationIndex = animationIndex;
+        key.loop = loop;
+        key.step = size_t(std::round(frame * stepsPerFrame));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (HAS_ID(mEntries, key))
+            {
+                std::list<MeshPoseCacheEntry>::iterator it = mEntries.at(key);
+
+                // Mark as most recently used.
+                entries.splice(entries.begin(), entries, it);
+
+                std::copy(it->pose.begin(), it->pose.end(), poseOut);
+                countHits++;
+                return;
+            }
+        }
+
+        // Sample without holding the lock, other threads might need the cache meanwhile.
+        GetSkeletonPoseAt(pSkeleton, animationIndex, float(key.step) / stepsPerFrame, loop, poseOut);
+        countMisses++;
+
+        const size_t entryBytes = GetEntryBytes();
+        if (entryBytes > maxBytes)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (HAS_ID(mEntries, key))  // another thread was first
+            return;
+
+        while (usedBytes + entryBytes > maxBytes)
+        {
+            mEntries.erase(entries.back().key);
+            entries.pop_back();
+            usedBytes -= entryBytes;
+        }
+
+        entries.emplace_front();
+        entries.front().key = key;
+        entries.front().pose.assign(poseOut, poseOut + countBones);
+        mEntries.emplace(key, entries.begin());
+        usedBytes += entryBytes;
+    }
+
+    const MeshSkeleton *MeshPoseCache::GetSkeleton(void) const
+    {
+        return pSkeleton;
+    }
+
+    size_t MeshPoseCache::CountHits(void) const
+    {
+        return countHits;
+    }
+    size_t MeshPoseCache::CountMisses(void) const
+    {
+        return countMisses;
+    }
+    void MeshPoseCache::ResetCounters(void)
+    {
+        countHits = 0;
+        countMisses = 0;
+    }
+
+    size_t MeshPoseCache::CountPoses(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    size_t MeshPoseCache::GetUsedBytes(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return usedBytes;
+    }
+    size_t MeshPoseCache::GetMaxBytes(void) const
+    {
+        return maxBytes;
+    }
+    void MeshPoseCache::Clear(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        mEntries.clear();
+        entries.clear();
+        usedBytes = 0;
+    }
+
+    MeshPoseCache *CreateMeshPoseCache(const MeshSkeleton *pSkeleton, const float stepsPerFrame, const size_t maxBytes)
+    {
+        if (stepsPerFrame <= 0.0f)
+            throw MeshKeyError("stepsPerFrame must be positive, not %f", stepsPerFrame);
+
+        MeshPoseCache *pCache = new MeshPoseCache;
+        pCache->pSkeleton = pSkeleton;
+        pCache->stepsPerFrame = stepsPerFrame;
+        pCache->maxBytes = maxBytes;
+
+        return pCache;
+    }
+
+    void DestroyMeshPoseCache(MeshPoseCache *pCache)
+    {
+        delete pCache;
+    }
+
+    void GetBoneTransformationsAt(MeshPoseCache *pCache, const std::string_view animationID,
+                                  const milliseconds ms, const float framesPerSecond, const bool loop,
+                                  std::unordered_map<std::string, MeshBoneTransformation> &transformationsOut)
+    {
+        const MeshSkeleton *pSkeleton = pCache->GetSkeleton();
+        const size_t animationIndex = pSkeleton->GetAnimationIndex(animationID);
+
+        std::vector<MeshBoneTransformation> pose(pSkeleton->CountBones());
+        pCache->GetPoseAt(animationIndex, GetAnimationFrame(pSkeleton, animationIndex, ms, framesPerSecond, loop),
+                          loop, pose.data());
+
+        for (const MeshSkeletonLayer &layer : pSkeleton->GetAnimation(animationIndex)->layers)
+            transformationsOut[pSkeleton->GetBone(layer.boneIndex)->GetID()] = pose[layer.boneIndex];
+    }
+}
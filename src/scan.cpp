@@ -0,0 +1,993 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scan.h"
+#include "parallel.h"
+#include "tracing.h"
+
+
+#define MAX_SCAN_DEPTH 8
+#define MAX_SCAN_ATTRIBUTES 16
+
+// Sections are cut into chunks of at least this many bytes, for the threads to scan.
+#define MIN_SCAN_CHUNK_SIZE 0x10000
+
+namespace XMLMesh
+{
+    /**
+     *  Bytes that end a run of text or an attribute value: the given stop byte, '<', '&',
+     *  and bytes the scanner doesn't accept at all: control characters and anything outside
+     *  ascii, which libxml2 would need to check. Newlines, returns and tabs are only
+     *  accepted in text, because libxml2 replaces them by spaces in attribute values.
+     */
+    template <bool inText>
+    inline bool IsSpecialByte(const char c, const char stop)
+    {
+        return c == stop || c == '<' || c == '&'
+            || ((signed char)c < 0x20 && !(inText && (c == '\n' || c == '\r' || c == '\t')));
+    }
+
+    template <bool inText>
+    const char *FindSpecialByte(const char *p, const char *end, const char stop)
+    {
+#ifdef __SSE2__
+        const __m128i stops = _mm_set1_epi8(stop),
+                      lessThans = _mm_set1_epi8('<'),
+                      ampersands = _mm_set1_epi8('&'),
+                      spaces = _mm_set1_epi8(0x20),
+                      newlines = _mm_set1_epi8('\n'),
+                      returns = _mm_set1_epi8('\r'),
+                      tabs = _mm_set1_epi8('\t');
+
+        // 16 bytes at a time. The signed comparison with space also catches bytes from 0x80.
+        while (end - p >= 16)
+        {
+            const __m128i v = _mm_loadu_si128((const __m128i *)p);
+
+            const __m128i whitespace = inText ? _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newlines),
+                                                                          _mm_cmpeq_epi8(v, returns)),
+                                                             _mm_cmpeq_epi8(v, tabs))
+                                              : _mm_setzero_si128();
+            const __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, stops), _mm_cmpeq_epi8(v, lessThans)),
+                                                 _mm_or_si128(_mm_cmpeq_epi8(v, ampersands),
+                                                              _mm_andnot_si128(whitespace, _mm_cmplt_epi8(v, spaces))));
+
+            const int mask = _mm_movemask_epi8(special);
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+
+            p += 16;
+        }
+#endif
+        while (p < end && !IsSpecialByte<inText>(*p, stop))
+            p++;
+
+        return p;
+    }
+
+    inline bool IsXMLSpace(const char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    inline bool IsNameByte(const char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '_' || c == '-' || c == '.';
+    }
+
+    bool IEquals(const std::string_view s1, const char *s2)
+    {
+        size_t i;
+        for (i = 0; i < s1.size(); i++)
+            if (s2[i] == '\0' || toupper(s1[i]) != toupper(s2[i]))
+                return false;
+
+        return s2[i] == '\0';
+    }
+
+    // The tags of the format. Some names mean a different thing, depending on the parent tag.
+    enum MeshScanTag
+    {
+        SCANTAG_DOCUMENT,
+        SCANTAG_MESH,
+        SCANTAG_VERTICES,
+        SCANTAG_VERTEX,
+        SCANTAG_POS,
+        SCANTAG_NORM,
+        SCANTAG_FACES,
+        SCANTAG_QUAD,
+        SCANTAG_TRIANGLE,
+        SCANTAG_CORNER,
+        SCANTAG_SUBSETS,
+        SCANTAG_SUBSET,
+        SCANTAG_SUBSET_FACES,
+        SCANTAG_SUBSET_QUAD,
+        SCANTAG_SUBSET_TRIANGLE,
+        SCANTAG_ARMATURE,
+        SCANTAG_BONES,
+        SCANTAG_BONE,
+        SCANTAG_BONE_VERTICES,
+        SCANTAG_BONE_VERTEX,
+        SCANTAG_ANIMATIONS,
+        SCANTAG_ANIMATION,
+        SCANTAG_LAYER,
+        SCANTAG_KEY,
+
+        COUNT_SCANTAGS
+    };
+
+    struct MeshScanChild
+    {
+        MeshScanTag parent;
+        const char *name;
+        MeshScanTag tag;
+    };
+
+    const MeshScanChild scanChildren[] = {
+        {SCANTAG_DOCUMENT, "mesh", SCANTAG_MESH},
+        {SCANTAG_MESH, "vertices", SCANTAG_VERTICES},
+        {SCANTAG_MESH, "faces", SCANTAG_FACES},
+        {SCANTAG_MESH, "subsets", SCANTAG_SUBSETS},
+        {SCANTAG_MESH, "armature", SCANTAG_ARMATURE},
+        {SCANTAG_VERTICES, "vertex", SCANTAG_VERTEX},
+        {SCANTAG_VERTEX, "pos", SCANTAG_POS},
+        {SCANTAG_VERTEX, "norm", SCANTAG_NORM},
+        {SCANTAG_FACES, "quad", SCANTAG_QUAD},
+        {SCANTAG_FACES, "triangle", SCANTAG_TRIANGLE},
+        {SCANTAG_QUAD, "corner", SCANTAG_CORNER},
+        {SCANTAG_TRIANGLE, "corner", SCANTAG_CORNER},
+        {SCANTAG_SUBSETS, "subset", SCANTAG_SUBSET},
+        {SCANTAG_SUBSET, "faces", SCANTAG_SUBSET_FACES},
+        {SCANTAG_SUBSET_FACES, "quad", SCANTAG_SUBSET_QUAD},
+        {SCANTAG_SUBSET_FACES, "triangle", SCANTAG_SUBSET_TRIANGLE},
+        {SCANTAG_ARMATURE, "bones", SCANTAG_BONES},
+        {SCANTAG_ARMATURE, "animations", SCANTAG_ANIMATIONS},
+        {SCANTAG_BONES, "bone", SCANTAG_BONE},
+        {SCANTAG_BONE, "vertices", SCANTAG_BONE_VERTICES},
+        {SCANTAG_BONE_VERTICES, "vertex", SCANTAG_BONE_VERTEX},
+        {SCANTAG_ANIMATIONS, "animation", SCANTAG_ANIMATION},
+        {SCANTAG_ANIMATION, "layer", SCANTAG_LAYER},
+        {SCANTAG_LAYER, "key", SCANTAG_KEY}
+    };
+
+    // Tags whose children are cut into chunks, by ScanMeshData with more than one thread.
+    inline bool IsScanSection(const MeshScanTag tag)
+    {
+        return tag == SCANTAG_VERTICES || tag == SCANTAG_FACES || tag == SCANTAG_SUBSETS
+            || tag == SCANTAG_BONES || tag == SCANTAG_ANIMATIONS;
+    }
+
+    /**
+     *  The contents of a section, between its start and end tag,
+     *  and the open elements around it.
+     */
+    struct MeshScanSection
+    {
+        const char *begin, *end;
+
+        MeshScanTag stack[MAX_SCAN_DEPTH];
+        std::string_view stackNames[MAX_SCAN_DEPTH];
+        size_t depth;
+    };
+
+    struct MeshScanChunk
+    {
+        size_t sectionIndex;
+        const char *begin, *end;
+    };
+
+    /**
+     *  Everything here returns false on input that the libxml2 path should handle instead.
+     */
+    template <class Builder>
+    class MeshScanner
+    {
+        private:
+            const char *p, *end;
+            Builder &builder;
+
+            // When set, the contents of sections are skipped and only located.
+            std::vector<MeshScanSection> *pSections;
+
+            // When set, the contents of animations are too, for loading them on first use.
+            bool lazyAnimations;
+
+            MeshLoadState *pLoad;
+            const char *begin, *nextReport;
+
+            MeshScanTag stack[MAX_SCAN_DEPTH];
+            std::string_view stackNames[MAX_SCAN_DEPTH];
+            size_t depth;
+
+            // Each tag may only occur once in its parent.
+            bool seen[COUNT_SCANTAGS];
+
+            std::string_view attributeNames[MAX_SCAN_ATTRIBUTES],
+                             attributeValues[MAX_SCAN_ATTRIBUTES];
+            size_t countAttributes;
+
+            // What's been read of the elements that are still open.
+            std::string_view vertexID;
+            vec3 position;
+            std::string_view faceID;
+            bool smooth;
+            size_t countCorners;
+            MeshTexCoords texCoords[4];
+            std::string_view cornerVertexIDs[4];
+            std::string_view subsetID;
+            std::string_view boneID, parentID;
+            bool hasParent;
+            std::string_view animationID;
+            size_t animationLength;
+            std::string_view layerBoneID;
+            size_t countKeys;
+
+            bool GetAttribute(const char *name, std::string_view &value) const
+            {
+                size_t i;
+                for (i = 0; i < countAttributes; i++)
+                {
+                    if (attributeNames[i] == name)
+                    {
+                        value = attributeValues[i];
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool GetFloatAttribute(const char *name, float &f) const
+            {
+                std::string_view value;
+                if (!GetAttribute(name, value))
+                    return false;
+
+                // The value is followed by its closing quote, where ParseFloat stops.
+                return ParseFloat(value.data(), f) == value.data() + value.size();
+            }
+
+            bool GetBoolAttribute(const char *name, bool &b) const
+            {
+                std::string_view value;
+                if (!GetAttribute(name, value))
+                    return false;
+
+                if (value == "0")
+                    b = false;
+                else if (IEquals(value, "true"))
+                    b = true;
+                else if (IEquals(value, "false"))
+                    b = false;
+                else
+                    b = true;
+                return true;
+            }
+
+            bool GetLengthAttribute(const char *name, size_t &length) const
+            {
+                std::string_view value;
+                if (!GetAttribute(name, value))
+                    return false;
+
+                const int i = atoi(value.data());
+                if (i < 0)
+                    return false;
+
+                length = i;
+                return true;
+            }
+
+            bool SkipSpace(void)
+            {
+                while (p < end && IsXMLSpace(*p))
+                    p++;
+                return p < end;
+            }
+
+            bool ReadName(std::string_view &name)
+            {
+                const char *start = p;
+                while (p < end && IsNameByte(*p))
+                    p++;
+
+                if (p == start || p >= end || !(isalpha(*start) || *start == '_'))
+                    return false;
+
+                name = std::string_view(start, p - start);
+                return true;
+            }
+
+            /**
+             *  Reads the attributes and the end of a start tag.
+             */
+            bool ReadAttributes(bool &empty)
+            {
+                countAttributes = 0;
+                while (true)
+                {
+                    const bool spaced = p < end && IsXMLSpace(*p);
+                    if (!SkipSpace())
+                        return false;
+
+                    if (*p == '>')
+                    {
+                        p++;
+                        empty = false;
+                        return true;
+                    }
+                    else if (*p == '/')
+                    {
+                        p++;
+                        if (p >= end || *p != '>')
+                            return false;
+                        p++;
+                        empty = true;
+                        return true;
+                    }
+                    else if (!spaced || countAttributes >= MAX_SCAN_ATTRIBUTES)
+                        return false;
+
+                    std::string_view name;
+                    if (!ReadName(name))
+                        return false;
+
+                    size_t i;
+                    for (i = 0; i < countAttributes; i++)
+                        if (attributeNames[i] == name)
+                            return false;
+
+                    if (!SkipSpace() || *p != '=')
+                        return false;
+                    p++;
+                    if (!SkipSpace() || *p != '"')
+                        return false;
+                    p++;
+
+                    const char *start = p;
+                    p = FindSpecialByte<false>(p, end, '"');
+                    if (p >= end || *p != '"')
+                        return false;
+
+                    attributeNames[countAttributes] = name;
+                    attributeValues[countAttributes] = std::string_view(start, p - start);
+                    countAttributes++;
+                    p++;
+                }
+            }
+
+            /**
+             *  Only an xml declaration for utf-8 or ascii, which is what the exporter writes if anything.
+             */
+            bool ReadDeclaration(void)
+            {
+                if (end - p < 5 || std::string_view(p, 5) != "<?xml" || !IsXMLSpace(p[5]))
+                    return true;
+                p += 5;
+
+                countAttributes = 0;
+                while (SkipSpace() && *p != '?')
+                {
+                    if (countAttributes >= MAX_SCAN_ATTRIBUTES || !ReadName(attributeNames[countAttributes])
+                            || !SkipSpace() || *p != '=')
+                        return false;
+                    p++;
+                    if (!SkipSpace() || *p != '"')
+                        return false;
+                    p++;
+
+                    const char *start = p;
+                    p = FindSpecialByte<false>(p, end, '"');
+                    if (p >= end || *p != '"')
+                        return false;
+
+                    attributeValues[countAttributes++] = std::string_view(start, p - start);
+                    p++;
+                }
+                if (end - p < 2 || p[0] != '?' || p[1] != '>')
+                    return false;
+                p += 2;
+
+                // In this order, like libxml2 requires.
+                const char *names[] = {"version", "encoding", "standalone"};
+                size_t i, j = 0;
+                for (i = 0; i < countAttributes; i++)
+                {
+                    while (j < 3 && attributeNames[i] != names[j])
+                        j++;
+                    if (j >= 3)
+                        return false;
+                }
+
+                std::string_view value;
+                if (countAttributes < 1 || attributeNames[0] != "version" || attributeValues[0] != "1.0")
+                    return false;
+
+                if (GetAttribute("encoding", value) && !IEquals(value, "utf-8") && !IEquals(value, "us-ascii"))
+                    return false;
+
+                if (GetAttribute("standalone", value) && value != "yes" && value != "no")
+                    return false;
+
+                return true;
+            }
+
+            // The format has no text, only whitespace between the tags.
+            bool SkipText(void)
+            {
+                const char *start = p;
+                p = FindSpecialByte<true>(p, end, '<');
+                if (p < end && *p != '<')
+                    return false;
+
+                for (const char *q = start; q < p; q++)
+                    if (!IsXMLSpace(*q))
+                        return false;
+
+                return true;
+            }
+
+            bool StartElement(const MeshScanTag tag)
+            {
+                switch (tag)
+                {
+                case SCANTAG_VERTEX:
+                    seen[SCANTAG_POS] = false;
+                    return GetAttribute("id", vertexID);
+                case SCANTAG_POS:
+                    return GetFloatAttribute("x", position.x)
+                        && GetFloatAttribute("y", position.y)
+                        && GetFloatAttribute("z", position.z);
+                case SCANTAG_QUAD:
+                case SCANTAG_TRIANGLE:
+                    countCorners = 0;
+                    return GetAttribute("id", faceID) && GetBoolAttribute("smooth", smooth);
+                case SCANTAG_CORNER:
+                    if (countCorners >= (stack[depth - 2] == SCANTAG_QUAD ? 4 : 3))
+                        return false;
+
+                    if (!GetAttribute("vertex_id", cornerVertexIDs[countCorners])
+                            || !GetFloatAttribute("tex_u", texCoords[countCorners].x)
+                            || !GetFloatAttribute("tex_v", texCoords[countCorners].y))
+                        return false;
+
+                    countCorners++;
+                    return true;
+                case SCANTAG_SUBSET:
+                    seen[SCANTAG_SUBSET_FACES] = false;
+                    if (!GetAttribute("id", subsetID))
+                        return false;
+
+                    builder.AddSubset(subsetID);
+                    return true;
+                case SCANTAG_SUBSET_QUAD:
+                {
+                    std::string_view id;
+                    if (!GetAttribute("id", id))
+                        return false;
+
+                    builder.AddQuadToSubset(subsetID, id);
+                    return true;
+                }
+                case SCANTAG_SUBSET_TRIANGLE:
+                {
+                    std::string_view id;
+                    if (!GetAttribute("id", id))
+                        return false;
+
+                    builder.AddTriangleToSubset(subsetID, id);
+                    return true;
+                }
+                case SCANTAG_BONE:
+                {
+                    vec3 headPosition;
+                    float weight;
+                    if (!GetAttribute("id", boneID)
+                            || !GetFloatAttribute("x", headPosition.x)
+                            || !GetFloatAttribute("y", headPosition.y)
+                            || !GetFloatAttribute("z", headPosition.z)
+                            || !GetFloatAttribute("weight", weight))
+                        return false;
+
+                    hasParent = GetAttribute("parent_id", parentID);
+
+                    seen[SCANTAG_BONE_VERTICES] = false;
+                    builder.AddBone(boneID, headPosition, weight);
+                    return true;
+                }
+                case SCANTAG_BONE_VERTEX:
+                {
+                    std::string_view id;
+                    if (!GetAttribute("id", id))
+                        return false;
+
+                    builder.ConnectBoneToVertex(boneID, id);
+                    return true;
+                }
+                case SCANTAG_ANIMATION:
+                    if (!GetAttribute("id", animationID) || !GetLengthAttribute("length", animationLength))
+                        return false;
+
+                    if (!lazyAnimations)
+                        builder.AddAnimation(animationID, animationLength);
+                    return true;
+                case SCANTAG_LAYER:
+                    countKeys = 0;
+                    if (!GetAttribute("bone_id", layerBoneID))
+                        return false;
+
+                    builder.AddLayer(animationID, layerBoneID);
+                    return true;
+                case SCANTAG_KEY:
+                {
+                    size_t frame;
+                    if (!GetLengthAttribute("frame", frame))
+                        return false;
+
+                    MeshBoneTransformation transformation = MESHBONETRANSFORM_ID;
+                    std::string_view value;
+                    if (GetAttribute("x", value)
+                            && (!GetFloatAttribute("x", transformation.translation.x)
+                                || !GetFloatAttribute("y", transformation.translation.y)
+                                || !GetFloatAttribute("z", transformation.translation.z)))
+                        return false;
+
+                    if (GetAttribute("rot_x", value)
+                            && (!GetFloatAttribute("rot_x", transformation.rotation.x)
+                                || !GetFloatAttribute("rot_y", transformation.rotation.y)
+                                || !GetFloatAttribute("rot_z", transformation.rotation.z)
+                                || !GetFloatAttribute("rot_w", transformation.rotation.w)))
+                        return false;
+
+                    countKeys++;
+                    builder.AddKey(animationID, layerBoneID, frame, transformation);
+                    return true;
+                }
+                default:
+                    return true;
+                }
+            }
+
+            bool EndElement(const MeshScanTag tag)
+            {
+                switch (tag)
+                {
+                case SCANTAG_VERTEX:
+                    if (!seen[SCANTAG_POS])
+                        return false;
+
+                    builder.AddVertex(vertexID, position);
+                    return true;
+                case SCANTAG_QUAD:
+                    if (countCorners != 4)
+                        return false;
+
+                    builder.AddQuad(faceID, smooth, texCoords, cornerVertexIDs);
+                    return true;
+                case SCANTAG_TRIANGLE:
+                    if (countCorners != 3)
+                        return false;
+
+                    builder.AddTriangle(faceID, smooth, texCoords, cornerVertexIDs);
+                    return true;
+                case SCANTAG_SUBSET:
+                    return seen[SCANTAG_SUBSET_FACES];
+                case SCANTAG_BONE:
+                    if (hasParent)
+                        builder.ConnectBones(parentID, boneID);
+                    return true;
+                case SCANTAG_LAYER:
+                    return countKeys > 0;
+                case SCANTAG_ARMATURE:
+                    return seen[SCANTAG_BONES];
+                case SCANTAG_MESH:
+                    return seen[SCANTAG_VERTICES] && seen[SCANTAG_FACES] && seen[SCANTAG_SUBSETS];
+                default:
+                    return true;
+                }
+            }
+
+            bool ReadStartTag(void)
+            {
+                std::string_view name;
+                if (!ReadName(name) || depth >= MAX_SCAN_DEPTH)
+                    return false;
+
+                const MeshScanTag parent = stack[depth - 1];
+                MeshScanTag tag = COUNT_SCANTAGS;
+                for (const MeshScanChild &child : scanChildren)
+                {
+                    if (child.parent == parent && name == child.name)
+                    {
+                        tag = child.tag;
+                        break;
+                    }
+                }
+                if (tag == COUNT_SCANTAGS)
+                    return false;
+
+                // Tags with only one occurrence in their parent.
+                if (tag != SCANTAG_VERTEX && tag != SCANTAG_NORM && tag != SCANTAG_QUAD && tag != SCANTAG_TRIANGLE
+                        && tag != SCANTAG_CORNER && tag != SCANTAG_SUBSET && tag != SCANTAG_SUBSET_QUAD
+                        && tag != SCANTAG_SUBSET_TRIANGLE && tag != SCANTAG_BONE && tag != SCANTAG_BONE_VERTEX
+                        && tag != SCANTAG_ANIMATION && tag != SCANTAG_LAYER && tag != SCANTAG_KEY)
+                {
+                    if (seen[tag])
+                        return false;
+                    seen[tag] = true;
+                }
+
+                bool empty;
+                if (!ReadAttributes(empty))
+                    return false;
+
+                stack[depth] = tag;
+                stackNames[depth] = name;
+                depth++;
+
+                if (!StartElement(tag))
+                    return false;
+
+                if (lazyAnimations && tag == SCANTAG_ANIMATION)
+                {
+                    if (!empty)
+                        return SkipAnimation();
+
+                    builder.AddLazyAnimation(animationID, animationLength, std::string_view());
+                }
+
+                if (empty)
+                {
+                    depth--;
+                    return EndElement(tag);
+                }
+
+                if (pSections != NULL && IsScanSection(tag))
+                    return SkipSection();
+
+                return true;
+            }
+
+            // Finds the end tag of the innermost open element, NULL if it's not closed.
+            const char *FindEndTag(void) const
+            {
+                const std::string_view name = stackNames[depth - 1];
+                const char *q = p;
+                while ((q = (const char *)memchr(q, '<', end - q)) != NULL)
+                {
+                    if (end - q >= 3 + (ptrdiff_t)name.size() && q[1] == '/'
+                            && std::string_view(q + 2, name.size()) == name
+                            && (IsXMLSpace(q[2 + name.size()]) || q[2 + name.size()] == '>'))
+                        return q;
+                    q++;
+                }
+
+                return NULL;
+            }
+
+            /**
+             *  Continues at the section's end tag. The contents aren't checked here, but by
+             *  the scanners of its chunks. They can't contain the end tag, if they're valid.
+             */
+            bool SkipSection(void)
+            {
+                const char *q = FindEndTag();
+                if (q == NULL)
+                    return false;
+
+                pSections->emplace_back();
+
+                MeshScanSection &section = pSections->back();
+                section.begin = p;
+                section.end = q;
+                std::copy(stack, stack + depth, section.stack);
+                std::copy(stackNames, stackNames + depth, section.stackNames);
+                section.depth = depth;
+
+                p = q;
+                return true;
+            }
+
+            /**
+             *  Continues at the animation's end tag. Its contents are only checked for what
+             *  only libxml2 handles, so that the whole document goes there instead.
+             *  The rest is checked when the animation is loaded.
+             */
+            bool SkipAnimation(void)
+            {
+                const char *q = FindEndTag();
+                if (q == NULL)
+                    return false;
+
+                const char *c;
+                for (c = p; c < q; c++)
+                {
+                    if (*c == '&' || (unsigned char)*c >= 0x80 || (*c == '<' && (c[1] == '!' || c[1] == '?')))
+                        return false;
+                }
+
+                builder.AddLazyAnimation(animationID, animationLength, std::string_view(p, q - p));
+
+                p = q;
+                return true;
+            }
+
+            bool ReadEndTag(void)
+            {
+                std::string_view name;
+                if (depth <= 1 || !ReadName(name) || name != stackNames[depth - 1])
+                    return false;
+
+                SkipSpace();
+                if (p >= end || *p != '>')
+                    return false;
+                p++;
+
+                depth--;
+                return EndElement(stack[depth]);
+            }
+
+            // Leaf tags don't have children in the format.
+            bool IsLeaf(const MeshScanTag tag) const
+            {
+                return tag == SCANTAG_POS || tag == SCANTAG_NORM || tag == SCANTAG_CORNER
+                    || tag == SCANTAG_SUBSET_QUAD || tag == SCANTAG_SUBSET_TRIANGLE
+                    || tag == SCANTAG_BONE_VERTEX || tag == SCANTAG_KEY;
+            }
+        public:
+            MeshScanner(const char *text, const size_t length, Builder &b,
+                        std::vector<MeshScanSection> *pS = NULL, MeshLoadState *pL = NULL, const bool lazy = false)
+            : p(text), end(text + length), builder(b), pSections(pS), lazyAnimations(lazy),
+              pLoad(pL), begin(text), nextReport(text + MESHLOAD_REPORT_INTERVAL), depth(1), countAttributes(0)
+            {
+                stack[0] = SCANTAG_DOCUMENT;
+
+                size_t i;
+                for (i = 0; i < COUNT_SCANTAGS; i++)
+                    seen[i] = false;
+            }
+
+            MeshScanner(const MeshScanSection &section, const MeshScanChunk &chunk, Builder &b, const bool lazy = false)
+            : p(chunk.begin), end(chunk.end), builder(b), pSections(NULL), lazyAnimations(lazy),
+              pLoad(NULL), begin(chunk.begin), nextReport(chunk.end), depth(section.depth), countAttributes(0)
+            {
+                std::copy(section.stack, section.stack + depth, stack);
+                std::copy(section.stackNames, section.stackNames + depth, stackNames);
+
+                size_t i;
+                for (i = 0; i < COUNT_SCANTAGS; i++)
+                    seen[i] = false;
+            }
+
+            bool Scan(void)
+            {
+                if (!ReadDeclaration())
+                    return false;
+
+                while (true)
+                {
+                    if (!SkipText())
+                        return false;
+
+                    if (p >= end)
+                        break;
+
+                    p++;  // past '<'
+                    if (p >= end)
+                        return false;
+
+                    if (*p == '/')
+                    {
+                        p++;
+                        if (!ReadEndTag())
+                            return false;
+                    }
+                    else if (IsLeaf(stack[depth - 1]) || !ReadStartTag())
+                        return false;
+
+                    if (pLoad != NULL && p >= nextReport)
+                    {
+                        pLoad->SetBytesDone(p - begin);
+                        nextReport = p + MESHLOAD_REPORT_INTERVAL;
+                    }
+
+                    if (depth == 1 && seen[SCANTAG_MESH])
+                    {
+                        // After the root, only whitespace may follow.
+                        if (!SkipText() || p < end)
+                            return false;
+                        return true;
+                    }
+                }
+
+                return false;  // no root, or it wasn't closed
+            }
+
+            /**
+             *  Scans a chunk of a section's contents. It must close all elements that it opens.
+             */
+            bool ScanChunk(void)
+            {
+                const size_t sectionDepth = depth;
+                while (true)
+                {
+                    if (!SkipText())
+                        return false;
+
+                    if (p >= end)
+                        return depth == sectionDepth;
+
+                    p++;  // past '<'
+                    if (p >= end)
+                        return false;
+
+                    if (*p == '/')
+                    {
+                        p++;
+                        if (depth <= sectionDepth || !ReadEndTag())
+                            return false;
+                    }
+                    else if (IsLeaf(stack[depth - 1]) || !ReadStartTag())
+                        return false;
+                }
+            }
+
+            // Scans the contents of an animation, which the section must end with.
+            bool ScanAnimation(const std::string_view id)
+            {
+                animationID = id;
+                return ScanChunk();
+            }
+    };
+
+    /**
+     *  Finds the first start tag of one of the section's children, from 'p' on.
+     *  In a document that the scanner accepts, every '<' starts a tag.
+     */
+    const char *FindChildStartTag(const char *p, const char *end, const MeshScanTag section)
+    {
+        while ((p = (const char *)memchr(p, '<', end - p)) != NULL)
+        {
+            const char *q = p + 1;
+            while (q < end && IsNameByte(*q))
+                q++;
+
+            if (q < end && (IsXMLSpace(*q) || *q == '/' || *q == '>'))
+            {
+                const std::string_view name(p + 1, q - (p + 1));
+                for (const MeshScanChild &child : scanChildren)
+                    if (child.parent == section && name == child.name)
+                        return p;
+            }
+            p = q;
+        }
+        return end;
+    }
+
+    void SplitSection(const std::vector<MeshScanSection> &sections, const size_t sectionIndex,
+                      std::vector<MeshScanChunk> &chunks)
+    {
+        const MeshScanSection &section = sections[sectionIndex];
+
+        const char *begin = section.begin;
+        while (begin < section.end)
+        {
+            const char *cut = section.end;
+            if (section.end - begin >= 2 * MIN_SCAN_CHUNK_SIZE)
+                cut = FindChildStartTag(begin + MIN_SCAN_CHUNK_SIZE, section.end, section.stack[section.depth - 1]);
+
+            chunks.push_back({sectionIndex, begin, cut});
+            begin = cut;
+        }
+    }
+
+    bool ScanMeshData(const char *text, const size_t length, MeshDataBuilder &builder, const size_t countThreads,
+                      MeshLoadState *pLoad, const bool lazyAnimations)
+    {
+        if (pLoad != NULL)
+            pLoad->StartPhase(MESHLOAD_SCANNING, length);
+
+        if (CountWorkerThreads(countThreads) <= 1 || length < 2 * MIN_SCAN_CHUNK_SIZE)
+        {
+            MeshDataRecords records;
+            MeshScanner<MeshDataRecords> scanner(text, length, records, NULL, pLoad, lazyAnimations);
+            if (!scanner.Scan())
+                return false;
+
+            MeshTraceZone zone("build records");
+            if (pLoad != NULL)
+                pLoad->StartPhase(MESHLOAD_BUILDING, length);
+
+            builder.AddRecords(&records, 1);
+            return true;
+        }
+
+        // The parts outside the sections don't make any builder calls.
+        std::vector<MeshScanSection> sections;
+        std::vector<MeshScanChunk> chunks;
+        {
+            MeshTraceZone zone("locate sections");
+
+            MeshDataRecords outside;
+            MeshScanner<MeshDataRecords> scanner(text, length, outside, &sections);
+            if (!scanner.Scan())
+                return false;
+
+            size_t i;
+            for (i = 0; i < sections.size(); i++)
+                SplitSection(sections, i, chunks);
+        }
+
+        std::unique_ptr<MeshDataRecords[]> records(new MeshDataRecords[chunks.size()]);
+        std::unique_ptr<bool[]> scanned(new bool[chunks.size()]);
+        ParallelFor(chunks.size(), countThreads, [&](const size_t chunkIndex)
+        {
+            MeshTraceZone zone("scan chunk");
+
+            const MeshScanChunk &chunk = chunks[chunkIndex];
+            MeshScanner<MeshDataRecords> scanner(sections[chunk.sectionIndex], chunk, records[chunkIndex], lazyAnimations);
+            scanned[chunkIndex] = scanner.ScanChunk();
+
+            if (pLoad != NULL)
+                pLoad->AddBytesDone(chunk.end - chunk.begin);
+        });
+
+        size_t i;
+        for (i = 0; i < chunks.size(); i++)
+            if (!scanned[i])
+                return false;
+
+        // The references between ids are resolved here, by the calling thread.
+        MeshTraceZone zone("build records");
+        if (pLoad != NULL)
+            pLoad->StartPhase(MESHLOAD_BUILDING, length);
+
+        builder.AddRecords(records.get(), chunks.size());
+
+        return true;
+    }
+
+    bool ScanMeshAnimation(const char *text, const size_t length, const std::string_view animationID,
+                           MeshDataRecords &records)
+    {
+        const MeshScanTag stack[] = {SCANTAG_DOCUMENT, SCANTAG_MESH, SCANTAG_ARMATURE, SCANTAG_ANIMATIONS, SCANTAG_ANIMATION};
+        const char *names[] = {"", "mesh", "armature", "animations", "animation"};
+
+        MeshScanSection section;
+        section.begin = text;
+        section.end = text + length;
+        section.depth = sizeof(stack) / sizeof(MeshScanTag);
+        std::copy(stack, stack + section.depth, section.stack);
+        std::copy(names, names + section.depth, section.stackNames);
+
+        const MeshScanChunk chunk = {0, text, text + length};
+        MeshScanner<MeshDataRecords> scanner(section, chunk, records);
+        return scanner.ScanAnimation(animationID);
+    }
+}
@@ -0,0 +1,63 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+#include "build.h"
+#include "loading.h"
+
+
+namespace XMLMesh
+{
+    /**
+     *  Reads a mesh document that uses only the tags and attributes of the mesh format,
+     *  and passes everything to the builder in document order, without building an xml tree.
+     *
+     *  Returns false as soon as it encounters anything it doesn't handle itself:
+     *  comments, doctypes, entity references, other tags, non-ascii text, ... The builder
+     *  may then hold part of the mesh. Errors from the builder are thrown. Either way,
+     *  the caller should parse the document with libxml2 instead, to get the same result
+     *  or error as ParseMeshData would without the scanner.
+     *
+     *  With more than one thread, the sections of a large document are cut into chunks at
+     *  element boundaries. The threads record the builder calls of each chunk, and then the
+     *  calling thread makes them in document order, so that the builder gets the same calls.
+     *
+     *  With lazy animations, the contents of each animation are only located, and passed to
+     *  the builder as a lazy animation, for loading them with ScanMeshAnimation later.
+     */
+    bool ScanMeshData(const char *text, const size_t length, MeshDataBuilder &, const size_t countThreads,
+                      MeshLoadState *pLoad = NULL, const bool lazyAnimations = false);
+
+    /**
+     *  Records the layers and keys between the start and end tag of an animation that has
+     *  been added already. Returns false on anything that the scanner doesn't handle.
+     */
+    bool ScanMeshAnimation(const char *text, const size_t length, const std::string_view animationID,
+                           MeshDataRecords &);
+
+    // In parse.cpp, so that both parsers read numbers the same way.
+    const char *ParseFloat(const char *in, float &out);
+
+    // In parse.cpp, for animation contents that ScanMeshAnimation doesn't handle.
+    void ParseMeshAnimation(const std::string &contents, const std::string_view animationID, MeshDataBuilder &);
+}
+
+#endif  // SCAN_H
@@ -0,0 +1,499 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+
+#include "skeleton.h"
+#include "animate.h"
+#include "tracing.h"
+#include "counting.h"
+
+
+namespace XMLMesh
+{
+    MeshSkeleton::MeshSkeleton(std::pmr::memory_resource *p)
+    : pResource(p), bonePs(p), parentIndices(p), mBoneIndices(p), vertexPs(p), restPositions(p), restNormals(p),
+      restTangents(p), influenceOffsets(p), influences(p), mVertexIndices(p), animations(p), mAnimationIndices(p)
+    {
+    }
+    MeshSkeleton::~MeshSkeleton(void)
+    {
+    }
+
+    const MeshData *MeshSkeleton::GetMeshData(void) const
+    {
+        return pMeshData;
+    }
+
+    size_t MeshSkeleton::CountBones(void) const
+    {
+        return bonePs.size();
+    }
+    bool MeshSkeleton::HasBone(const std::string_view id) const
+    {
+        return HAS_ID(mBoneIndices, id);
+    }
+    size_t MeshSkeleton::GetBoneIndex(const std::string_view id) const
+    {
+        if (!HAS_ID(mBoneIndices, id))
+            throw MeshKeyError("No such bone: %.*s", ID_FORMAT_ARGS(id));
+
+        return mBoneIndices.at(id);
+    }
+    const MeshBone *MeshSkeleton::GetBone(const size_t boneIndex) const
+    {
+        return bonePs.at(boneIndex);
+    }
+    size_t MeshSkeleton::GetParentIndex(const size_t boneIndex) const
+    {
+        return parentIndices.at(boneIndex);
+    }
+
+    size_t MeshSkeleton::CountVertices(void) const
+    {
+        return vertexPs.size();
+    }
+    size_t MeshSkeleton::GetVertexIndex(const std::string_view id) const
+    {
+        if (!HAS_ID(mVertexIndices, id))
+            throw MeshKeyError("No such vertex: %.*s", ID_FORMAT_ARGS(id));
+
+        return mVertexIndices.at(id);
+    }
+    const MeshVertex *MeshSkeleton::GetVertex(const size_t vertexIndex) const
+    {
+        return vertexPs.at(vertexIndex);
+    }
+    ConstArrayIterable<MeshSkinInfluence> MeshSkeleton::IterInfluences(const size_t vertexIndex) const
+    {
+        size_t begin = influenceOffsets.at(vertexIndex),
+               end = influenceOffsets.at(vertexIndex + 1);
+
+        return ConstArrayIterable<MeshSkinInfluence>(influences.data() + begin, end - begin);
+    }
+    size_t MeshSkeleton::GetFirstVertexWithInfluences(const size_t countInfluences) const
+    {
+        if (countInfluences > (MESHSKIN_MAX_FIXED_INFLUENCES + 1))
+            throw MeshKeyError("No vertex range for %u influences", countInfluences);
+
+        return firstVertexWithInfluences[countInfluences];
+    }
+    const vec3 *MeshSkeleton::GetRestPositions(void) const
+    {
+        return restPositions.data();
+    }
+    bool MeshSkeleton::HasNormals(void) const
+    {
+        return hasNormals;
+    }
+    const vec3 *MeshSkeleton::GetRestNormals(void) const
+    {
+        return restNormals.data();
+    }
+    const vec3 *MeshSkeleton::GetRestTangents(void) const
+    {
+        return restTangents.data();
+    }
+    const MeshSkinInfluence *MeshSkeleton::GetInfluences(void) const
+    {
+        return influences.data();
+    }
+
+    size_t MeshSkeleton::CountAnimations(void) const
+    {
+        return animations.size();
+    }
+    bool MeshSkeleton::HasAnimation(const std::string_view id) const
+    {
+        return HAS_ID(mAnimationIndices, id);
+    }
+    size_t MeshSkeleton::GetAnimationIndex(const std::string_view id) const
+    {
+        if (!HAS_ID(mAnimationIndices, id))
+            throw MeshKeyError("No such animation: %.*s", ID_FORMAT_ARGS(id));
+
+        return mAnimationIndices.at(id);
+    }
+    const MeshSkeletonAnimation *MeshSkeleton::GetAnimation(const size_t animationIndex) const
+    {
+        if (animationIndex >= animations.size())
+            throw MeshKeyError("No such animation index: %u", animationIndex);
+
+        return &(animations[animationIndex]);
+    }
+
+    /**
+     *  Adds the bone to the skeleton, after its parents.
+     */
+    size_t AddSkeletonBone(const MeshBone *pBone,
+                           std::unordered_map<const MeshBone *, size_t> &boneIndices,
+                           std::pmr::vector<const MeshBone *> &bonePs, std::pmr::vector<size_t> &parentIndices)
+    {
+        if (HAS_ID(boneIndices, pBone))
+            return boneIndices.at(pBone);
+
+        size_t parentIndex = MESHBONE_NO_PARENT;
+        if (pBone->HasParent())
+            parentIndex = AddSkeletonBone(pBone->GetParent(), boneIndices, bonePs, parentIndices);
+
+        size_t boneIndex = bonePs.size();
+        bonePs.push_back(pBone);
+        parentIndices.push_back(parentIndex);
+        boneIndices.emplace(pBone, boneIndex);
+
+        return boneIndex;
+    }
+
+    MeshSkeleton *CompileMeshSkeleton(const MeshData *pMeshData, const bool withAnimations, const bool withNormals,
+                                      std::pmr::memory_resource *pResource)
+    {
+        MeshTraceZone zone("CompileMeshSkeleton");
+
+        MeshSkeleton *pSkeleton = new (pResource->allocate(sizeof(MeshSkeleton), alignof(MeshSkeleton)))
+                                  MeshSkeleton(pResource);
+        pSkeleton->pMeshData = pMeshData;
+        pSkeleton->hasNormals = withNormals;
+
+        try
+        {
+            std::unordered_map<const MeshBone *, size_t> boneIndices;
+            for (const MeshBone *pBone : pMeshData->IterBones())
+                AddSkeletonBone(pBone, boneIndices, pSkeleton->bonePs, pSkeleton->parentIndices);
+
+            for (const auto &pair : boneIndices)
+                pSkeleton->mBoneIndices.emplace(std::get<0>(pair)->GetID(), std::get<1>(pair));
+
+            std::vector<const MeshVertex *> vertexPs;
+            for (const MeshVertex *pVertex : pMeshData->IterVertices())
+                vertexPs.push_back(pVertex);
+
+            // Group the vertices by number of influences, for the specialized skinning loops.
+            std::stable_sort(vertexPs.begin(), vertexPs.end(),
+                             [](const MeshVertex *pVertex1, const MeshVertex *pVertex2)
+                             {
+                                 return pVertex1->CountBones() < pVertex2->CountBones();
+                             });
+
+            size_t countInfluences = 0;
+            for (const MeshVertex *pVertex : vertexPs)
+            {
+                while (countInfluences <= (MESHSKIN_MAX_FIXED_INFLUENCES + 1) && countInfluences <= pVertex->CountBones())
+                    pSkeleton->firstVertexWithInfluences[countInfluences++] = pSkeleton->vertexPs.size();
+
+                pSkeleton->mVertexIndices.emplace(pVertex->GetID(), pSkeleton->vertexPs.size());
+                pSkeleton->vertexPs.push_back(pVertex);
+                pSkeleton->restPositions.push_back(pVertex->GetPosition());
+
+                if (withNormals)
+                {
+                    pSkeleton->restNormals.push_back(CalculateVertexNormal(pVertex));
+                    pSkeleton->restTangents.push_back(std::get<0>(CalculateVertexTangentBitangent(pVertex)));
+                }
+            }
+            while (countInfluences <= (MESHSKIN_MAX_FIXED_INFLUENCES + 1))
+                pSkeleton->firstVertexWithInfluences[countInfluences++] = pSkeleton->vertexPs.size();
+
+            // Normalize the weights once, rather than on every frame.
+            pSkeleton->influenceOffsets.push_back(0);
+            for (const MeshVertex *pVertex : pSkeleton->vertexPs)
+            {
+                float sumWeight = 0.0f;
+                for (const MeshBone *pBone : pVertex->IterBones())
+                    sumWeight += pBone->GetWeight();
+
+                for (const MeshBone *pBone : pVertex->IterBones())
+                {
+                    MeshSkinInfluence influence;
+                    influence.boneIndex = boneIndices.at(pBone);
+                    influence.weight = pBone->GetWeight() / sumWeight;
+
+                    pSkeleton->influences.push_back(influence);
+                }
+
+                pSkeleton->influenceOffsets.push_back(pSkeleton->influences.size());
+            }
+
+            if (withAnimations)
+            {
+                for (const MeshSkeletalAnimation *pAnimation : pMeshData->IterAnimations())
+                {
+                    MeshSkeletonAnimation animation;
+                    animation.id.assign(pAnimation->id.data(), pAnimation->id.size());
+                    animation.length = pAnimation->length;
+
+                    for (const auto &idLayerPair : pAnimation->mLayers)
+                    {
+                        const MeshBoneLayer &layer = std::get<1>(idLayerPair);
+                        if (layer.mKeys.empty())
+                            throw MeshKeyError("Layer %s in animation %s has no keys",
+                                               layer.pBone->GetID(), pAnimation->id.data());
+
+                        std::vector<const MeshBoneKey *> keyPs;
+                        for (const auto &frameKeyPair : layer.mKeys)
+                        {
+                            if (std::get<0>(frameKeyPair) > pAnimation->length)
+                                throw MeshKeyError("Layer %s in animation %s has a key beyond frame %u",
+                                                   layer.pBone->GetID(), pAnimation->id.data(), pAnimation->length);
+
+                            keyPs.push_back(&(std::get<1>(frameKeyPair)));
+                        }
+                        std::sort(keyPs.begin(), keyPs.end(),
+                                  [](const MeshBoneKey *pKey1, const MeshBoneKey *pKey2) { return pKey1->frame < pKey2->frame; });
+
+                        MeshSkeletonLayer skeletonLayer;
+                        skeletonLayer.boneIndex = boneIndices.at(layer.pBone);
+                        for (const MeshBoneKey *pKey : keyPs)
+                        {
+                            skeletonLayer.keyFrames.push_back(pKey->frame);
+                            skeletonLayer.keyTransformations.push_back(pKey->transformation);
+                        }
+
+                        animation.layers.push_back(skeletonLayer);
+                    }
+
+                    pSkeleton->mAnimationIndices.emplace(pAnimation->id, pSkeleton->animations.size());
+                    pSkeleton->animations.push_back(animation);
+                }
+            }
+        }
+        catch (...)
+        {
+            DestroyMeshSkeleton(pSkeleton);
+
+            std::rethrow_exception(std::current_exception());
+        }
+
+        return pSkeleton;
+    }
+
+    void DestroyMeshSkeleton(MeshSkeleton *pSkeleton)
+    {
+        if (pSkeleton == NULL)
+            return;
+
+        std::pmr::memory_resource *pResource = pSkeleton->pResource;
+
+        pSkeleton->~MeshSkeleton();
+        pResource->deallocate(pSkeleton, sizeof(MeshSkeleton), alignof(MeshSkeleton));
+    }
+
+    float GetAnimationFrame(const MeshSkeleton *pSkeleton, const size_t animationIndex,
+                            const milliseconds ms, const float framesPerSecond, const bool loop)
+    {
+        const MeshSkeletonAnimation *pAnimation = pSkeleton->GetAnimation(animationIndex);
+
+        if (loop)
+            return ModulateFrame(ms, framesPerSecond, pAnimation->length);
+        else
+            return ClampFrame(ms, framesPerSecond, pAnimation->length);
+    }
+
+    size_t CountKeysUntil(const MeshSkeletonLayer &layer, const float frame)
+    {
+        if (IsCountingMeshWork())
+        {
+            // A binary search looks at one key per halving.
+            size_t countScanned = 0, n;
+            for (n = layer.keyFrames.size(); n > 0; n >>= 1)
+                countScanned++;
+
+            AddToThreadCounter(MESHCOUNTER_KEYS_SCANNED, countScanned);
+        }
+
+        return std::upper_bound(layer.keyFrames.begin(), layer.keyFrames.end(), frame,
+                                [](const float f, const size_t keyFrame) { return f < float(keyFrame); })
+               - layer.keyFrames.begin();
+    }
+
+    MeshBoneTransformation SampleSkeletonLayer(const MeshSkeletonLayer &layer, const size_t animationLength,
+                                               const float frame, const bool loop, const size_t countKeysUntil)
+    {
+        const size_t countKeys = layer.keyFrames.size();
+        size_t iPrev, iNext;
+        float distanceToPrev, distanceToNext;
+
+        // Same rules as PickKeyFrames, but on sorted keys.
+        if (countKeysUntil > 0)
+        {
+            iPrev = countKeysUntil - 1;
+            distanceToPrev = frame - float(layer.keyFrames[iPrev]);
+        }
+        else if (loop)
+        {
+            iPrev = countKeys - 1;
+            distanceToPrev = frame + float(animationLength - layer.keyFrames[iPrev]);
+        }
+        else
+        {
+            iPrev = 0;
+            distanceToPrev = 0.0f;
+        }
+
+        if (countKeysUntil > 0 && float(layer.keyFrames[countKeysUntil - 1]) == frame)
+        {
+            iNext = countKeysUntil - 1;
+            distanceToNext = 0.0f;
+        }
+        else if (countKeysUntil < countKeys)
+        {
+            iNext = countKeysUntil;
+            distanceToNext = float(layer.keyFrames[iNext]) - frame;
+        }
+        else if (loop)
+        {
+            iNext = 0;
+            distanceToNext = float(animationLength) - frame + float(layer.keyFrames[0]);
+        }
+        else
+        {
+            iNext = countKeys - 1;
+            distanceToNext = 0.0f;
+        }
+
+        if (iPrev == iNext)  // We hit an exact key frame.
+        {
+            CountMeshWork(MESHCOUNTER_EXACT_KEYS, 1);
+            return layer.keyTransformations[iPrev];
+        }
+
+        CountMeshWork(MESHCOUNTER_INTERPOLATIONS, 1);
+        return Interpolate(layer.keyTransformations[iPrev], layer.keyTransformations[iNext],
+                               distanceToPrev / (distanceToPrev + distanceToNext));
+    }
+
+    void GetSkeletonPoseAt(const MeshSkeleton *pSkeleton, const size_t animationIndex,
+                           const float frame, const bool loop,
+                           MeshBoneTransformation *poseOut)
+    {
+        MeshTraceZone zone("GetSkeletonPoseAt");
+
+        const MeshSkeletonAnimation *pAnimation = pSkeleton->GetAnimation(animationIndex);
+
+        std::fill(poseOut, poseOut + pSkeleton->CountBones(), MESHBONETRANSFORM_ID);
+
+        for (const MeshSkeletonLayer &layer : pAnimation->layers)
+            poseOut[layer.boneIndex] = SampleSkeletonLayer(layer, pAnimation->length, frame, loop,
+                                                           CountKeysUntil(layer, frame));
+    }
+
+    void GetBonePalette(const MeshSkeleton *pSkeleton, const MeshBoneTransformation *pose,
+                        MeshBonePaletteEntry *paletteOut)
+    {
+        MeshTraceZone zone("GetBonePalette");
+
+        size_t boneIndex, parentIndex, countParentSteps = 0;
+        vec3 pivot, translation;
+        for (boneIndex = 0; boneIndex < pSkeleton->CountBones(); boneIndex++)
+        {
+            const MeshBoneTransformation &t = pose[boneIndex];
+
+            // Rotation around the bone's head, followed by the translation.
+            pivot = pSkeleton->GetBone(boneIndex)->GetHeadPosition();
+            translation = pivot - t.rotation * pivot + t.translation;
+
+            // The parent was already converted, because it comes first.
+            parentIndex = pSkeleton->GetParentIndex(boneIndex);
+            if (parentIndex == MESHBONE_NO_PARENT)
+            {
+                paletteOut[boneIndex].rotation = t.rotation;
+                paletteOut[boneIndex].translation = translation;
+            }
+            else
+            {
+                const MeshBonePaletteEntry &parent = paletteOut[parentIndex];
+
+                paletteOut[boneIndex].rotation = parent.rotation * t.rotation;
+                paletteOut[boneIndex].translation = parent.rotation * translation + parent.translation;
+                countParentSteps++;
+            }
+        }
+
+        CountMeshWork(MESHCOUNTER_BONES_EVALUATED, pSkeleton->CountBones());
+        CountMeshWork(MESHCOUNTER_PARENT_STEPS, countParentSteps);
+    }
+
+    vec3 SkinVertex(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette, const size_t vertexIndex,
+                    const MeshSkinningMode mode, quat *pRotationOut)
+    {
+        const vec3 &restPosition = pSkeleton->GetRestPositions()[vertexIndex];
+
+        ConstArrayIterable<MeshSkinInfluence> influences = pSkeleton->IterInfluences(vertexIndex);
+        const size_t countInfluences = influences.end() - influences.begin();
+        if (countInfluences == 0)
+        {
+            if (pRotationOut != NULL)
+                *pRotationOut = quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+            return restPosition;
+        }
+
+        if (mode == MESHSKIN_DUAL_QUATERNION)
+            return BlendDualQuaternion(restPosition, influences.begin(), countInfluences, palette, pRotationOut);
+        else
+            return BlendLinear(restPosition, influences.begin(), countInfluences, palette, pRotationOut);
+    }
+
+    void SkinVertices(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette, vec3 *positionsOut,
+                      const MeshSkinningMode mode)
+    {
+        MeshTraceZone zone("SkinVertices");
+
+        auto output = [positionsOut](const size_t vertexIndex, const vec3 &position)
+                      {
+                          positionsOut[vertexIndex] = position;
+                      };
+
+        SkinSkeletonVertices(pSkeleton, palette, mode, output);
+    }
+
+    void SkinVertices(const MeshSkeleton *pSkeleton, const MeshBonePaletteEntry *palette, vec3 *positionsOut,
+                      vec3 *normalsOut, vec3 *tangentsOut, const MeshSkinningMode mode)
+    {
+        MeshTraceZone zone("SkinVertices with normals");
+
+        if (!pSkeleton->HasNormals())
+            throw MeshKeyError("The skeleton was compiled without normals");
+
+        const vec3 *restNormals = pSkeleton->GetRestNormals(),
+                   *restTangents = pSkeleton->GetRestTangents();
+        auto output = [positionsOut, normalsOut, tangentsOut, restNormals, restTangents]
+                      (const size_t vertexIndex, const vec3 &position, const quat &rotation)
+                      {
+                          positionsOut[vertexIndex] = position;
+                          normalsOut[vertexIndex] = rotation * restNormals[vertexIndex];
+                          if (tangentsOut != NULL)
+                              tangentsOut[vertexIndex] = rotation * restTangents[vertexIndex];
+                      };
+
+        SkinSkeletonVerticesWithRotations(pSkeleton, palette, mode, output);
+
+        CountMeshWork(MESHCOUNTER_NORMALS_COMPUTED, pSkeleton->CountVertices());
+    }
+
+    void GetSkeletonPose(const MeshSkeleton *pSkeleton,
+                         const std::unordered_map<std::string, MeshBoneTransformation> &boneTransformations,
+                         MeshBoneTransformation *poseOut)
+    {
+        std::fill(poseOut, poseOut + pSkeleton->CountBones(), MESHBONETRANSFORM_ID);
+
+        for (const auto &idTransformationPair : boneTransformations)
+        {
+            // Like ApplyBoneTransformations, ignore transformations of unknown bones.
+            if (pSkeleton->HasBone(std::get<0>(idTransformationPair)))
+                poseOut[pSkeleton->GetBoneIndex(std::get<0>(idTransformationPair))] = std::get<1>(idTransformationPair);
+        }
+    }
+}
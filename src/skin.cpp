@@ -0,0 +1,338 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "skin.h"
+#include "animate.h"
+#include "tracing.h"
+#include "counting.h"
+#include "accounting.h"
+
+
+namespace XMLMesh
+{
+    MeshSkinningTable::MeshSkinningTable(std::pmr::memory_resource *p)
+    : pResource(p), pOwnedSkeleton(NULL), destinationPs(p), pose(p), palette(p)
+    {
+    }
+    MeshSkinningTable::~MeshSkinningTable(void)
+    {
+        DestroyMeshSkeleton(pOwnedSkeleton);
+    }
+
+    const MeshSkeleton *MeshSkinningTable::GetSkeleton(void) const
+    {
+        return pSkeleton;
+    }
+    MeshState *MeshSkinningTable::GetMeshState(void)
+    {
+        return pMeshState;
+    }
+    MeshSkinningMode MeshSkinningTable::GetMode(void) const
+    {
+        return mode;
+    }
+
+    MeshSkinningTable *CompileMeshSkinningTable(const MeshSkeleton *pSkeleton, MeshState *pMeshState,
+                                                const MeshSkinningMode mode, std::pmr::memory_resource *pResource)
+    {
+        MeshTraceZone zone("CompileMeshSkinningTable");
+
+        const size_t countVertices = pSkeleton->CountVertices();
+        size_t vertexIndex;
+
+        MeshSkinningTable *pTable = new (pResource->allocate(sizeof(MeshSkinningTable), alignof(MeshSkinningTable)))
+                                    MeshSkinningTable(pResource);
+        pTable->pSkeleton = pSkeleton;
+        pTable->pMeshState = pMeshState;
+        pTable->mode = mode;
+        pTable->pose.resize(pSkeleton->CountBones());
+        pTable->palette.resize(pSkeleton->CountBones());
+
+        try
+        {
+            for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                pTable->destinationPs.push_back(pMeshState->GetVertex(pSkeleton->GetVertex(vertexIndex)->GetID()));
+        }
+        catch (...)
+        {
+            DestroyMeshSkinningTable(pTable);
+
+            std::rethrow_exception(std::current_exception());
+        }
+
+        return pTable;
+    }
+
+    void DestroyMeshSkinningTable(MeshSkinningTable *pTable)
+    {
+        if (pTable == NULL)
+            return;
+
+        std::pmr::memory_resource *pResource = pTable->pResource;
+
+        pTable->~MeshSkinningTable();
+        pResource->deallocate(pTable, sizeof(MeshSkinningTable), alignof(MeshSkinningTable));
+    }
+
+    void MeshSkinningTable::Skin(const MeshBonePaletteEntry *palette)
+    {
+        MeshTraceZone zone("skin table");
+
+        MeshVertex *const *destinations = destinationPs.data();
+        auto output = [destinations](const size_t vertexIndex, const vec3 &position)
+                      {
+                          destinations[vertexIndex]->SetPosition(position);
+                      };
+
+        SkinSkeletonVertices(pSkeleton, palette, mode, output);
+    }
+
+    void ApplyBoneTransformations(MeshSkinningTable *pTable, const MeshBoneTransformation *pose)
+    {
+        GetBonePalette(pTable->pSkeleton, pose, pTable->palette.data());
+        pTable->Skin(pTable->palette.data());
+    }
+
+    void ApplyBoneTransformations(MeshSkinningTable *pTable,
+                                  const std::unordered_map<std::string, MeshBoneTransformation> &boneTransformations)
+    {
+        GetSkeletonPose(pTable->pSkeleton, boneTransformations, pTable->pose.data());
+        ApplyBoneTransformations(pTable, pTable->pose.data());
+    }
+
+    void ApplyBoneTransformations(const MeshData *pMeshData,
+                                  const std::unordered_map<std::string, MeshBoneTransformation> &boneTransformations,
+                                  MeshState *pMeshState)
+    {
+        MeshTraceZone zone("ApplyBoneTransformations");
+
+        MeshSkinningTable *pTable = pMeshState->pSkinningTable;
+
+        /*
+         *  Compile a table on first use, or when used with another MeshData object.
+         *  That may be at the address of the one the table was compiled from, if that one
+         *  has been destroyed, so the serial numbers are compared.
+         */
+        if (pTable == NULL || pMeshState->skinningSerial != pMeshData->serial)
+        {
+            DestroyMeshSkinningTable(pTable);
+            pMeshState->pSkinningTable = NULL;
+
+            // Like the rest of the MeshState, in its memory resource.
+            std::pmr::memory_resource *pAccount = pMeshState->pAccounts->Get(MESHMEMORY_SKINNING);
+
+            MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData, false, false, pAccount);
+            try
+            {
+                pTable = CompileMeshSkinningTable(pSkeleton, pMeshState, MESHSKIN_LINEAR, pAccount);
+            }
+            catch (...)
+            {
+                DestroyMeshSkeleton(pSkeleton);
+
+                std::rethrow_exception(std::current_exception());
+            }
+            pTable->pOwnedSkeleton = pSkeleton;
+            pMeshState->pSkinningTable = pTable;
+            pMeshState->skinningSerial = pMeshData->serial;
+        }
+
+        ApplyBoneTransformations(pTable, boneTransformations);
+    }
+
+    MeshIncrementalSkinner::MeshIncrementalSkinner(void): hasPrevious(false), countUpdates(0)
+    {
+    }
+    MeshIncrementalSkinner::~MeshIncrementalSkinner(void)
+    {
+    }
+
+    bool Differs(const MeshBoneTransformation &t0, const MeshBoneTransformation &t1, const float tolerance)
+    {
+        size_t i;
+        for (i = 0; i < 4; i++)
+            if (std::abs(t0.rotation[i] - t1.rotation[i]) > tolerance)
+                return true;
+
+        for (i = 0; i < 3; i++)
+            if (std::abs(t0.translation[i] - t1.translation[i]) > tolerance)
+                return true;
+
+        return false;
+    }
+
+    void MeshIncrementalSkinner::Update(const MeshBoneTransformation *pose)
+    {
+        MeshTraceZone zone("MeshIncrementalSkinner::Update");
+
+        const size_t countBones = pSkeleton->CountBones();
+        size_t boneIndex, parentIndex, i, vertexIndex, countParentSteps = 0;
+
+        statistics.countDirtyBones = 0;
+        statistics.countSkinnedVertices = 0;
+
+        // Dirty bones make their children dirty, parents come first.
+        for (boneIndex = 0; boneIndex < countBones; boneIndex++)
+        {
+            parentIndex = pSkeleton->GetParentIndex(boneIndex);
+            if (parentIndex != MESHBONE_NO_PARENT)
+                countParentSteps++;
+
+            dirtyBones[boneIndex] = !hasPrevious
+                                 || Differs(pose[boneIndex], previousPose[boneIndex], tolerance)
+                                 || (parentIndex != MESHBONE_NO_PARENT && dirtyBones[parentIndex]);
+            if (dirtyBones[boneIndex])
+            {
+                // Keep the reference pose where it was, so that slow drifts still get noticed.
+                previousPose[boneIndex] = pose[boneIndex];
+                statistics.countDirtyBones++;
+            }
+        }
+
+        if (!hasPrevious)
+        {
+            GetBonePalette(pSkeleton, previousPose.data(), palette.data());
+            SkinVertices(pSkeleton, palette.data(), positions.data());
+
+            statistics.countSkinnedVertices = positions.size();
+            for (vertexIndex = 0; vertexIndex < stateVertexPs.size(); vertexIndex++)
+                stateVertexPs[vertexIndex]->SetPosition(positions[vertexIndex]);
+        }
+        else if (statistics.countDirtyBones > 0)
+        {
+            // There are far fewer bones than vertices, so just convert all of them.
+            GetBonePalette(pSkeleton, previousPose.data(), palette.data());
+
+            countUpdates++;
+            for (boneIndex = 0; boneIndex < countBones; boneIndex++)
+            {
+                if (!dirtyBones[boneIndex])
+                    continue;
+
+                for (i = boneVertexOffsets[boneIndex]; i < boneVertexOffsets[boneIndex + 1]; i++)
+                {
+                    vertexIndex = boneVertexIndices[i];
+                    if (vertexUpdates[vertexIndex] == countUpdates)
+                        continue;  // already done
+
+                    vertexUpdates[vertexIndex] = countUpdates;
+                    positions[vertexIndex] = SkinVertex(pSkeleton, palette.data(), vertexIndex);
+                    if (!stateVertexPs.empty())
+                        stateVertexPs[vertexIndex]->SetPosition(positions[vertexIndex]);
+
+                    statistics.countSkinnedVertices++;
+                }
+            }
+
+            CountMeshWork(MESHCOUNTER_VERTICES_SKINNED, statistics.countSkinnedVertices);
+        }
+
+        CountMeshWork(MESHCOUNTER_PARENT_STEPS, countParentSteps);
+
+        hasPrevious = true;
+
+        statistics.countUpdates++;
+        statistics.totalDirtyBones += statistics.countDirtyBones;
+        statistics.totalSkinnedVertices += statistics.countSkinnedVertices;
+    }
+
+    void MeshIncrementalSkinner::Reset(void)
+    {
+        hasPrevious = false;
+    }
+
+    const vec3 *MeshIncrementalSkinner::GetPositions(void) const
+    {
+        return positions.data();
+    }
+
+    const MeshIncrementalSkinStatistics &MeshIncrementalSkinner::GetStatistics(void) const
+    {
+        return statistics;
+    }
+    void MeshIncrementalSkinner::ResetStatistics(void)
+    {
+        statistics.countDirtyBones = 0;
+        statistics.countSkinnedVertices = 0;
+        statistics.countUpdates = 0;
+        statistics.totalDirtyBones = 0;
+        statistics.totalSkinnedVertices = 0;
+    }
+
+    MeshIncrementalSkinner *CreateMeshIncrementalSkinner(const MeshSkeleton *pSkeleton, MeshState *pMeshState,
+                                                         const float tolerance)
+    {
+        const size_t countBones = pSkeleton->CountBones(),
+                     countVertices = pSkeleton->CountVertices();
+        size_t boneIndex, vertexIndex;
+
+        MeshIncrementalSkinner *pSkinner = new MeshIncrementalSkinner;
+        pSkinner->pSkeleton = pSkeleton;
+        pSkinner->tolerance = tolerance;
+        pSkinner->previousPose.resize(countBones);
+        pSkinner->palette.resize(countBones);
+        pSkinner->dirtyBones.resize(countBones);
+        pSkinner->vertexUpdates.resize(countVertices, 0);
+        pSkinner->positions.resize(countVertices);
+        pSkinner->ResetStatistics();
+
+        // Index the vertices by the bones that pull at them.
+        std::vector<size_t> countsBoneVertices(countBones, 0);
+        for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+            for (const MeshSkinInfluence &influence : pSkeleton->IterInfluences(vertexIndex))
+                countsBoneVertices[influence.boneIndex]++;
+
+        pSkinner->boneVertexOffsets.resize(countBones + 1, 0);
+        for (boneIndex = 0; boneIndex < countBones; boneIndex++)
+            pSkinner->boneVertexOffsets[boneIndex + 1] = pSkinner->boneVertexOffsets[boneIndex]
+                                                       + countsBoneVertices[boneIndex];
+
+        pSkinner->boneVertexIndices.resize(pSkinner->boneVertexOffsets[countBones]);
+        std::fill(countsBoneVertices.begin(), countsBoneVertices.end(), 0);
+        for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+            for (const MeshSkinInfluence &influence : pSkeleton->IterInfluences(vertexIndex))
+            {
+                boneIndex = influence.boneIndex;
+                pSkinner->boneVertexIndices[pSkinner->boneVertexOffsets[boneIndex] + countsBoneVertices[boneIndex]] = vertexIndex;
+                countsBoneVertices[boneIndex]++;
+            }
+
+        if (pMeshState != NULL)
+        {
+            try
+            {
+                for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                    pSkinner->stateVertexPs.push_back(pMeshState->GetVertex(pSkeleton->GetVertex(vertexIndex)->GetID()));
+            }
+            catch (...)
+            {
+                delete pSkinner;
+
+                std::rethrow_exception(std::current_exception());
+            }
+        }
+
+        return pSkinner;
+    }
+
+    void DestroyMeshIncrementalSkinner(MeshIncrementalSkinner *pSkinner)
+    {
+        delete pSkinner;
+    }
+}
@@ -0,0 +1,183 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "counting.h"
+
+
+namespace XMLMesh
+{
+    std::atomic<bool> meshStatisticsEnabled(false);
+
+    /**
+     *  Only its own thread adds to the counts, others read them. The counts only go up,
+     *  resetting moves the baseline instead.
+     */
+    struct MeshCounterBlock
+    {
+        std::atomic<uint64_t> counts[COUNT_MESHCOUNTERS];
+        uint64_t baselines[COUNT_MESHCOUNTERS];  // guarded by counterBlocksMutex
+    };
+
+    // Like the trace buffers, blocks are reused by new threads, since the threads of loads come and go.
+    std::mutex counterBlocksMutex;
+    std::vector<std::unique_ptr<MeshCounterBlock>> counterBlocks;
+    std::vector<MeshCounterBlock *> freeCounterBlockPs;
+    uint64_t retiredCounts[COUNT_MESHCOUNTERS] = {0};  // of ended threads, since the last reset
+
+    class ThreadCounterBlock
+    {
+        private:
+            MeshCounterBlock *pBlock;
+        public:
+            ThreadCounterBlock(void): pBlock(NULL) {}
+            ~ThreadCounterBlock(void)
+            {
+                if (pBlock == NULL)
+                    return;
+
+                // Keep the counts, but not in this block, so that the next thread starts at zero.
+                std::scoped_lock lock(counterBlocksMutex);
+                size_t i;
+                for (i = 0; i < COUNT_MESHCOUNTERS; i++)
+                {
+                    const uint64_t count = pBlock->counts[i].load(std::memory_order_relaxed);
+                    retiredCounts[i] += count - pBlock->baselines[i];
+                    pBlock->baselines[i] = count;
+                }
+                freeCounterBlockPs.push_back(pBlock);
+            }
+
+            MeshCounterBlock *Get(void)
+            {
+                if (pBlock != NULL)
+                    return pBlock;
+
+                std::scoped_lock lock(counterBlocksMutex);
+                if (freeCounterBlockPs.empty())
+                {
+                    counterBlocks.emplace_back(new MeshCounterBlock);
+                    pBlock = counterBlocks.back().get();
+
+                    size_t i;
+                    for (i = 0; i < COUNT_MESHCOUNTERS; i++)
+                    {
+                        pBlock->counts[i] = 0;
+                        pBlock->baselines[i] = 0;
+                    }
+                }
+                else
+                {
+                    pBlock = freeCounterBlockPs.back();
+                    freeCounterBlockPs.pop_back();
+                }
+
+                return pBlock;
+            }
+    };
+
+    thread_local ThreadCounterBlock threadCounterBlock;
+
+    void AddToThreadCounter(const MeshCounter counter, const uint64_t amount)
+    {
+        std::atomic<uint64_t> &count = threadCounterBlock.Get()->counts[counter];
+
+        // No other thread writes to it, so there's no need for an atomic add.
+        count.store(count.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void EnableMeshStatistics(const bool enable)
+    {
+        meshStatisticsEnabled.store(enable);
+    }
+
+    bool IsMeshStatisticsEnabled(void)
+    {
+        return meshStatisticsEnabled.load();
+    }
+
+    MeshStatistics ToMeshStatistics(const uint64_t *counts)
+    {
+        MeshStatistics statistics;
+        statistics.countKeysScanned = counts[MESHCOUNTER_KEYS_SCANNED];
+        statistics.countExactKeys = counts[MESHCOUNTER_EXACT_KEYS];
+        statistics.countInterpolations = counts[MESHCOUNTER_INTERPOLATIONS];
+        statistics.countBonesEvaluated = counts[MESHCOUNTER_BONES_EVALUATED];
+        statistics.countParentSteps = counts[MESHCOUNTER_PARENT_STEPS];
+        statistics.countVerticesSkinned = counts[MESHCOUNTER_VERTICES_SKINNED];
+        statistics.countNormalsComputed = counts[MESHCOUNTER_NORMALS_COMPUTED];
+        statistics.countBufferBytes = counts[MESHCOUNTER_BUFFER_BYTES];
+        return statistics;
+    }
+
+    /**
+     *  Must be called with counterBlocksMutex locked.
+     *  When 'reset' is set, the blocks' baselines move up to their current counts.
+     */
+    MeshStatistics SumCounters(const bool reset)
+    {
+        uint64_t sums[COUNT_MESHCOUNTERS];
+        size_t i;
+        for (i = 0; i < COUNT_MESHCOUNTERS; i++)
+        {
+            sums[i] = retiredCounts[i];
+            if (reset)
+                retiredCounts[i] = 0;
+        }
+
+        for (const std::unique_ptr<MeshCounterBlock> &pBlock : counterBlocks)
+        {
+            for (i = 0; i < COUNT_MESHCOUNTERS; i++)
+            {
+                const uint64_t count = pBlock->counts[i].load(std::memory_order_relaxed);
+                sums[i] += count - pBlock->baselines[i];
+                if (reset)
+                    pBlock->baselines[i] = count;
+            }
+        }
+
+        return ToMeshStatistics(sums);
+    }
+
+    MeshStatistics GetMeshStatistics(void)
+    {
+        std::scoped_lock lock(counterBlocksMutex);
+        return SumCounters(false);
+    }
+
+    MeshStatistics ResetMeshStatistics(void)
+    {
+        std::scoped_lock lock(counterBlocksMutex);
+        return SumCounters(true);
+    }
+
+    MeshStatistics GetThreadMeshStatistics(void)
+    {
+        MeshCounterBlock *pBlock = threadCounterBlock.Get();
+
+        std::scoped_lock lock(counterBlocksMutex);
+        uint64_t counts[COUNT_MESHCOUNTERS];
+        size_t i;
+        for (i = 0; i < COUNT_MESHCOUNTERS; i++)
+            counts[i] = pBlock->counts[i].load(std::memory_order_relaxed) - pBlock->baselines[i];
+
+        return ToMeshStatistics(counts);
+    }
+}
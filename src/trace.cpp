@@ -0,0 +1,216 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tracing.h"
+
+
+namespace XMLMesh
+{
+    std::atomic<bool> meshTracingEnabled(false);
+
+    const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+    uint64_t GetTraceTime(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                    - traceEpoch).count();
+    }
+
+    struct MeshTraceEvent
+    {
+        const char *name;
+        uint64_t start, end;
+        size_t threadNumber;
+    };
+
+    /**
+     *  An event in a buffer. It may be read while its thread overwrites it,
+     *  so its fields are atomic. The counters tell whether what was read holds.
+     */
+    struct MeshTraceSlot
+    {
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> start, end;
+        std::atomic<size_t> threadNumber;
+    };
+
+    /**
+     *  Only written by the thread that owns it. Readers use the counters to tell
+     *  which events are complete, like with a seqlock.
+     */
+    struct MeshTraceBuffer
+    {
+        MeshTraceSlot events[MESHTRACE_BUFFER_SIZE];
+        std::atomic<uint64_t> countWritten,
+                              countCleared;
+        size_t threadNumber;
+    };
+
+    // Buffers are kept after their thread ends, so that its zones can still be written.
+    // New threads reuse them, since the threads of loads come and go.
+    std::mutex traceBuffersMutex;
+    std::vector<std::unique_ptr<MeshTraceBuffer>> traceBuffers;
+    std::vector<MeshTraceBuffer *> freeTraceBufferPs;
+    size_t countTraceThreads = 0;
+
+    class ThreadTraceBuffer
+    {
+        private:
+            MeshTraceBuffer *pBuffer;
+        public:
+            ThreadTraceBuffer(void): pBuffer(NULL) {}
+            ~ThreadTraceBuffer(void)
+            {
+                if (pBuffer != NULL)
+                {
+                    std::scoped_lock lock(traceBuffersMutex);
+                    freeTraceBufferPs.push_back(pBuffer);
+                }
+            }
+
+            MeshTraceBuffer *Get(void)
+            {
+                if (pBuffer != NULL)
+                    return pBuffer;
+
+                std::scoped_lock lock(traceBuffersMutex);
+                if (freeTraceBufferPs.empty())
+                {
+                    traceBuffers.emplace_back(new MeshTraceBuffer);
+                    pBuffer = traceBuffers.back().get();
+                    pBuffer->countWritten = 0;
+                    pBuffer->countCleared = 0;
+                }
+                else
+                {
+                    pBuffer = freeTraceBufferPs.back();
+                    freeTraceBufferPs.pop_back();
+                }
+                pBuffer->threadNumber = countTraceThreads++;
+
+                return pBuffer;
+            }
+    };
+
+    thread_local ThreadTraceBuffer threadTraceBuffer;
+
+    void RecordTraceZone(const char *name, const uint64_t start, const uint64_t end)
+    {
+        MeshTraceBuffer *pBuffer = threadTraceBuffer.Get();
+
+        const uint64_t n = pBuffer->countWritten.load(std::memory_order_relaxed);
+
+        // A reader that sees any of the new fields will then also see that event n is being written.
+        std::atomic_thread_fence(std::memory_order_release);
+
+        MeshTraceSlot &slot = pBuffer->events[n % MESHTRACE_BUFFER_SIZE];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.threadNumber.store(pBuffer->threadNumber, std::memory_order_relaxed);
+
+        pBuffer->countWritten.store(n + 1, std::memory_order_release);
+    }
+
+    void EnableMeshTracing(const bool enable)
+    {
+        meshTracingEnabled.store(enable);
+    }
+
+    bool IsMeshTracingEnabled(void)
+    {
+        return meshTracingEnabled.load();
+    }
+
+    void ClearMeshTrace(void)
+    {
+        std::scoped_lock lock(traceBuffersMutex);
+        for (const std::unique_ptr<MeshTraceBuffer> &pBuffer : traceBuffers)
+            pBuffer->countCleared.store(pBuffer->countWritten.load(std::memory_order_acquire));
+    }
+
+    /**
+     *  Chrome traces are in microseconds.
+     */
+    void WriteMicroseconds(std::ostream &os, const uint64_t ns)
+    {
+        const char fill = os.fill('0');
+        os << (ns / 1000) << "." << std::setw(3) << (ns % 1000);
+        os.fill(fill);
+    }
+
+    void WriteMeshTrace(std::ostream &os)
+    {
+        std::vector<MeshTraceEvent> events;
+        {
+            std::scoped_lock lock(traceBuffersMutex);
+            for (const std::unique_ptr<MeshTraceBuffer> &pBuffer : traceBuffers)
+            {
+                const uint64_t countBefore = pBuffer->countWritten.load(std::memory_order_acquire),
+                               countCleared = pBuffer->countCleared.load();
+                uint64_t first = std::max(countCleared,
+                                          countBefore > MESHTRACE_BUFFER_SIZE ? countBefore - MESHTRACE_BUFFER_SIZE : 0),
+                         i;
+
+                const size_t offset = events.size();
+                for (i = first; i < countBefore; i++)
+                {
+                    const MeshTraceSlot &slot = pBuffer->events[i % MESHTRACE_BUFFER_SIZE];
+                    events.push_back({slot.name.load(std::memory_order_relaxed),
+                                      slot.start.load(std::memory_order_relaxed),
+                                      slot.end.load(std::memory_order_relaxed),
+                                      slot.threadNumber.load(std::memory_order_relaxed)});
+                }
+
+                // The owning thread may have overwritten the oldest ones in the meantime,
+                // or be overwriting the one after those. The fence keeps the copies above
+                // from moving after the count.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const uint64_t countAfter = pBuffer->countWritten.load(std::memory_order_relaxed);
+                if (countAfter + 1 > first + MESHTRACE_BUFFER_SIZE)
+                {
+                    const size_t countLost = std::min(countAfter + 1 - MESHTRACE_BUFFER_SIZE - first, countBefore - first);
+                    events.erase(events.begin() + offset, events.begin() + offset + countLost);
+                }
+            }
+        }
+
+        os << "{\"traceEvents\": [" << std::endl;
+        size_t i;
+        for (i = 0; i < events.size(); i++)
+        {
+            const MeshTraceEvent &event = events[i];
+
+            os << "{\"name\": \"" << event.name << "\", \"cat\": \"xml-mesh\", \"ph\": \"X\", \"ts\": ";
+            WriteMicroseconds(os, event.start);
+            os << ", \"dur\": ";
+            WriteMicroseconds(os, event.end - event.start);
+            os << ", \"pid\": 0, \"tid\": " << event.threadNumber << "}";
+            if (i + 1 < events.size())
+                os << ",";
+            os << std::endl;
+        }
+        os << "], \"displayTimeUnit\": \"ms\"}" << std::endl;
+    }
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "trace.h"
+
+
+namespace XMLMesh
+{
+    extern std::atomic<bool> meshTracingEnabled;
+
+    // Nanoseconds since the library was loaded.
+    uint64_t GetTraceTime(void);
+
+    void RecordTraceZone(const char *name, const uint64_t start, const uint64_t end);
+
+    /**
+     *  Records the time between its construction and destruction, if tracing is enabled.
+     *  The name must be a string literal, only its pointer is stored.
+     */
+    class MeshTraceZone
+    {
+        private:
+            const char *name;  // NULL when not recording
+            uint64_t start;
+        public:
+            MeshTraceZone(const char *n): name(NULL), start(0)
+            {
+                if (meshTracingEnabled.load(std::memory_order_relaxed))
+                {
+                    name = n;
+                    start = GetTraceTime();
+                }
+            }
+            ~MeshTraceZone(void)
+            {
+                if (name != NULL)
+                    RecordTraceZone(name, start, GetTraceTime());
+            }
+
+            MeshTraceZone(const MeshTraceZone &) = delete;
+            void operator=(const MeshTraceZone &) = delete;
+    };
+}
+#endif  // TRACING_H
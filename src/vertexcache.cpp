@@ -0,0 +1,244 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "cache.h"
+#include "tracing.h"
+
+
+namespace XMLMesh
+{
+    MeshVertexAnimationCache::MeshVertexAnimationCache(void)
+    {
+    }
+    MeshVertexAnimationCache::~MeshVertexAnimationCache(void)
+    {
+    }
+
+    const MeshSkeleton *MeshVertexAnimationCache::GetSkeleton(void) const
+    {
+        return pSkeleton;
+    }
+    size_t MeshVertexAnimationCache::GetAnimationIndex(void) const
+    {
+        return animationIndex;
+    }
+    size_t MeshVertexAnimationCache::CountFrames(void) const
+    {
+        return countFrames;
+    }
+    bool MeshVertexAnimationCache::HasNormals(void) const
+    {
+        return !normals.empty();
+    }
+    size_t MeshVertexAnimationCache::GetMemoryUsage(void) const
+    {
+        return sizeof(MeshVertexAnimationCache)
+             + positions.capacity() * sizeof(uint16_t)
+             + normals.capacity() * sizeof(int8_t);
+    }
+
+    void MeshVertexAnimationCache::GetFramesAt(const milliseconds ms, const float framesPerSecond,
+                                               size_t &frame0Out, size_t &frame1Out, float &sOut) const
+    {
+        const float frame = GetAnimationFrame(pSkeleton, animationIndex, ms, framesPerSecond, loop);
+
+        frame0Out = std::min(size_t(frame), countFrames - 1);
+        frame1Out = std::min(frame0Out + 1, countFrames - 1);
+        sOut = std::min(frame - float(frame0Out), 1.0f);
+    }
+
+    template <typename PositionOutput>
+    void MeshVertexAnimationCache::DecodePositions(const size_t frame0, const size_t frame1, const float s,
+                                                   PositionOutput output) const
+    {
+        const size_t countVertices = pSkeleton->CountVertices();
+        const uint16_t *pPosition0 = positions.data() + 3 * countVertices * frame0,
+                       *pPosition1 = positions.data() + 3 * countVertices * frame1;
+        size_t vertexIndex, i;
+        vec3 position;
+        for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+        {
+            for (i = 0; i < 3; i++)
+                position[i] = boundsMin[i]
+                    + boundsScale[i] * ((1.0f - s) * float(pPosition0[i]) + s * float(pPosition1[i]));
+
+            output(vertexIndex, position);
+
+            pPosition0 += 3;
+            pPosition1 += 3;
+        }
+    }
+
+    void MeshVertexAnimationCache::GetVerticesAt(const milliseconds ms, const float framesPerSecond,
+                                                 vec3 *positionsOut, vec3 *normalsOut) const
+    {
+        const size_t countVertices = pSkeleton->CountVertices();
+
+        // Interpolate between the frames around the given time.
+        size_t frame0, frame1;
+        float s;
+        GetFramesAt(ms, framesPerSecond, frame0, frame1, s);
+
+        DecodePositions(frame0, frame1, s, [positionsOut](const size_t vertexIndex, const vec3 &position)
+                                           {
+                                               positionsOut[vertexIndex] = position;
+                                           });
+
+        if (normalsOut == NULL || normals.empty())
+            return;
+
+        const int8_t *pNormal0 = normals.data() + 3 * countVertices * frame0,
+                     *pNormal1 = normals.data() + 3 * countVertices * frame1;
+        size_t vertexIndex, i;
+        vec3 normal;
+        for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+        {
+            for (i = 0; i < 3; i++)
+                normal[i] = (1.0f - s) * float(pNormal0[i]) + s * float(pNormal1[i]);
+
+            if (dot(normal, normal) > 0.0f)
+                normalsOut[vertexIndex] = normalize(normal);
+            else
+                normalsOut[vertexIndex] = vec3(0.0f);
+
+            pNormal0 += 3;
+            pNormal1 += 3;
+        }
+    }
+
+    MeshVertexAnimationCache *CreateMeshVertexAnimationCache(const MeshData *pMeshData, const MeshSkeleton *pSkeleton,
+                                                             const std::string_view animationID,
+                                                             const bool loop, const bool withNormals)
+    {
+        MeshTraceZone zone("CreateMeshVertexAnimationCache");
+
+        const size_t animationIndex = pSkeleton->GetAnimationIndex(animationID),
+                     countFrames = pSkeleton->GetAnimation(animationIndex)->length + 1,
+                     countVertices = pSkeleton->CountVertices();
+
+        std::vector<MeshBoneTransformation> pose(pSkeleton->CountBones());
+        std::vector<MeshBonePaletteEntry> palette(pSkeleton->CountBones());
+        std::vector<vec3> framePositions(countFrames * countVertices),
+                          frameNormals;
+
+        // Normals are calculated on a MeshState object, in the skinned position.
+        MeshState *pScratchState = NULL;
+        std::vector<MeshVertex *> scratchVertexPs;
+        if (withNormals)
+        {
+            pScratchState = DeriveMeshState(pMeshData);
+            for (size_t vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                scratchVertexPs.push_back(pScratchState->GetVertex(pSkeleton->GetVertex(vertexIndex)->GetID()));
+
+            frameNormals.resize(countFrames * countVertices);
+        }
+
+        size_t frame, vertexIndex, i;
+        vec3 boundsMin(std::numeric_limits<float>::max()),
+             boundsMax(-std::numeric_limits<float>::max());
+        try
+        {
+            for (frame = 0; frame < countFrames; frame++)
+            {
+                vec3 *positions = framePositions.data() + frame * countVertices;
+
+                GetSkeletonPoseAt(pSkeleton, animationIndex, float(frame), loop, pose.data());
+                GetBonePalette(pSkeleton, pose.data(), palette.data());
+                SkinVertices(pSkeleton, palette.data(), positions);
+
+                for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                {
+                    boundsMin = min(boundsMin, positions[vertexIndex]);
+                    boundsMax = max(boundsMax, positions[vertexIndex]);
+                }
+
+                if (!withNormals)
+                    continue;
+
+                for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                    scratchVertexPs[vertexIndex]->SetPosition(positions[vertexIndex]);
+
+                for (vertexIndex = 0; vertexIndex < countVertices; vertexIndex++)
+                {
+                    ConstSetIterable<MeshCorner> corners = scratchVertexPs[vertexIndex]->IterCorners();
+                    if (corners.begin() == corners.end())
+                        frameNormals[frame * countVertices + vertexIndex] = vec3(0.0f);  // no faces, no normal
+                    else
+                        frameNormals[frame * countVertices + vertexIndex] = CalculateVertexNormal(scratchVertexPs[vertexIndex]);
+                }
+            }
+        }
+        catch (...)
+        {
+            DestroyMeshState(pScratchState);
+
+            std::rethrow_exception(std::current_exception());
+        }
+        DestroyMeshState(pScratchState);
+
+        MeshVertexAnimationCache *pCache = new MeshVertexAnimationCache;
+        pCache->pSkeleton = pSkeleton;
+        pCache->animationIndex = animationIndex;
+        pCache->loop = loop;
+        pCache->countFrames = countFrames;
+        pCache->boundsMin = boundsMin;
+
+        const float maxStep = float(std::numeric_limits<uint16_t>::max());
+        for (i = 0; i < 3; i++)
+            pCache->boundsScale[i] = countVertices > 0 ? (boundsMax[i] - boundsMin[i]) / maxStep : 0.0f;
+
+        pCache->positions.resize(3 * framePositions.size());
+        for (vertexIndex = 0; vertexIndex < framePositions.size(); vertexIndex++)
+            for (i = 0; i < 3; i++)
+            {
+                if (pCache->boundsScale[i] > 0.0f)
+                    pCache->positions[3 * vertexIndex + i] = uint16_t(std::round((framePositions[vertexIndex][i] - boundsMin[i])
+                                                                                 / pCache->boundsScale[i]));
+                else
+                    pCache->positions[3 * vertexIndex + i] = 0;
+            }
+
+        pCache->normals.resize(3 * frameNormals.size());
+        for (vertexIndex = 0; vertexIndex < frameNormals.size(); vertexIndex++)
+            for (i = 0; i < 3; i++)
+                pCache->normals[3 * vertexIndex + i] = int8_t(std::round(frameNormals[vertexIndex][i] * 127.0f));
+
+        return pCache;
+    }
+
+    void DestroyMeshVertexAnimationCache(MeshVertexAnimationCache *pCache)
+    {
+        delete pCache;
+    }
+
+    void ApplyVertexAnimation(const MeshVertexAnimationCache *pCache, const milliseconds ms,
+                              const float framesPerSecond, MeshSkinningTable *pTable)
+    {
+        size_t frame0, frame1;
+        float s;
+        pCache->GetFramesAt(ms, framesPerSecond, frame0, frame1, s);
+
+        MeshVertex *const *destinations = pTable->destinationPs.data();
+        pCache->DecodePositions(frame0, frame1, s, [destinations](const size_t vertexIndex, const vec3 &position)
+                                                   {
+                                                       destinations[vertexIndex]->SetPosition(position);
+                                                   });
+    }
+}
@@ -0,0 +1,135 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "mesh.h"
+#include "frame.h"
+#include "cache.h"
+#include "synthetic.h"
+
+
+using namespace XMLMesh;
+
+/*
+ *  Counts every allocation in the program, so that the test can check
+ *  that steady state frame evaluation doesn't allocate.
+ */
+std::atomic<size_t> countAllocations(0);
+
+void *operator new(size_t size)
+{
+    countAllocations++;
+
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocations++;
+
+    return malloc(size > 0 ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(void)
+{
+    const size_t countFrames = 10000;
+
+    SyntheticMeshParams params;
+    params.countColumns = 16;
+    params.countRows = 8;
+    params.countBones = 8;
+    params.countAnimations = 3;
+    params.animationLength = 60;
+    params.countKeys = 7;
+    params.countExtraBones = 5;  // also covers the generic skinning loop
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+
+    MeshData *pMeshData = ParseMeshData(ss);
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData, true, true);
+
+    if (countAllocations == 0)
+    {
+        std::cerr << "the counting allocator isn't used by the library" << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+    for (const MeshSkinningMode mode : {MESHSKIN_LINEAR, MESHSKIN_DUAL_QUATERNION})
+    {
+        MeshFrameEvaluator *pEvaluator = CreateMeshFrameEvaluator(pSkeleton, mode);
+        std::vector<MeshBufferVertex> vertices(pEvaluator->CountBufferVertices());
+        std::vector<MeshBufferIndex> indices(pEvaluator->CountBufferIndices());
+        GetBufferIndices(pEvaluator, indices.data());
+
+        // Warm up.
+        EvaluateFrame(pEvaluator, 0, 0, 25.0f, true, vertices.data());
+
+        const size_t countBefore = countAllocations;
+        size_t i;
+        for (i = 0; i < countFrames; i++)
+            EvaluateFrame(pEvaluator, i % pSkeleton->CountAnimations(), i * 13, 25.0f, i % 2 == 0, vertices.data());
+        const size_t countDuring = countAllocations - countBefore;
+
+        std::cout << countFrames << " frames, mode " << mode << ": " << countDuring << " allocations" << std::endl;
+        if (countDuring > 0)
+            result = 1;
+
+        DestroyMeshFrameEvaluator(pEvaluator);
+    }
+
+    // Playing a vertex cache back into a MeshState goes through a table that's compiled once.
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+    MeshSkinningTable *pTable = CompileMeshSkinningTable(pSkeleton, pMeshState);
+    MeshVertexAnimationCache *pCache = CreateMeshVertexAnimationCache(pMeshData, pSkeleton,
+                                                                      pSkeleton->GetAnimation(0)->id, true, false);
+    {
+        const size_t countBefore = countAllocations;
+        size_t i;
+        for (i = 0; i < countFrames; i++)
+            ApplyVertexAnimation(pCache, i * 13, 25.0f, pTable);
+        const size_t countDuring = countAllocations - countBefore;
+
+        std::cout << countFrames << " frames played back: " << countDuring << " allocations" << std::endl;
+        if (countDuring > 0)
+            result = 1;
+    }
+    DestroyMeshVertexAnimationCache(pCache);
+    DestroyMeshSkinningTable(pTable);
+    DestroyMeshState(pMeshState);
+
+    DestroyMeshSkeleton(pSkeleton);
+    DestroyMeshData(pMeshData);
+
+    return result;
+}
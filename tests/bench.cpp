@@ -0,0 +1,185 @@
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+
+#include "benchmark.h"
+#include "trace.h"
+#include "stats.h"
+
+
+/*
+ *  Usage: bench [--columns n] [--rows n] [--bones n] [--depth n] [--animations n]
+ *               [--length n] [--keys n] [--trials n] [--frames n] [--trace file] [--stats] [--emit]
+ *
+ *  Times the library's stages on a generated mesh and writes the results as JSON.
+ *  With --emit, it writes the generated mesh's XML instead.
+ *  With --trace, the library's zones are also written to the given file as Chrome trace JSON.
+ *  With --stats, the library's work counters are added to the results.
+ *
+ *  The parse times are also given per xml element and in bytes per second, to compare parsers
+ *  on meshes of any size. "parse" uses the library's own scanner on all cores, "parse_1_thread"
+ *  on the calling thread only and "parse_libxml2" doesn't use it.
+ */
+int main(int argc, char **argv)
+{
+    SyntheticMeshParams params;
+    params.countColumns = 32;
+    params.countRows = 32;
+    params.countBones = 16;
+    params.countAnimations = 2;
+    params.animationLength = 100;
+    params.countKeys = 10;
+    params.countExtraBones = 2;
+
+    size_t countTrials = 5,
+           countFrames = 100;
+    bool emit = false,
+         stats = false;
+    const char *tracePath = NULL;
+
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--emit") == 0)
+        {
+            emit = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = true;
+            continue;
+        }
+        else if (i + 1 >= argc)
+        {
+            std::cerr << "missing value for " << argv[i] << std::endl;
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--trace") == 0)
+        {
+            tracePath = argv[i + 1];
+            i++;
+            continue;
+        }
+
+        const size_t value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--columns") == 0)
+            params.countColumns = value;
+        else if (strcmp(argv[i], "--rows") == 0)
+            params.countRows = value;
+        else if (strcmp(argv[i], "--bones") == 0)
+            params.countBones = value;
+        else if (strcmp(argv[i], "--depth") == 0)
+            params.hierarchyDepth = value;
+        else if (strcmp(argv[i], "--animations") == 0)
+            params.countAnimations = value;
+        else if (strcmp(argv[i], "--length") == 0)
+            params.animationLength = value;
+        else if (strcmp(argv[i], "--keys") == 0)
+            params.countKeys = value;
+        else if (strcmp(argv[i], "--trials") == 0)
+            countTrials = value;
+        else if (strcmp(argv[i], "--frames") == 0)
+            countFrames = value;
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+        i++;
+    }
+
+    if (emit)
+    {
+        WriteSyntheticMesh(std::cout, params);
+        return 0;
+    }
+
+    XMLMesh::EnableMeshTracing(tracePath != NULL);
+    XMLMesh::EnableMeshStatistics(stats);
+
+    const BenchmarkTimings timings = RunBenchmark(params, countTrials, countFrames);
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+    const std::string xml = ss.str();
+    size_t countElements = 0, position;
+    for (position = 1; position < xml.size(); position++)
+    {
+        if (xml[position - 1] == '<' && isalpha(xml[position]))
+            countElements++;
+    }
+
+    if (tracePath != NULL)
+    {
+        std::ofstream traceFile(tracePath);
+        XMLMesh::WriteMeshTrace(traceFile);
+        if (!traceFile.good())
+        {
+            std::cerr << "cannot write " << tracePath << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "{" << std::endl
+              << "  \"mesh\": {\"vertices\": " << (params.countColumns + 1) * (params.countRows + 1)
+              << ", \"faces\": " << params.countColumns * params.countRows
+              << ", \"bones\": " << params.countBones
+              << ", \"depth\": " << (params.hierarchyDepth > 0 ? params.hierarchyDepth : params.countBones)
+              << ", \"animations\": " << params.countAnimations
+              << ", \"length\": " << params.animationLength
+              << ", \"keys\": " << params.countKeys
+              << ", \"elements\": " << countElements
+              << ", \"bytes\": " << xml.size() << "}," << std::endl
+              << "  \"trials\": " << countTrials << "," << std::endl
+              << "  \"frames\": " << countFrames << "," << std::endl
+              << "  \"seconds\": {" << std::endl;
+
+    size_t stageNumber = 0;
+    for (const auto &stageTimings : timings)
+    {
+        const std::vector<double> &seconds = std::get<1>(stageTimings);
+
+        std::cout << "    \"" << std::get<0>(stageTimings) << "\": {\"median\": " << GetMedian(seconds)
+                  << ", \"mean\": " << GetMean(seconds)
+                  << ", \"min\": " << *std::min_element(seconds.begin(), seconds.end()) << "}";
+        if (++stageNumber < timings.size())
+            std::cout << ",";
+        std::cout << std::endl;
+    }
+    const char *parseStages[] = {"parse", "parse_1_thread", "parse_libxml2"};
+    std::cout << "  }," << std::endl << "  \"nanosecondsPerElement\": {";
+    for (const char *stage : parseStages)
+        std::cout << (stage == parseStages[0] ? "" : ", ") << "\"" << stage << "\": "
+                  << GetMedian(timings.at(stage)) * 1.0e9 / countElements;
+    std::cout << "}," << std::endl << "  \"gigabytesPerSecond\": {";
+    for (const char *stage : parseStages)
+        std::cout << (stage == parseStages[0] ? "" : ", ") << "\"" << stage << "\": "
+                  << xml.size() / GetMedian(timings.at(stage)) / 1.0e9;
+    std::cout << "}";
+
+    if (stats)
+    {
+        const XMLMesh::MeshStatistics statistics = XMLMesh::GetMeshStatistics();
+
+        std::cout << "," << std::endl
+                  << "  \"statistics\": {\"keysScanned\": " << statistics.countKeysScanned
+                  << ", \"exactKeys\": " << statistics.countExactKeys
+                  << ", \"interpolations\": " << statistics.countInterpolations
+                  << ", \"bonesEvaluated\": " << statistics.countBonesEvaluated
+                  << ", \"parentSteps\": " << statistics.countParentSteps
+                  << ", \"verticesSkinned\": " << statistics.countVerticesSkinned
+                  << ", \"normalsComputed\": " << statistics.countNormalsComputed
+                  << ", \"bufferBytes\": " << statistics.countBufferBytes << "}";
+    }
+
+    std::cout << std::endl
+              << "}" << std::endl;
+
+    return 0;
+}
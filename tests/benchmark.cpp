@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include "mesh.h"
+#include "frame.h"
+#include "benchmark.h"
+
+
+using namespace XMLMesh;
+
+typedef std::chrono::steady_clock Clock;
+
+
+double SecondsSince(const Clock::time_point &start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double GetMedian(std::vector<double> values)
+{
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+
+    const size_t middle = values.size() / 2;
+    if (values.size() % 2 == 0)
+        return (values[middle - 1] + values[middle]) / 2;
+    else
+        return values[middle];
+}
+
+double GetMean(const std::vector<double> &values)
+{
+    if (values.empty())
+        return 0.0;
+
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+/**
+ * Like the visual test's MeshRenderer::UpdateBuffer.
+ */
+void FillBuffer(const MeshState *pMeshState, MeshBufferVertex *verticesOut)
+{
+    size_t vertexNumber = 0;
+    vec3 faceNormal;
+    for (const MeshFace *pFace : pMeshState->IterFaces())
+    {
+        if (!pFace->IsSmooth())
+            faceNormal = CalculateFaceNormal(pFace);
+
+        for (const MeshCorner &corner : pFace->IterCorners())
+        {
+            verticesOut[vertexNumber].position = corner.GetVertex()->GetPosition();
+            verticesOut[vertexNumber].texCoords = corner.GetTexCoords();
+
+            if (pFace->IsSmooth())
+                verticesOut[vertexNumber].normal = CalculateVertexNormal(corner.GetVertex());
+            else
+                verticesOut[vertexNumber].normal = faceNormal;
+
+            vertexNumber++;
+        }
+    }
+}
+
+BenchmarkTimings RunBenchmark(const SyntheticMeshParams &params, const size_t countTrials, const size_t countFrames)
+{
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+    const std::string xml = ss.str();
+
+    const bool animated = params.countBones > 0 && params.countAnimations > 0;
+
+    BenchmarkTimings timings;
+    Clock::time_point start;
+    size_t trial, frame;
+    for (trial = 0; trial < countTrials; trial++)
+    {
+        std::istringstream is(xml);
+        start = Clock::now();
+        MeshData *pMeshData = ParseMeshData(is);
+        timings["parse"].push_back(SecondsSince(start));
+
+        std::istringstream isSerial(xml);
+        start = Clock::now();
+        MeshData *pSerialMeshData = ParseMeshData(isSerial, std::pmr::get_default_resource(), true, 1);
+        timings["parse_1_thread"].push_back(SecondsSince(start));
+        DestroyMeshData(pSerialMeshData);
+
+        std::istringstream isLibXML(xml);
+        start = Clock::now();
+        MeshData *pLibXMLMeshData = ParseMeshData(isLibXML, std::pmr::get_default_resource(), false);
+        timings["parse_libxml2"].push_back(SecondsSince(start));
+        DestroyMeshData(pLibXMLMeshData);
+
+        start = Clock::now();
+        MeshState *pMeshState = DeriveMeshState(pMeshData);
+        timings["derive"].push_back(SecondsSince(start));
+
+        std::vector<std::unordered_map<std::string, MeshBoneTransformation>> poses(countFrames);
+        if (animated)
+        {
+            start = Clock::now();
+            for (frame = 0; frame < countFrames; frame++)
+                GetBoneTransformationsAt(pMeshData, "anim" + std::to_string(frame % params.countAnimations),
+                                         frame * 40, 25.0f, true, poses[frame]);
+            timings["pose"].push_back(SecondsSince(start) / countFrames);
+
+            // The first call compiles a skinning table.
+            ApplyBoneTransformations(pMeshData, poses[0], pMeshState);
+            start = Clock::now();
+            for (frame = 0; frame < countFrames; frame++)
+                ApplyBoneTransformations(pMeshData, poses[frame], pMeshState);
+            timings["skin"].push_back(SecondsSince(start) / countFrames);
+        }
+
+        std::vector<vec3> normals((params.countColumns + 1) * (params.countRows + 1));
+        size_t vertexIndex;
+        start = Clock::now();
+        for (frame = 0; frame < countFrames; frame++)
+        {
+            vertexIndex = 0;
+            for (const MeshVertex *pVertex : pMeshState->IterVertices())
+                normals[vertexIndex++] = CalculateVertexNormal(pVertex);
+        }
+        timings["normals"].push_back(SecondsSince(start) / countFrames);
+
+        MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData, true, true);
+        MeshFrameEvaluator *pEvaluator = CreateMeshFrameEvaluator(pSkeleton);
+        std::vector<MeshBufferVertex> vertices(pEvaluator->CountBufferVertices());
+
+        start = Clock::now();
+        for (frame = 0; frame < countFrames; frame++)
+            FillBuffer(pMeshState, vertices.data());
+        timings["buffer"].push_back(SecondsSince(start) / countFrames);
+
+        if (animated)
+        {
+            start = Clock::now();
+            for (frame = 0; frame < countFrames; frame++)
+                EvaluateFrame(pEvaluator, frame % params.countAnimations, frame * 40, 25.0f, true, vertices.data());
+            timings["frame"].push_back(SecondsSince(start) / countFrames);
+        }
+
+        DestroyMeshFrameEvaluator(pEvaluator);
+        DestroyMeshSkeleton(pSkeleton);
+        DestroyMeshState(pMeshState);
+        DestroyMeshData(pMeshData);
+    }
+
+    return timings;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "synthetic.h"
+
+
+/**
+ * Seconds per call of each stage, one entry per trial.
+ *
+ * Stages: parse, parse_1_thread (scanning on the calling thread only), parse_libxml2,
+ * derive, pose (GetBoneTransformationsAt), skin (ApplyBoneTransformations),
+ * normals (CalculateVertexNormal for every vertex), buffer (filling a vertex buffer like
+ * the visual test does) and frame (EvaluateFrame).
+ */
+typedef std::map<std::string, std::vector<double>> BenchmarkTimings;
+
+/**
+ * Generates a mesh from the parameters and times every stage on it, 'countTrials' times.
+ * The per frame stages are averaged over 'countFrames' frames per trial.
+ */
+BenchmarkTimings RunBenchmark(const SyntheticMeshParams &, const size_t countTrials, const size_t countFrames);
+
+double GetMedian(std::vector<double>);
+double GetMean(const std::vector<double> &);
+
+#endif  // BENCHMARK_H
@@ -0,0 +1,195 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "crowd.h"
+#include "cache.h"
+#include "skin.h"
+#include "synthetic.h"
+
+
+using namespace XMLMesh;
+
+typedef std::chrono::steady_clock Clock;
+
+
+double SecondsSince(const Clock::time_point &start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void Report(const char *name, const size_t countInstances, const size_t repeats, const double seconds)
+{
+    std::cout << name << ": " << (double(countInstances * repeats) / seconds) << " instances/second" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t countInstances = argc > 1 ? atoi(argv[1]) : 5000,
+                 countThreads = argc > 2 ? atoi(argv[2]) : 0,
+                 repeats = 10;
+
+    SyntheticMeshParams params;
+    params.countColumns = 32;
+    params.countRows = 16;
+    params.countBones = 16;
+    params.countAnimations = 4;
+    params.animationLength = 100;
+    params.countKeys = 10;
+    params.countExtraBones = 2;
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+
+    MeshData *pMeshData = ParseMeshData(ss);
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData);
+
+    std::vector<MeshInstance> instances(countInstances);
+    std::vector<std::string> animationIDs(countInstances);
+    size_t i, r;
+    for (i = 0; i < countInstances; i++)
+    {
+        instances[i].animationIndex = i % pSkeleton->CountAnimations();
+        instances[i].msSinceStart = (i * 7919) % 10000;
+        instances[i].loop = true;
+        animationIDs[i] = pSkeleton->GetAnimation(instances[i].animationIndex)->id;
+    }
+
+    std::cout << countInstances << " instances, " << pSkeleton->CountVertices() << " vertices, "
+              << pSkeleton->CountBones() << " bones" << std::endl;
+
+    // One instance at a time, through the string keyed functions.
+    std::unordered_map<std::string, MeshBoneTransformation> transformations;
+    Clock::time_point start = Clock::now();
+    for (i = 0; i < countInstances; i++)
+    {
+        GetBoneTransformationsAt(pMeshData, animationIDs[i], instances[i].msSinceStart, 25.0f, true,
+                                 transformations);
+        ApplyBoneTransformations(pMeshData, transformations, pMeshState);
+    }
+    Report("one by one", countInstances, 1, SecondsSince(start));
+
+    std::vector<MeshBonePaletteEntry> palettes(countInstances * pSkeleton->CountBones());
+    start = Clock::now();
+    for (r = 0; r < repeats; r++)
+        GetInstanceBonePalettes(pSkeleton, instances.data(), countInstances, 25.0f, palettes.data(), countThreads);
+    Report("batched palettes", countInstances, repeats, SecondsSince(start));
+
+    std::vector<vec3> positions(countInstances * pSkeleton->CountVertices());
+    start = Clock::now();
+    for (r = 0; r < repeats; r++)
+        SkinInstances(pSkeleton, instances.data(), countInstances, 25.0f, positions.data(), countThreads);
+    const double secondsLinear = SecondsSince(start);
+    Report("batched skinning", countInstances, repeats, secondsLinear);
+
+    start = Clock::now();
+    for (r = 0; r < repeats; r++)
+        SkinInstances(pSkeleton, instances.data(), countInstances, 25.0f, positions.data(), countThreads,
+                      MESHSKIN_DUAL_QUATERNION);
+    const double secondsDualQuaternion = SecondsSince(start);
+    Report("batched skinning, dual quaternion", countInstances, repeats, secondsDualQuaternion);
+    std::cout << "dual quaternion cost relative to linear: " << (secondsDualQuaternion / secondsLinear) << std::endl;
+
+    // One instance at a time, sharing poses through a cache.
+    MeshPoseCache *pPoseCache = CreateMeshPoseCache(pSkeleton, 1.0f, 1 << 20);
+    std::vector<MeshBoneTransformation> pose(pSkeleton->CountBones());
+    start = Clock::now();
+    for (r = 0; r < repeats; r++)
+        for (i = 0; i < countInstances; i++)
+        {
+            pPoseCache->GetPoseAt(instances[i].animationIndex,
+                                  GetAnimationFrame(pSkeleton, instances[i].animationIndex,
+                                                    instances[i].msSinceStart, 25.0f, true),
+                                  true, pose.data());
+            GetBonePalette(pSkeleton, pose.data(), palettes.data());
+            SkinVertices(pSkeleton, palettes.data(), positions.data());
+        }
+    Report("pose cache", countInstances, repeats, SecondsSince(start));
+    std::cout << "pose cache hits: " << pPoseCache->CountHits() << ", misses: " << pPoseCache->CountMisses()
+              << ", bytes: " << pPoseCache->GetUsedBytes() << std::endl;
+    DestroyMeshPoseCache(pPoseCache);
+
+    // One instance at a time, from precomputed frames.
+    std::vector<MeshVertexAnimationCache *> vertexCaches;
+    size_t vertexCacheBytes = 0;
+    for (i = 0; i < pSkeleton->CountAnimations(); i++)
+    {
+        vertexCaches.push_back(CreateMeshVertexAnimationCache(pMeshData, pSkeleton, pSkeleton->GetAnimation(i)->id,
+                                                              true, true));
+        vertexCacheBytes += vertexCaches.back()->GetMemoryUsage();
+    }
+    std::vector<vec3> normals(pSkeleton->CountVertices());
+    start = Clock::now();
+    for (r = 0; r < repeats; r++)
+        for (i = 0; i < countInstances; i++)
+            vertexCaches[instances[i].animationIndex]->GetVerticesAt(instances[i].msSinceStart, 25.0f,
+                                                                     positions.data(), normals.data());
+    Report("vertex animation cache", countInstances, repeats, SecondsSince(start));
+    std::cout << "vertex animation cache bytes: " << vertexCacheBytes << std::endl;
+    for (MeshVertexAnimationCache *pVertexCache : vertexCaches)
+        DestroyMeshVertexAnimationCache(pVertexCache);
+
+    // One mesh, where only the last two bones move.
+    MeshIncrementalSkinner *pSkinner = CreateMeshIncrementalSkinner(pSkeleton, pMeshState);
+    GetSkeletonPoseAt(pSkeleton, 0, 0.0f, true, pose.data());
+    start = Clock::now();
+    for (i = 0; i < countInstances; i++)
+    {
+        pose[pSkeleton->CountBones() - 1].rotation = angleAxis(0.001f * i, vec3(0.0f, 0.0f, 1.0f));
+        pose[pSkeleton->CountBones() - 2].translation = vec3(0.001f * i, 0.0f, 0.0f);
+        pSkinner->Update(pose.data());
+    }
+    Report("incremental skinning", countInstances, 1, SecondsSince(start));
+    std::cout << "incremental skinning vertices per update: "
+              << (pSkinner->GetStatistics().totalSkinnedVertices / pSkinner->GetStatistics().countUpdates)
+              << std::endl;
+    DestroyMeshIncrementalSkinner(pSkinner);
+
+    // One mesh with normals and tangents, rotated along or recalculated from the faces.
+    MeshSkeleton *pNormalSkeleton = CompileMeshSkeleton(pMeshData, true, true);
+    std::vector<vec3> tangents(pSkeleton->CountVertices());
+    start = Clock::now();
+    for (i = 0; i < countInstances; i++)
+    {
+        GetSkeletonPoseAt(pNormalSkeleton, instances[i].animationIndex,
+                          GetAnimationFrame(pNormalSkeleton, instances[i].animationIndex,
+                                            instances[i].msSinceStart, 25.0f, true),
+                          true, pose.data());
+        GetBonePalette(pNormalSkeleton, pose.data(), palettes.data());
+        SkinVertices(pNormalSkeleton, palettes.data(), positions.data(), normals.data(), tangents.data());
+    }
+    Report("skinned normals", countInstances, 1, SecondsSince(start));
+
+    MeshSkinningTable *pTable = CompileMeshSkinningTable(pNormalSkeleton, pMeshState);
+    start = Clock::now();
+    for (i = 0; i < countInstances; i++)
+    {
+        GetSkeletonPoseAt(pNormalSkeleton, instances[i].animationIndex,
+                          GetAnimationFrame(pNormalSkeleton, instances[i].animationIndex,
+                                            instances[i].msSinceStart, 25.0f, true),
+                          true, pose.data());
+        ApplyBoneTransformations(pTable, pose.data());
+
+        size_t vertexIndex = 0;
+        for (const MeshVertex *pVertex : pMeshState->IterVertices())
+        {
+            normals[vertexIndex] = CalculateVertexNormal(pVertex);
+            tangents[vertexIndex] = std::get<0>(CalculateVertexTangentBitangent(pVertex));
+            vertexIndex++;
+        }
+    }
+    Report("recalculated normals", countInstances, 1, SecondsSince(start));
+    DestroyMeshSkinningTable(pTable);
+    DestroyMeshSkeleton(pNormalSkeleton);
+
+    DestroyMeshSkeleton(pSkeleton);
+    DestroyMeshState(pMeshState);
+    DestroyMeshData(pMeshData);
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "trace.h"
+#include "synthetic.h"
+
+
+using namespace XMLMesh;
+
+/*
+ *  Checks that the scanner, on one thread or on several, builds the same mesh
+ *  as libxml2 does, or throws the same error.
+ */
+
+/*
+ *  One line per object, sorted, so that the order in which the parsers
+ *  build the objects doesn't matter.
+ */
+std::string DescribeMeshData(const MeshData *pMeshData)
+{
+    std::vector<std::string> lines;
+
+    for (const MeshVertex *pVertex : pMeshData->IterVertices())
+    {
+        ConstSetIterable<MeshCorner> corners = pVertex->IterCorners();
+        size_t countCorners = 0;
+        for (ConstSetIterator<MeshCorner> it = corners.begin(); it != corners.end(); ++it)
+            countCorners++;
+
+        std::ostringstream line;
+        line << std::setprecision(9) << "vertex " << pVertex->GetID() << " at " << pVertex->GetPosition().x
+             << " " << pVertex->GetPosition().y << " " << pVertex->GetPosition().z << ", corners " << countCorners;
+
+        std::vector<std::string> boneIDs;
+        for (const MeshBone *pBone : pVertex->IterBones())
+            boneIDs.push_back(pBone->GetID());
+        std::sort(boneIDs.begin(), boneIDs.end());
+        for (const std::string &boneID : boneIDs)
+            line << ", bone " << boneID;
+
+        lines.push_back(line.str());
+    }
+
+    for (const MeshFace *pFace : pMeshData->IterFaces())
+    {
+        std::ostringstream line;
+        line << std::setprecision(9) << "face " << pFace->GetID() << (pFace->IsSmooth() ? " smooth" : " flat");
+        for (const MeshCorner &corner : pFace->IterCorners())
+            line << ", " << corner.GetVertex()->GetID() << " at " << corner.GetTexCoords().x
+                 << " " << corner.GetTexCoords().y << " after " << corner.GetPrev()->GetVertex()->GetID();
+
+        lines.push_back(line.str());
+    }
+
+    for (const MeshSubset *pSubset : pMeshData->IterSubsets())
+    {
+        std::vector<std::string> faceIDs;
+        for (const MeshFace *pFace : pSubset->IterFaces())
+            faceIDs.push_back(pFace->GetID());
+        std::sort(faceIDs.begin(), faceIDs.end());
+
+        std::ostringstream line;
+        line << "subset " << pSubset->GetID();
+        for (const std::string &faceID : faceIDs)
+            line << ", face " << faceID;
+
+        lines.push_back(line.str());
+    }
+
+    for (const MeshBone *pBone : pMeshData->IterBones())
+    {
+        std::vector<std::string> vertexIDs;
+        for (const MeshVertex *pVertex : pBone->IterVertices())
+            vertexIDs.push_back(pVertex->GetID());
+        std::sort(vertexIDs.begin(), vertexIDs.end());
+
+        std::ostringstream line;
+        line << std::setprecision(9) << "bone " << pBone->GetID()
+             << " child of " << (pBone->HasParent() ? pBone->GetParent()->GetID() : "nothing")
+             << " at " << pBone->GetHeadPosition().x << " " << pBone->GetHeadPosition().y
+             << " " << pBone->GetHeadPosition().z << ", weight " << pBone->GetWeight();
+        for (const std::string &vertexID : vertexIDs)
+            line << ", vertex " << vertexID;
+
+        lines.push_back(line.str());
+    }
+
+    for (const MeshSkeletalAnimation *pAnimation : pMeshData->IterAnimations())
+    {
+        std::ostringstream line;
+        line << "animation " << pAnimation->id << " of " << pAnimation->length << " frames";
+        lines.push_back(line.str());
+
+        for (const auto &layerPair : pAnimation->mLayers)
+        {
+            const MeshBoneLayer &layer = std::get<1>(layerPair);
+            for (const auto &keyPair : layer.mKeys)
+            {
+                const MeshBoneKey &key = std::get<1>(keyPair);
+                const MeshBoneTransformation &t = key.transformation;
+
+                std::ostringstream line;
+                line << std::setprecision(9) << "animation " << pAnimation->id << " bone " << layer.pBone->GetID()
+                     << " frame " << key.frame << " moves " << t.translation.x << " " << t.translation.y
+                     << " " << t.translation.z << " turns " << t.rotation.x << " " << t.rotation.y
+                     << " " << t.rotation.z << " " << t.rotation.w;
+                lines.push_back(line.str());
+            }
+        }
+    }
+
+    std::sort(lines.begin(), lines.end());
+
+    std::ostringstream description;
+    for (const std::string &line : lines)
+        description << line << std::endl;
+
+    return description.str();
+}
+
+std::string DescribeParse(const std::string &xml, const bool useScanner, const size_t countThreads)
+{
+    std::istringstream is(xml);
+    try
+    {
+        MeshData *pMeshData = ParseMeshData(is, std::pmr::get_default_resource(), useScanner, countThreads);
+        const std::string description = DescribeMeshData(pMeshData);
+        DestroyMeshData(pMeshData);
+
+        return description;
+    }
+    catch (const MeshError &e)
+    {
+        return std::string("error: ") + e.what() + "\n";
+    }
+}
+
+/*
+ *  Prints the first line that differs from what libxml2 gave.
+ */
+bool CheckParsers(const std::string &what, const std::string &xml)
+{
+    const std::string expected = DescribeParse(xml, false, 1);
+
+    bool success = true;
+    for (const size_t countThreads : {1, 4})
+    {
+        const std::string actual = DescribeParse(xml, true, countThreads);
+        if (actual == expected)
+            continue;
+
+        std::istringstream isExpected(expected), isActual(actual);
+        std::string expectedLine, actualLine;
+        while (std::getline(isExpected, expectedLine) && std::getline(isActual, actualLine)
+                && expectedLine == actualLine)
+        {
+        }
+
+        std::cerr << what << ", scanned on " << countThreads << " threads, has \"" << actualLine
+                  << "\" where libxml2 has \"" << expectedLine << "\"" << std::endl;
+        success = false;
+    }
+
+    std::cout << what << ": " << (expected.compare(0, 6, "error:") == 0 ? expected : "parsed alike\n");
+
+    return success;
+}
+
+const char *childBeforeParentXML = R"(<mesh>
+<vertices>
+<vertex id="0"><pos x="0.0" y="0.0" z="0.0"/></vertex>
+<vertex id="1"><pos x="1.0" y="0.0" z="0.0"/></vertex>
+<vertex id="2"><pos x="1.0" y="1.0" z="0.0"/></vertex>
+<vertex id="3"><pos x="0.0" y="1.0" z="0.0"/></vertex>
+</vertices>
+<faces>
+<quad id="0" smooth="false"><corner vertex_id="0" tex_u="0" tex_v="0"/><corner vertex_id="1" tex_u="1" tex_v="0"/><corner vertex_id="2" tex_u="1" tex_v="1"/><corner vertex_id="3" tex_u="0" tex_v="1"/></quad>
+</faces>
+<subsets><subset id="all"><faces><quad id="0"/></faces></subset></subsets>
+<armature>
+<bones>
+<bone id="tip" x="0.0" y="1.0" z="0.0" weight="0.5" parent_id="root"><vertices><vertex id="2"/><vertex id="3"/></vertices></bone>
+<bone id="root" x="0.0" y="0.0" z="0.0" weight="1.0"><vertices><vertex id="0"/><vertex id="1"/><vertex id="2"/></vertices></bone>
+</bones>
+<animations>
+<animation id="bend" length="10">
+<layer bone_id="tip"><key frame="0" x="0.0" y="0.0" z="0.0" rot_x="0.0" rot_y="0.0" rot_z="0.0" rot_w="1.0"/><key frame="10" x="0.25" y="0.0" z="0.0" rot_x="0.0" rot_y="0.0" rot_z="0.3826834" rot_w="0.9238795"/></layer>
+</animation>
+</animations>
+</armature>
+</mesh>
+)";
+
+const char *mixedFacesXML = R"(<mesh>
+<vertices>
+<vertex id="0"><pos x="0.0" y="0.0" z="0.0"/></vertex>
+<vertex id="1"><pos x="1.0" y="0.0" z="0.0"/></vertex>
+<vertex id="2"><pos x="1.0" y="1.0" z="0.0"/></vertex>
+<vertex id="3"><pos x="0.0" y="1.0" z="0.0"/></vertex>
+<vertex id="4"><pos x="2.0" y="0.5" z="0.0"/></vertex>
+<vertex id="5"><pos x="-1.0" y="0.5" z="0.125"/></vertex>
+</vertices>
+<faces>
+<triangle id="t0" smooth="true"><corner vertex_id="1" tex_u="0" tex_v="0"/><corner vertex_id="4" tex_u="1" tex_v="0.5"/><corner vertex_id="2" tex_u="0" tex_v="1"/></triangle>
+<quad id="q0" smooth="true"><corner vertex_id="0" tex_u="0" tex_v="0"/><corner vertex_id="1" tex_u="1" tex_v="0"/><corner vertex_id="2" tex_u="1" tex_v="1"/><corner vertex_id="3" tex_u="0" tex_v="1"/></quad>
+<triangle id="t1" smooth="false"><corner vertex_id="0" tex_u="1" tex_v="0"/><corner vertex_id="3" tex_u="1" tex_v="1"/><corner vertex_id="5" tex_u="0" tex_v="0.5"/></triangle>
+</faces>
+<subsets>
+<subset id="sides"><faces><triangle id="t1"/><triangle id="t0"/></faces></subset>
+<subset id="middle"><faces><quad id="q0"/></faces></subset>
+</subsets>
+</mesh>
+)";
+
+const char *sectionsOutOfOrderXML = R"(<mesh>
+<armature>
+<animations>
+<animation id="wave" length="4">
+<layer bone_id="arm"><key frame="2" x="0.0" y="0.5" z="0.0" rot_x="0.0" rot_y="0.0" rot_z="0.0" rot_w="1.0"/></layer>
+</animation>
+</animations>
+<bones>
+<bone id="arm" x="0.5" y="0.0" z="0.0" weight="1.0"><vertices><vertex id="1"/><vertex id="2"/></vertices></bone>
+</bones>
+</armature>
+<subsets><subset id="all"><faces><triangle id="0"/></faces></subset></subsets>
+<faces>
+<triangle id="0" smooth="true"><corner vertex_id="0" tex_u="0" tex_v="0"/><corner vertex_id="1" tex_u="1" tex_v="0"/><corner vertex_id="2" tex_u="0" tex_v="1"/></triangle>
+</faces>
+<vertices>
+<vertex id="0"><pos x="0.0" y="0.0" z="0.0"/></vertex>
+<vertex id="1"><pos x="1.0" y="0.0" z="0.0"/></vertex>
+<vertex id="2"><pos x="0.0" y="1.0" z="0.0"/></vertex>
+</vertices>
+</mesh>
+)";
+
+// "01" isn't the same vertex as "1".
+const char *paddedIDsXML = R"(<mesh>
+<vertices>
+<vertex id="1"><pos x="0.0" y="0.0" z="0.0"/></vertex>
+<vertex id="01"><pos x="1.0" y="0.0" z="0.0"/></vertex>
+<vertex id="2"><pos x="1.0" y="1.0" z="0.0"/></vertex>
+<vertex id="002"><pos x="0.0" y="1.0" z="0.0"/></vertex>
+</vertices>
+<faces>
+<quad id="07" smooth="true"><corner vertex_id="1" tex_u="0" tex_v="0"/><corner vertex_id="01" tex_u="1" tex_v="0"/><corner vertex_id="2" tex_u="1" tex_v="1"/><corner vertex_id="002" tex_u="0" tex_v="1"/></quad>
+</faces>
+<subsets><subset id="0"><faces><quad id="07"/></faces></subset></subsets>
+</mesh>
+)";
+
+const char *negativeLengthXML = R"(<mesh>
+<vertices>
+<vertex id="0"><pos x="0.0" y="0.0" z="0.0"/></vertex>
+<vertex id="1"><pos x="1.0" y="0.0" z="0.0"/></vertex>
+<vertex id="2"><pos x="0.0" y="1.0" z="0.0"/></vertex>
+</vertices>
+<faces>
+<triangle id="0" smooth="true"><corner vertex_id="0" tex_u="0" tex_v="0"/><corner vertex_id="1" tex_u="1" tex_v="0"/><corner vertex_id="2" tex_u="0" tex_v="1"/></triangle>
+</faces>
+<subsets><subset id="all"><faces><triangle id="0"/></faces></subset></subsets>
+<armature>
+<bones><bone id="arm" x="0.0" y="0.0" z="0.0" weight="1.0"><vertices><vertex id="0"/></vertices></bone></bones>
+<animations><animation id="backwards" length="-5"></animation></animations>
+</armature>
+</mesh>
+)";
+
+int main(void)
+{
+    // Large enough for the scanner to cut its sections into chunks for the threads.
+    SyntheticMeshParams params;
+    params.countColumns = 64;
+    params.countRows = 64;
+    params.countBones = 32;
+    params.countAnimations = 3;
+    params.animationLength = 60;
+    params.countKeys = 7;
+    params.countExtraBones = 2;
+    params.hierarchyDepth = 8;
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+
+    int result = 0;
+
+    EnableMeshTracing(true);
+    if (!CheckParsers("the synthetic mesh", ss.str()))
+        result = 1;
+    EnableMeshTracing(false);
+
+    std::ostringstream trace;
+    WriteMeshTrace(trace);
+    if (trace.str().find("\"scan chunk\"") == std::string::npos)
+    {
+        std::cerr << "the synthetic mesh wasn't scanned on multiple threads" << std::endl;
+        result = 1;
+    }
+
+    if (!CheckParsers("a child bone before its parent", childBeforeParentXML))
+        result = 1;
+    if (!CheckParsers("quads and triangles interleaved", mixedFacesXML))
+        result = 1;
+    if (!CheckParsers("sections out of order", sectionsOutOfOrderXML))
+        result = 1;
+    if (!CheckParsers("numeric ids with leading zeros", paddedIDsXML))
+        result = 1;
+    if (!CheckParsers("a negative animation length", negativeLengthXML))
+        result = 1;
+
+    std::cout << (result == 0 ? "parsing checks passed" : "parsing checks failed") << std::endl;
+
+    return result;
+}
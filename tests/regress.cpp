@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+
+
+/*
+ *  Usage: regress baseline_file [--write] [--threshold fraction] [--trials n]
+ *
+ *  Runs a fixed corpus of generated meshes through the benchmark and compares the median
+ *  time of every hot path to the baseline file. Fails when the confidence interval of a
+ *  median lies entirely above the baseline plus the threshold.
+ *
+ *  With --write, it replaces the baseline file with the current medians instead.
+ *  Baselines only mean something on the machine they were written on.
+ */
+
+struct CorpusCase
+{
+    const char *name;
+    size_t countColumns,
+           countRows,
+           countBones,
+           hierarchyDepth,
+           animationLength,
+           countKeys,
+           countFrames;  // per trial
+};
+
+const CorpusCase corpus[] = {
+    // name                  columns rows bones depth length keys frames
+    {"small-shallow-short",       8,   8,   32,    2,    30,    5,    50},
+    {"small-deep-long",           8,   8,   32,   32,  1000,  200,    50},
+    {"medium-shallow-short",     64,  64,   32,    2,    30,    5,    50},
+    {"medium-deep-short",        64,  64,   32,   32,    30,    5,    50},
+    {"medium-shallow-long",      64,  64,   32,    2,  1000,  200,    50},
+    {"medium-deep-long",         64,  64,   32,   32,  1000,  200,    50},
+    {"huge-deep-short",         192, 192,   64,   64,    30,    5,     5},
+};
+
+const char *hotPaths[] = {"parse", "derive", "pose", "skin", "normals"};
+
+const double confidenceLevel = 0.95;
+
+
+/**
+ * Distribution free confidence interval of the median: the widest pair of order statistics
+ * x(j), x(n - j + 1) that still covers the median with the requested probability.
+ */
+void GetMedianInterval(std::vector<double> values, double &lowOut, double &highOut)
+{
+    std::sort(values.begin(), values.end());
+
+    const size_t n = values.size();
+
+    // P(B <= k) for B ~ Binomial(n, 0.5), accumulated per k.
+    std::vector<double> cumulative(n + 1);
+    double p = std::pow(0.5, double(n)), sum = 0.0;
+    size_t k;
+    for (k = 0; k <= n; k++)
+    {
+        sum += p;
+        cumulative[k] = sum;
+        p *= double(n - k) / double(k + 1);
+    }
+
+    size_t j = 1;  // 1-based rank
+    while (j < n / 2 && 1.0 - 2.0 * cumulative[j] >= confidenceLevel)
+        j++;
+
+    lowOut = values[j - 1];
+    highOut = values[n - j];
+}
+
+std::string GetKey(const char *caseName, const char *stage)
+{
+    return std::string(caseName) + " " + stage;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " baseline_file [--write] [--threshold fraction] [--trials n]"
+                  << std::endl;
+        return 1;
+    }
+
+    const char *baselinePath = argv[1];
+    bool write = false;
+    double threshold = 0.25;
+    size_t countTrials = 7;
+
+    int i;
+    for (i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--write") == 0)
+            write = true;
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc)
+            countTrials = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    // One line per case and stage: case stage median_seconds
+    std::map<std::string, double> baseline;
+    if (!write)
+    {
+        std::ifstream is(baselinePath);
+        if (!is.good())
+        {
+            std::cerr << "cannot read " << baselinePath << ", run with --write first" << std::endl;
+            return 1;
+        }
+
+        std::string line, caseName, stage;
+        double seconds;
+        while (std::getline(is, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream ls(line);
+            if (ls >> caseName >> stage >> seconds)
+                baseline[caseName + " " + stage] = seconds;
+        }
+    }
+
+    std::ostringstream written;
+    written << "# case stage median_seconds, written by regress --write" << std::endl;
+
+    size_t countRegressions = 0;
+    std::cout << std::left << std::setw(22) << "case" << std::setw(9) << "stage"
+              << std::setw(40) << "median [interval] (s)" << std::setw(12) << "baseline" << "change" << std::endl;
+    for (const CorpusCase &c : corpus)
+    {
+        SyntheticMeshParams params;
+        params.countColumns = c.countColumns;
+        params.countRows = c.countRows;
+        params.countBones = c.countBones;
+        params.hierarchyDepth = c.hierarchyDepth;
+        params.countAnimations = 2;
+        params.animationLength = c.animationLength;
+        params.countKeys = c.countKeys;
+        params.countExtraBones = 2;
+
+        BenchmarkTimings timings = RunBenchmark(params, countTrials, c.countFrames);
+
+        for (const char *stage : hotPaths)
+        {
+            const std::vector<double> &seconds = timings[stage];
+            const double median = GetMedian(seconds);
+            double low, high;
+            GetMedianInterval(seconds, low, high);
+
+            written << c.name << " " << stage << " " << std::setprecision(6) << median << std::endl;
+
+            std::ostringstream measured;
+            measured << std::setprecision(4) << median << " [" << low << ", " << high << "]";
+            std::cout << std::setw(22) << c.name << std::setw(9) << stage << std::setw(40) << measured.str();
+
+            const std::string key = GetKey(c.name, stage);
+            if (write)
+                std::cout << std::endl;
+            else if (baseline.find(key) == baseline.end())
+                std::cout << std::setw(12) << "-" << "new" << std::endl;
+            else
+            {
+                const double reference = baseline.at(key),
+                             change = median / reference - 1.0;
+
+                std::cout << std::setw(12) << std::setprecision(4) << reference
+                          << std::showpos << std::fixed << std::setprecision(1) << (100.0 * change) << "%"
+                          << std::noshowpos << std::defaultfloat;
+
+                // Only fail if even the best case of the interval is too slow.
+                if (low > reference * (1.0 + threshold))
+                {
+                    std::cout << " REGRESSION";
+                    countRegressions++;
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    if (write)
+    {
+        std::ofstream os(baselinePath);
+        os << written.str();
+        if (!os.good())
+        {
+            std::cerr << "cannot write " << baselinePath << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << baselinePath << std::endl;
+        return 0;
+    }
+
+    if (countRegressions > 0)
+    {
+        std::cout << countRegressions << " regressions beyond " << std::setprecision(3) << (100.0 * threshold) << "%" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <sstream>
+
+#include "mesh.h"
+#include "meshmemory.h"
+#include "load.h"
+#include "datacache.h"
+#include "skeleton.h"
+#include "synthetic.h"
+
+
+using namespace XMLMesh;
+
+/*
+ *  Counts the allocations on the global heap that haven't been freed yet,
+ *  so that the test can check that a parsed mesh doesn't leave any there.
+ */
+std::atomic<long> countLiveAllocations(0);
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+
+    countLiveAllocations++;
+    return p;
+}
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void *p) noexcept
+{
+    if (p != NULL)
+        countLiveAllocations--;
+    free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+/*
+ *  Gets memory without going through operator new.
+ */
+class MallocResource: public std::pmr::memory_resource
+{
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override
+        {
+            void *p = aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+            if (p == NULL)
+                throw std::bad_alloc();
+            return p;
+        }
+        void do_deallocate(void *p, size_t, size_t) override
+        {
+            free(p);
+        }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+};
+
+int main(void)
+{
+    SyntheticMeshParams params;
+    params.countColumns = 16;
+    params.countRows = 8;
+    params.countBones = 8;
+    params.countAnimations = 3;
+    params.animationLength = 60;
+    params.countKeys = 7;
+    params.countExtraBones = 2;
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+    const std::string xml = ss.str();
+
+    MallocResource upstream;
+    MeshCountingResource dataResource(&upstream),
+                         stateResource(&upstream);
+
+    int result = 0;
+
+    std::istringstream is(xml);
+
+    // Everything that outlives parsing and deriving must be in the resources.
+    const long countLiveBefore = countLiveAllocations;
+    MeshData *pMeshData = ParseMeshData(is, &dataResource);
+    MeshState *pMeshState = DeriveMeshState(pMeshData, &stateResource);
+    {
+        // This compiles a skinning table, which the MeshState keeps.
+        std::unordered_map<std::string, MeshBoneTransformation> transformations;
+        GetBoneTransformationsAt(pMeshData, "anim0", 500, 25.0f, true, transformations);
+        ApplyBoneTransformations(pMeshData, transformations, pMeshState);
+    }
+
+    const long countLeftOnHeap = countLiveAllocations - countLiveBefore;
+
+    std::cout << "mesh data: " << dataResource.GetBytesInUse() << " bytes in "
+              << dataResource.CountAllocations() << " allocations" << std::endl
+              << "mesh state: " << stateResource.GetBytesInUse() << " bytes in "
+              << stateResource.CountAllocations() << " allocations" << std::endl
+              << "left on the global heap: " << countLeftOnHeap << " allocations" << std::endl;
+
+    if (countLeftOnHeap != 0 || dataResource.GetBytesInUse() == 0 || stateResource.GetBytesInUse() == 0)
+        result = 1;
+
+    // The reported usage must add up to exactly what the resources handed out.
+    const MeshMemoryUsage dataUsage = GetMemoryUsage(pMeshData),
+                          stateUsage = GetMemoryUsage(pMeshState);
+
+    std::cout << "mesh data usage:"
+              << " vertices " << dataUsage.vertexBytes
+              << ", faces " << dataUsage.faceBytes
+              << ", adjacency " << dataUsage.adjacencyBytes
+              << ", ids " << dataUsage.idBytes
+              << ", subsets " << dataUsage.subsetBytes
+              << ", bones " << dataUsage.boneBytes
+              << ", animations " << dataUsage.animationBytes
+              << ", hash tables " << dataUsage.hashTableBytes
+              << ", object " << dataUsage.objectBytes << std::endl
+              << "mesh state skinning table: " << stateUsage.skinningBytes << " bytes" << std::endl;
+
+    if (dataUsage.GetTotal() != dataResource.GetBytesInUse() || stateUsage.GetTotal() != stateResource.GetBytesInUse())
+    {
+        std::cerr << "memory usage reports " << dataUsage.GetTotal() << " and " << stateUsage.GetTotal()
+                  << " bytes, but the resources gave out " << dataResource.GetBytesInUse()
+                  << " and " << stateResource.GetBytesInUse() << std::endl;
+        result = 1;
+    }
+
+    if (dataUsage.vertexBytes == 0 || dataUsage.faceBytes == 0 || dataUsage.adjacencyBytes == 0
+            || dataUsage.subsetBytes == 0 || dataUsage.boneBytes == 0 || dataUsage.animationBytes == 0
+            || dataUsage.hashTableBytes == 0 || dataUsage.skinningBytes != 0
+            || stateUsage.boneBytes != 0 || stateUsage.animationBytes != 0 || stateUsage.skinningBytes == 0)
+    {
+        std::cerr << "memory usage in the wrong categories" << std::endl;
+        result = 1;
+    }
+
+    if (pMeshData->GetMemoryResource() != &dataResource || pMeshState->GetMemoryResource() != &stateResource)
+    {
+        std::cerr << "wrong memory resource" << std::endl;
+        result = 1;
+    }
+
+    DestroyMeshState(pMeshState);
+    DestroyMeshData(pMeshData);
+
+    if (dataResource.GetBytesInUse() != 0 || stateResource.GetBytesInUse() != 0
+            || dataResource.CountAllocations() != dataResource.CountDeallocations()
+            || stateResource.CountAllocations() != stateResource.CountDeallocations())
+    {
+        std::cerr << "not everything was given back to the resources" << std::endl;
+        result = 1;
+    }
+
+    // A monotonic resource can be released as a whole, without destroying the mesh.
+    std::pmr::monotonic_buffer_resource arena(&upstream);
+    is.clear();
+    is.seekg(0);
+    pMeshData = ParseMeshData(is, &arena);
+
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData);
+    if (pSkeleton->CountVertices() != (params.countColumns + 1) * (params.countRows + 1))
+    {
+        std::cerr << "the mesh parsed into a monotonic resource is incomplete" << std::endl;
+        result = 1;
+    }
+    DestroyMeshSkeleton(pSkeleton);
+
+    arena.release();
+
+    // Failed loads must give back what they built before the error, on both parsers.
+    std::string broken = xml;
+    const size_t position = broken.find("vertex_id=\"", broken.find("<faces>")) + 11;
+    broken.insert(position, "missing");
+
+    for (const bool useScanner : {true, false})
+    {
+        std::istringstream isBroken(broken);
+        try
+        {
+            DestroyMeshData(ParseMeshData(isBroken, &dataResource, useScanner));
+            std::cerr << "a face with a missing vertex was accepted" << std::endl;
+            result = 1;
+        }
+        catch (const MeshKeyError &)
+        {
+        }
+    }
+
+    // So must cancelled ones. This one is cancelled once it starts building.
+    MeshLoadOptions options;
+    options.pResource = &dataResource;
+
+    std::unique_ptr<MeshLoadHandle> pHandle;
+    options.onProgress = [&](const MeshLoadProgress &progress)
+    {
+        if (progress.phase == MESHLOAD_BUILDING)
+            pHandle->Cancel();
+    };
+
+    // The task only runs once the handle exists.
+    MeshTask task;
+    options.executor = [&task](MeshTask t) { task = t; };
+    is.clear();
+    is.seekg(0);
+    pHandle.reset(new MeshLoadHandle(ParseMeshDataAsync(is, options)));
+    task();
+    try
+    {
+        DestroyMeshData(pHandle->GetFuture().get());
+        std::cerr << "the cancelled load wasn't cancelled" << std::endl;
+        result = 1;
+    }
+    catch (const MeshLoadCancelled &)
+    {
+    }
+
+    // Batches keep their results in order, and failed files don't keep the others from loading.
+    const char *batchPath = "resources_batch.xml";
+    {
+        std::ofstream batchFile(batchPath, std::ios::binary);
+        batchFile << xml;
+    }
+    MeshBatchOptions batchOptions;
+    batchOptions.pResource = &dataResource;
+    batchOptions.countThreads = 2;
+    batchOptions.countPrefetched = 1;
+    MeshBatchStats batchStats;
+    const std::vector<MeshBatchResult> batchResults = ParseMeshFiles({batchPath, "resources_missing.xml", batchPath},
+                                                                     batchOptions, &batchStats);
+
+    // Lazy animations are read from the file when they're used, and give the same poses.
+    MeshLoadOptions lazyOptions;
+    lazyOptions.pResource = &dataResource;
+    lazyOptions.lazyAnimations = true;
+    MeshData *pLazyMeshData = ParseMeshFile(batchPath, lazyOptions);
+    if (batchResults[0].pMeshData != NULL)
+    {
+        const MeshData *pEagerMeshData = batchResults[0].pMeshData;
+        const std::string_view animationID = (*pEagerMeshData->IterAnimations().begin())->id;
+
+        const size_t lazyBytes = GetMemoryUsage(pLazyMeshData).GetTotal();
+        if (pLazyMeshData->IsAnimationLoaded(animationID) || lazyBytes >= GetMemoryUsage(pEagerMeshData).GetTotal())
+        {
+            std::cerr << "the lazy animations were loaded with the mesh" << std::endl;
+            result = 1;
+        }
+
+        std::unordered_map<std::string, MeshBoneTransformation> eagerPose, lazyPose;
+        GetBoneTransformationsAt(pEagerMeshData, animationID, 500, 30.0f, true, eagerPose);
+        GetBoneTransformationsAt(pLazyMeshData, animationID, 500, 30.0f, true, lazyPose);
+        if (!pLazyMeshData->IsAnimationLoaded(animationID) || GetMemoryUsage(pLazyMeshData).GetTotal() <= lazyBytes
+                || lazyPose.size() != eagerPose.size() || lazyPose.empty())
+        {
+            std::cerr << "the lazy animation gave " << lazyPose.size() << " bone transformations instead of "
+                      << eagerPose.size() << std::endl;
+            result = 1;
+        }
+        for (const auto &pair : eagerPose)
+        {
+            if (!HAS_ID(lazyPose, std::get<0>(pair))
+                    || lazyPose.at(std::get<0>(pair)).rotation != std::get<1>(pair).rotation
+                    || lazyPose.at(std::get<0>(pair)).translation != std::get<1>(pair).translation)
+            {
+                std::cerr << "the lazy animation moved bone " << std::get<0>(pair) << " differently" << std::endl;
+                result = 1;
+                break;
+            }
+        }
+    }
+    DestroyMeshData(pLazyMeshData);
+
+    // A cache counts a mesh once, so it loads all animations up front.
+    MeshDataCache *pLazyCache = CreateMeshDataCache(0, lazyOptions);
+    {
+        MeshDataHandle pCachedMeshData = pLazyCache->GetFile(batchPath);
+        const std::string_view animationID = (*pCachedMeshData->IterAnimations().begin())->id;
+        if (!pCachedMeshData->IsAnimationLoaded(animationID)
+                || pLazyCache->GetUsedBytes() != GetMemoryUsage(pCachedMeshData.get()).GetTotal()
+                                                 + std::string("file:").size() + std::strlen(batchPath))
+        {
+            std::cerr << "the cache loaded animations lazily, counting " << pLazyCache->GetUsedBytes() << " bytes" << std::endl;
+            result = 1;
+        }
+    }
+    DestroyMeshDataCache(pLazyCache);
+
+    // An animation that changed in the file isn't read, even if the file's size stays the same.
+    pLazyMeshData = ParseMeshFile(batchPath, lazyOptions);
+    {
+        const std::string animationID = "anim1";
+        std::string changed = xml;
+        changed.replace(changed.find("y=\"0.0\"", changed.find("<animation id=\"" + animationID + "\"")), 7, "y=\"9.0\"");
+        {
+            std::ofstream batchFile(batchPath, std::ios::binary);
+            batchFile << changed;
+        }
+
+        try
+        {
+            pLazyMeshData->GetAnimation(animationID);
+
+            std::cerr << "the lazy animation was read from a changed file" << std::endl;
+            result = 1;
+        }
+        catch (const MeshParseError &)
+        {
+        }
+    }
+    DestroyMeshData(pLazyMeshData);
+    std::remove(batchPath);
+
+    if (batchResults.size() != 3 || batchResults[1].path != "resources_missing.xml" || !batchResults[1].error
+            || batchResults[0].pMeshData == NULL || batchResults[2].pMeshData == NULL
+            || batchStats.countFailed != 1 || batchStats.countBytes != 2 * xml.size())
+    {
+        std::cerr << "the batch gave " << batchResults.size() << " results with " << batchStats.countFailed
+                  << " failures and " << batchStats.countBytes << " bytes" << std::endl;
+        result = 1;
+    }
+    for (const MeshBatchResult &batchResult : batchResults)
+        DestroyMeshData(batchResult.pMeshData);
+
+    // Identical documents share one mesh, which stays cached until it's dropped.
+    // The cache keeps the documents, to tell them apart.
+    MeshLoadOptions cacheOptions;
+    cacheOptions.pResource = &dataResource;
+    MeshDataCache *pCache = CreateMeshDataCache(0, cacheOptions);
+    {
+        std::string moved = xml;
+        moved.replace(moved.find("x=\"1\""), 5, "x=\"2\"");
+
+        std::istringstream isFirst(xml), isSecond(xml), isMoved(moved);
+        MeshDataHandle pFirst = pCache->GetDocument(isFirst),
+                       pSecond = pCache->GetDocument(isSecond),
+                       pMoved = pCache->GetDocument(isMoved);
+        const size_t documentBytes = 2 * (std::string("document:").size() + xml.size());
+        if (pFirst != pSecond || pMoved == pFirst || pCache->CountHits() != 1 || pCache->CountMisses() != 2
+                || pCache->GetUsedBytes() != dataResource.GetBytesInUse() + documentBytes)
+        {
+            std::cerr << "the cache had " << pCache->CountHits() << " hits and " << pCache->CountMisses()
+                      << " misses, counting " << pCache->GetUsedBytes() << " bytes" << std::endl;
+            result = 1;
+        }
+
+        pCache->Clear();
+        if (pCache->CountMeshes() != 2)
+        {
+            std::cerr << "the cache dropped a mesh that's still held" << std::endl;
+            result = 1;
+        }
+    }
+    pCache->Clear();
+    if (pCache->CountMeshes() != 0 || pCache->GetUsedBytes() != 0)
+    {
+        std::cerr << "the cache kept " << pCache->CountMeshes() << " meshes that nobody holds" << std::endl;
+        result = 1;
+    }
+    DestroyMeshDataCache(pCache);
+
+    if (dataResource.GetBytesInUse() != 0)
+    {
+        std::cerr << "failed, cancelled, batched and cached loads left " << dataResource.GetBytesInUse() << " bytes in use" << std::endl;
+        result = 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,626 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "crowd.h"
+#include "cache.h"
+#include "skin.h"
+#include "synthetic.h"
+
+
+using namespace XMLMesh;
+
+/*
+ *  Checks the faster ways to skin a mesh against the simplest one: GetBoneTransformationsAt
+ *  followed by ApplyBoneTransformations, one MeshState object at a time.
+ */
+
+const float framesPerSecond = 25.0f;
+
+/*
+ *  Positions are a few units from the origin, so this leaves room for rounding only.
+ */
+const float positionTolerance = 1e-3f;
+
+// For comparing two poses that should be the same.
+const float poseTolerance = 1e-5f;
+
+/*
+ *  Skins the MeshState object the simple way and copies its positions in skeleton order.
+ */
+void GetReferencePositions(const MeshData *pMeshData, MeshState *pMeshState, const MeshSkeleton *pSkeleton,
+                           const std::string_view animationID, const milliseconds msSinceStart, const bool loop,
+                           vec3 *positionsOut)
+{
+    std::unordered_map<std::string, MeshBoneTransformation> transformations;
+    GetBoneTransformationsAt(pMeshData, animationID, msSinceStart, framesPerSecond, loop, transformations);
+    ApplyBoneTransformations(pMeshData, transformations, pMeshState);
+
+    size_t i;
+    for (i = 0; i < pSkeleton->CountVertices(); i++)
+        positionsOut[i] = pMeshState->GetVertex(pSkeleton->GetVertex(i)->GetID())->GetPosition();
+}
+
+/*
+ *  Reports the largest distance between the expected and the actual vectors.
+ */
+bool CheckVectors(const std::string &what, const vec3 *expected, const vec3 *actual, const size_t count,
+                  const float tolerance)
+{
+    float maxError = 0.0f;
+    size_t i;
+    for (i = 0; i < count; i++)
+        maxError = std::max(maxError, length(actual[i] - expected[i]));
+
+    std::cout << what << ": off by up to " << maxError << std::endl;
+
+    // Also fails on NaN.
+    if (!(maxError <= tolerance))
+    {
+        std::cerr << what << " is off by up to " << maxError << ", more than " << tolerance << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CheckInstances(const MeshData *pMeshData, MeshState *pMeshState, const MeshSkeleton *pSkeleton)
+{
+    const size_t countBones = pSkeleton->CountBones(),
+                 countVertices = pSkeleton->CountVertices();
+
+    // Some instances share a frame, some are past the end of their animation.
+    std::vector<MeshInstance> instances;
+    size_t i;
+    for (i = 0; i < 40; i++)
+    {
+        MeshInstance instance;
+        instance.animationIndex = i % pSkeleton->CountAnimations();
+        instance.msSinceStart = (i % 7 == 0) ? 1000 : (i * 317) % 6000;
+        instance.loop = i % 3 != 0;
+        instances.push_back(instance);
+    }
+
+    std::vector<vec3> expected(instances.size() * countVertices);
+    for (i = 0; i < instances.size(); i++)
+        GetReferencePositions(pMeshData, pMeshState, pSkeleton,
+                              pSkeleton->GetAnimation(instances[i].animationIndex)->id,
+                              instances[i].msSinceStart, instances[i].loop, expected.data() + i * countVertices);
+
+    bool success = true;
+    for (const size_t countThreads : {1, 3})
+    {
+        std::vector<MeshBonePaletteEntry> palettes(instances.size() * countBones);
+        GetInstanceBonePalettes(pSkeleton, instances.data(), instances.size(), framesPerSecond,
+                                palettes.data(), countThreads);
+
+        std::vector<vec3> positions(instances.size() * countVertices);
+        for (i = 0; i < instances.size(); i++)
+            SkinVertices(pSkeleton, palettes.data() + i * countBones, positions.data() + i * countVertices);
+        success &= CheckVectors("GetInstanceBonePalettes with " + std::to_string(countThreads) + " threads",
+                                expected.data(), positions.data(), positions.size(), positionTolerance);
+
+        SkinInstances(pSkeleton, instances.data(), instances.size(), framesPerSecond, positions.data(), countThreads);
+        success &= CheckVectors("SkinInstances with " + std::to_string(countThreads) + " threads",
+                                expected.data(), positions.data(), positions.size(), positionTolerance);
+    }
+
+    return success;
+}
+
+/*
+ *  Reports the largest difference between two poses, in translation and in rotation.
+ */
+bool CheckPoses(const std::string &what, const MeshBoneTransformation *expected,
+                const MeshBoneTransformation *actual, const size_t countBones, const float tolerance)
+{
+    float maxError = 0.0f;
+    size_t i;
+    for (i = 0; i < countBones; i++)
+    {
+        // q and -q are the same rotation.
+        maxError = std::max(maxError, length(actual[i].translation - expected[i].translation));
+        maxError = std::max(maxError, 1.0f - std::abs(dot(actual[i].rotation, expected[i].rotation)));
+    }
+
+    if (!(maxError <= tolerance))
+    {
+        std::cerr << what << " is off by up to " << maxError << ", more than " << tolerance << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CheckPoseCache(const MeshData *pMeshData, const MeshSkeleton *pSkeleton)
+{
+    const size_t countBones = pSkeleton->CountBones();
+    const float stepsPerFrame = 4.0f;
+
+    MeshPoseCache *pCache = CreateMeshPoseCache(pSkeleton, stepsPerFrame, 1 << 20);
+
+    std::vector<MeshBoneTransformation> expected(countBones), actual(countBones);
+    bool success = true;
+
+    // On a key, on a step between keys and between two steps, where it's already cached.
+    for (const float frame : {17.0f, 17.25f, 17.3f})
+    {
+        const float stepFrame = std::round(frame * stepsPerFrame) / stepsPerFrame;
+        GetSkeletonPoseAt(pSkeleton, 1, stepFrame, true, expected.data());
+
+        const size_t countHits = pCache->CountHits();
+        pCache->GetPoseAt(1, frame, true, actual.data());
+        success &= CheckPoses("the pose cache at frame " + std::to_string(frame),
+                              expected.data(), actual.data(), countBones, poseTolerance);
+
+        // The second time, it's a hit.
+        pCache->GetPoseAt(1, frame, true, actual.data());
+        success &= CheckPoses("the pose cache hit at frame " + std::to_string(frame),
+                              expected.data(), actual.data(), countBones, poseTolerance);
+        if (pCache->CountHits() == countHits)
+        {
+            std::cerr << "the pose cache missed frame " << frame << " twice" << std::endl;
+            success = false;
+        }
+
+        // Less than half a step away from the exact pose.
+        GetSkeletonPoseAt(pSkeleton, 1, frame, true, expected.data());
+        success &= CheckPoses("the pose cache hit, rounded from frame " + std::to_string(frame),
+                              expected.data(), actual.data(), countBones, 0.01f);
+    }
+
+    // The string keyed version, at a time that falls on a step.
+    std::unordered_map<std::string, MeshBoneTransformation> expectedByID, actualByID;
+    GetBoneTransformationsAt(pMeshData, "anim2", 1250, framesPerSecond, false, expectedByID);
+    GetBoneTransformationsAt(pCache, "anim2", 1250, framesPerSecond, false, actualByID);
+    GetSkeletonPose(pSkeleton, expectedByID, expected.data());
+    GetSkeletonPose(pSkeleton, actualByID, actual.data());
+    success &= CheckPoses("the pose cache by id", expected.data(), actual.data(), countBones, poseTolerance);
+    if (actualByID.size() != expectedByID.size())
+    {
+        std::cerr << "the pose cache gave " << actualByID.size() << " transformations instead of "
+                  << expectedByID.size() << std::endl;
+        success = false;
+    }
+
+    DestroyMeshPoseCache(pCache);
+
+    return success;
+}
+
+bool CheckVertexCache(const MeshData *pMeshData, MeshState *pMeshState, const MeshSkeleton *pSkeleton)
+{
+    const size_t animationIndex = 1,
+                 countVertices = pSkeleton->CountVertices(),
+                 countFrames = pSkeleton->GetAnimation(animationIndex)->length + 1;
+    const std::string_view animationID = pSkeleton->GetAnimation(animationIndex)->id;
+    const milliseconds msPerFrame = milliseconds(1000 / framesPerSecond);
+
+    MeshVertexAnimationCache *pCache = CreateMeshVertexAnimationCache(pMeshData, pSkeleton, animationID, false, false);
+
+    // Positions are rounded to 16 bit steps of the bounding box of all frames.
+    std::vector<vec3> framePositions(countFrames * countVertices);
+    vec3 boundsMin(1e30f),
+         boundsMax(-1e30f);
+    size_t frame, i;
+    for (frame = 0; frame < countFrames; frame++)
+    {
+        vec3 *positions = framePositions.data() + frame * countVertices;
+        GetReferencePositions(pMeshData, pMeshState, pSkeleton, animationID, frame * msPerFrame, false, positions);
+
+        for (i = 0; i < countVertices; i++)
+        {
+            boundsMin = min(boundsMin, positions[i]);
+            boundsMax = max(boundsMax, positions[i]);
+        }
+    }
+    const float quantizationError = 0.5f * length(boundsMax - boundsMin) / 65535.0f + poseTolerance;
+
+    std::vector<vec3> expected(countVertices), actual(countVertices);
+    bool success = true;
+    for (const size_t keyFrame : {size_t(0), size_t(8), size_t(30), countFrames - 1})
+    {
+        pCache->GetVerticesAt(keyFrame * msPerFrame, framesPerSecond, actual.data(), NULL);
+        success &= CheckVectors("the vertex cache at frame " + std::to_string(keyFrame),
+                                framePositions.data() + keyFrame * countVertices, actual.data(), countVertices,
+                                quantizationError);
+    }
+
+    /*
+     *  Between frames, the cache interpolates positions where skinning interpolates the pose.
+     *  The difference between those two adds to the error.
+     */
+    for (const size_t previousFrame : {size_t(8), size_t(30)})
+    {
+        const milliseconds msSinceStart = previousFrame * msPerFrame + msPerFrame / 4;
+        GetReferencePositions(pMeshData, pMeshState, pSkeleton, animationID, msSinceStart, false, expected.data());
+
+        const vec3 *positions0 = framePositions.data() + previousFrame * countVertices,
+                   *positions1 = positions0 + countVertices;
+        float interpolationError = 0.0f;
+        for (i = 0; i < countVertices; i++)
+            interpolationError = std::max(interpolationError,
+                                          length(mix(positions0[i], positions1[i], 0.25f) - expected[i]));
+
+        pCache->GetVerticesAt(msSinceStart, framesPerSecond, actual.data(), NULL);
+        success &= CheckVectors("the vertex cache after frame " + std::to_string(previousFrame),
+                                expected.data(), actual.data(), countVertices,
+                                quantizationError + interpolationError);
+    }
+
+    // Playing back into a MeshState gives the cache's positions.
+    MeshSkinningTable *pTable = CompileMeshSkinningTable(pSkeleton, pMeshState);
+    const milliseconds msSinceStart = 30 * msPerFrame + msPerFrame / 3;
+    ApplyVertexAnimation(pCache, msSinceStart, framesPerSecond, pTable);
+    for (i = 0; i < countVertices; i++)
+        expected[i] = pMeshState->GetVertex(pSkeleton->GetVertex(i)->GetID())->GetPosition();
+    pCache->GetVerticesAt(msSinceStart, framesPerSecond, actual.data(), NULL);
+    success &= CheckVectors("the vertex cache played back", expected.data(), actual.data(), countVertices, 0.0f);
+    DestroyMeshSkinningTable(pTable);
+
+    DestroyMeshVertexAnimationCache(pCache);
+
+    return success;
+}
+
+/*
+ *  Compares the skinner's positions, and those of its MeshState object if given, with skinning the whole pose.
+ */
+bool CheckSkinnerPositions(const std::string &what, const MeshIncrementalSkinner *pSkinner, const MeshState *pMeshState,
+                           const MeshSkeleton *pSkeleton, const MeshBoneTransformation *pose)
+{
+    const size_t countVertices = pSkeleton->CountVertices();
+
+    std::vector<MeshBonePaletteEntry> palette(pSkeleton->CountBones());
+    std::vector<vec3> expected(countVertices), statePositions(countVertices);
+    GetBonePalette(pSkeleton, pose, palette.data());
+    SkinVertices(pSkeleton, palette.data(), expected.data());
+
+    if (!CheckVectors(what, expected.data(), pSkinner->GetPositions(), countVertices, poseTolerance))
+        return false;
+    if (pMeshState == NULL)
+        return true;
+
+    size_t i;
+    for (i = 0; i < countVertices; i++)
+        statePositions[i] = pMeshState->GetVertex(pSkeleton->GetVertex(i)->GetID())->GetPosition();
+
+    return CheckVectors(what + ", in the MeshState", expected.data(), statePositions.data(), countVertices,
+                        poseTolerance);
+}
+
+bool CheckSkinnedVertexCount(const std::string &what, const MeshIncrementalSkinner *pSkinner, const size_t expected)
+{
+    if (pSkinner->GetStatistics().countSkinnedVertices != expected)
+    {
+        std::cerr << what << " skinned " << pSkinner->GetStatistics().countSkinnedVertices
+                  << " vertices instead of " << expected << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CheckIncrementalSkinner(const MeshData *pMeshData, const MeshSkeleton *pSkeleton)
+{
+    const size_t countBones = pSkeleton->CountBones(),
+                 countVertices = pSkeleton->CountVertices(),
+                 lastBoneIndex = countBones - 1;
+    const float tolerance = 0.01f;
+
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+    MeshIncrementalSkinner *pSkinner = CreateMeshIncrementalSkinner(pSkeleton, pMeshState),
+                           *pTolerantSkinner = CreateMeshIncrementalSkinner(pSkeleton, NULL, tolerance);
+
+    std::vector<MeshBoneTransformation> pose(countBones);
+    GetSkeletonPoseAt(pSkeleton, 0, 10.0f, true, pose.data());
+
+    bool success = true;
+    pSkinner->Update(pose.data());
+    success &= CheckSkinnedVertexCount("the first update", pSkinner, countVertices)
+             & CheckSkinnerPositions("the first update", pSkinner, pMeshState, pSkeleton, pose.data());
+
+    pSkinner->Update(pose.data());
+    success &= CheckSkinnedVertexCount("an update without changes", pSkinner, 0);
+
+    // The bones form one chain, so the last bone has no children.
+    pose[lastBoneIndex].rotation = angleAxis(0.3f, vec3(0.0f, 0.0f, 1.0f));
+    pSkinner->Update(pose.data());
+    success &= CheckSkinnerPositions("moving the last bone", pSkinner, pMeshState, pSkeleton, pose.data());
+    if (pSkinner->GetStatistics().countDirtyBones != 1
+            || pSkinner->GetStatistics().countSkinnedVertices >= countVertices)
+    {
+        std::cerr << "moving the last bone made " << pSkinner->GetStatistics().countDirtyBones
+                  << " bones dirty and skinned " << pSkinner->GetStatistics().countSkinnedVertices
+                  << " vertices" << std::endl;
+        success = false;
+    }
+
+    // Its children must follow.
+    pose[countBones / 2].translation += vec3(0.0f, 0.2f, 0.0f);
+    pSkinner->Update(pose.data());
+    success &= CheckSkinnerPositions("moving a bone in the middle", pSkinner, pMeshState, pSkeleton, pose.data());
+    if (pSkinner->GetStatistics().countDirtyBones != countBones - countBones / 2)
+    {
+        std::cerr << "moving a bone in the middle made " << pSkinner->GetStatistics().countDirtyBones
+                  << " bones dirty instead of " << (countBones - countBones / 2) << std::endl;
+        success = false;
+    }
+
+    pSkinner->Reset();
+    pSkinner->Update(pose.data());
+    success &= CheckSkinnedVertexCount("the update after a reset", pSkinner, countVertices)
+             & CheckSkinnerPositions("the update after a reset", pSkinner, pMeshState, pSkeleton, pose.data());
+
+    // Changes within the tolerance are ignored, until they add up to more than it.
+    const std::vector<MeshBoneTransformation> firstPose = pose;
+    pTolerantSkinner->Update(pose.data());
+
+    pose[lastBoneIndex].translation.x += 0.4f * tolerance;
+    pTolerantSkinner->Update(pose.data());
+    pose[lastBoneIndex].translation.x += 0.4f * tolerance;
+    pTolerantSkinner->Update(pose.data());
+    success &= CheckSkinnedVertexCount("a drift within the tolerance", pTolerantSkinner, 0)
+             & CheckSkinnerPositions("a drift within the tolerance", pTolerantSkinner, NULL, pSkeleton,
+                                     firstPose.data());
+
+    pose[lastBoneIndex].translation.x += 0.4f * tolerance;
+    pTolerantSkinner->Update(pose.data());
+    success &= CheckSkinnerPositions("a drift beyond the tolerance", pTolerantSkinner, NULL, pSkeleton, pose.data());
+    if (pTolerantSkinner->GetStatistics().countDirtyBones != 1)
+    {
+        std::cerr << "a drift beyond the tolerance made " << pTolerantSkinner->GetStatistics().countDirtyBones
+                  << " bones dirty instead of 1" << std::endl;
+        success = false;
+    }
+
+    DestroyMeshIncrementalSkinner(pTolerantSkinner);
+    DestroyMeshIncrementalSkinner(pSkinner);
+    DestroyMeshState(pMeshState);
+
+    return success;
+}
+
+/*
+ *  Skins the whole mesh in both modes.
+ */
+void SkinBothModes(const MeshSkeleton *pSkeleton, const MeshBoneTransformation *pose,
+                   std::vector<vec3> &linearOut, std::vector<vec3> &dualQuaternionOut)
+{
+    std::vector<MeshBonePaletteEntry> palette(pSkeleton->CountBones());
+    GetBonePalette(pSkeleton, pose, palette.data());
+
+    linearOut.resize(pSkeleton->CountVertices());
+    dualQuaternionOut.resize(pSkeleton->CountVertices());
+    SkinVertices(pSkeleton, palette.data(), linearOut.data(), MESHSKIN_LINEAR);
+    SkinVertices(pSkeleton, palette.data(), dualQuaternionOut.data(), MESHSKIN_DUAL_QUATERNION);
+}
+
+bool CheckDualQuaternion(const MeshSkeleton *pSkeleton)
+{
+    const size_t countBones = pSkeleton->CountBones(),
+                 countVertices = pSkeleton->CountVertices();
+
+    std::vector<MeshBoneTransformation> pose(countBones);
+    std::vector<vec3> linear, dualQuaternion;
+    bool success = true;
+
+    // With one bone or none, both modes move the vertex rigidly.
+    GetSkeletonPoseAt(pSkeleton, 0, 10.0f, true, pose.data());
+    SkinBothModes(pSkeleton, pose.data(), linear, dualQuaternion);
+    const size_t end = pSkeleton->GetFirstVertexWithInfluences(2);
+    success &= CheckVectors("dual quaternion skinning, with one influence", linear.data(), dualQuaternion.data(),
+                            end, poseTolerance);
+
+    // When all bones move along with the root, the blends of any number of them must agree too.
+    std::fill(pose.begin(), pose.end(), MESHBONETRANSFORM_ID);
+    pose[0].rotation = angleAxis(0.7f, normalize(vec3(1.0f, 2.0f, 3.0f)));
+    pose[0].translation = vec3(0.5f, -1.0f, 2.0f);
+    SkinBothModes(pSkeleton, pose.data(), linear, dualQuaternion);
+    success &= CheckVectors("dual quaternion skinning, with a rigid pose", linear.data(), dualQuaternion.data(),
+                            countVertices, positionTolerance);
+
+    /*
+     *  Twisting half of the chain around the x axis, which goes through the bones' heads.
+     *  Blending the dual quaternions keeps every vertex at the same distance from that axis,
+     *  linear blending pulls the vertices near the twisting joint towards it.
+     */
+    std::fill(pose.begin(), pose.end(), MESHBONETRANSFORM_ID);
+    pose[countBones / 2].rotation = angleAxis(2.5f, vec3(1.0f, 0.0f, 0.0f));
+    SkinBothModes(pSkeleton, pose.data(), linear, dualQuaternion);
+
+    const vec3 *restPositions = pSkeleton->GetRestPositions();
+    float maxError = 0.0f,
+          minLinearRatio = 1.0f;
+    size_t i;
+    for (i = 0; i < countVertices; i++)
+    {
+        const float restDistance = length(vec3(0.0f, restPositions[i].y, restPositions[i].z));
+
+        maxError = std::max(maxError, std::abs(length(vec3(0.0f, dualQuaternion[i].y, dualQuaternion[i].z))
+                                               - restDistance));
+        if (restDistance > 0.5f)
+            minLinearRatio = std::min(minLinearRatio,
+                                      length(vec3(0.0f, linear[i].y, linear[i].z)) / restDistance);
+    }
+    std::cout << "twisting: dual quaternions off the axis by up to " << maxError
+              << ", linear blending down to " << minLinearRatio << " of the distance" << std::endl;
+    if (!(maxError <= positionTolerance) || minLinearRatio > 0.9f)
+    {
+        std::cerr << "twisting moved vertices by up to " << maxError << " from the axis with dual quaternions and to "
+                  << minLinearRatio << " of their distance with linear blending" << std::endl;
+        success = false;
+    }
+
+    return success;
+}
+
+/*
+ *  Compares the normals and tangents that skinning rotates along, with those calculated
+ *  from the faces of the skinned mesh.
+ */
+bool CheckNormalsForPose(const std::string &what, MeshState *pMeshState, const MeshSkeleton *pSkeleton,
+                         const MeshBoneTransformation *pose, const float tolerance)
+{
+    const size_t countVertices = pSkeleton->CountVertices();
+
+    std::vector<MeshBonePaletteEntry> palette(pSkeleton->CountBones());
+    std::vector<vec3> positions(countVertices),
+                      normals(countVertices), tangents(countVertices),
+                      expectedNormals(countVertices), expectedTangents(countVertices);
+    GetBonePalette(pSkeleton, pose, palette.data());
+    SkinVertices(pSkeleton, palette.data(), positions.data(), normals.data(), tangents.data());
+
+    std::vector<MeshVertex *> vertexPs(countVertices);
+    size_t i;
+    for (i = 0; i < countVertices; i++)
+    {
+        vertexPs[i] = pMeshState->GetVertex(pSkeleton->GetVertex(i)->GetID());
+        vertexPs[i]->SetPosition(positions[i]);
+    }
+    for (i = 0; i < countVertices; i++)
+    {
+        expectedNormals[i] = CalculateVertexNormal(vertexPs[i]);
+        expectedTangents[i] = std::get<0>(CalculateVertexTangentBitangent(vertexPs[i]));
+    }
+
+    return CheckVectors(what + ", normals", expectedNormals.data(), normals.data(), countVertices, tolerance)
+         & CheckVectors(what + ", tangents", expectedTangents.data(), tangents.data(), countVertices, tolerance);
+}
+
+bool CheckNormals(const SyntheticMeshParams &meshParams)
+{
+    // Bones far apart pulling at the same vertex would crumple its faces when the mesh bends.
+    SyntheticMeshParams params = meshParams;
+    params.countExtraBones = 0;
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+
+    MeshData *pMeshData = ParseMeshData(ss);
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData, true, true);
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+
+    const size_t countBones = pSkeleton->CountBones();
+    std::vector<MeshBoneTransformation> pose(countBones, MESHBONETRANSFORM_ID);
+    bool success = true;
+
+    // Turning the whole mesh doesn't change its shape, so the normals must follow exactly.
+    pose[0].rotation = angleAxis(0.7f, normalize(vec3(1.0f, 2.0f, 3.0f)));
+    success &= CheckNormalsForPose("a rigid pose", pMeshState, pSkeleton, pose.data(), poseTolerance);
+
+    /*
+     *  Bending the flat mesh out of its plane, a little at every bone. Rotating the normals
+     *  by the blended bone rotations only approximates the faces around the joints, to within
+     *  the angle of one joint.
+     */
+    const float jointAngle = 0.15f;
+    size_t boneIndex;
+    for (boneIndex = 0; boneIndex < countBones; boneIndex++)
+        pose[boneIndex].rotation = angleAxis(jointAngle, vec3(0.0f, 1.0f, 0.0f));
+    success &= CheckNormalsForPose("a bent pose", pMeshState, pSkeleton, pose.data(), jointAngle);
+
+    DestroyMeshState(pMeshState);
+    DestroyMeshSkeleton(pSkeleton);
+    DestroyMeshData(pMeshData);
+
+    return success;
+}
+
+/*
+ *  A MeshData object may be allocated where a destroyed one was. A MeshState object that was
+ *  skinned with the destroyed one must not keep using the skinning table compiled from it.
+ */
+bool CheckReusedAddress(const SyntheticMeshParams &params)
+{
+    // The same vertices and faces, but the bones pull at other vertices.
+    SyntheticMeshParams otherParams = params;
+    otherParams.countExtraBones = 0;
+
+    std::stringstream ss, otherSS;
+    WriteSyntheticMesh(ss, params);
+    WriteSyntheticMesh(otherSS, otherParams);
+
+    // Both meshes are built in the same buffer, in the same order, so they get the same address.
+    std::vector<char> buffer(16 << 20);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+    MeshData *pMeshData = ParseMeshData(ss, &arena);
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+    std::unordered_map<std::string, MeshBoneTransformation> transformations;
+    GetBoneTransformationsAt(pMeshData, "anim1", 800, framesPerSecond, false, transformations);
+    ApplyBoneTransformations(pMeshData, transformations, pMeshState);
+
+    const MeshData *pDestroyed = pMeshData;
+    DestroyMeshData(pMeshData);
+    arena.release();
+    pMeshData = ParseMeshData(otherSS, &arena);
+
+    bool success = true;
+    if (pMeshData != pDestroyed)
+    {
+        std::cerr << "the second mesh didn't get the address of the first" << std::endl;
+        success = false;
+    }
+
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData);
+    MeshState *pFreshState = DeriveMeshState(pMeshData);
+    const size_t countVertices = pSkeleton->CountVertices();
+    std::vector<vec3> expected(countVertices), actual(countVertices);
+    GetReferencePositions(pMeshData, pFreshState, pSkeleton, "anim1", 800, false, expected.data());
+    GetReferencePositions(pMeshData, pMeshState, pSkeleton, "anim1", 800, false, actual.data());
+    success &= CheckVectors("a mesh at the address of a destroyed one", expected.data(), actual.data(),
+                            countVertices, poseTolerance);
+
+    DestroyMeshState(pFreshState);
+    DestroyMeshState(pMeshState);
+    DestroyMeshSkeleton(pSkeleton);
+    DestroyMeshData(pMeshData);
+
+    return success;
+}
+
+int main(void)
+{
+    SyntheticMeshParams params;
+    params.countColumns = 16;
+    params.countRows = 8;
+    params.countBones = 8;
+    params.countAnimations = 3;
+    params.animationLength = 60;
+    params.countKeys = 7;
+    params.countExtraBones = 5;  // also covers the generic skinning loop
+
+    std::stringstream ss;
+    WriteSyntheticMesh(ss, params);
+
+    MeshData *pMeshData = ParseMeshData(ss);
+    MeshState *pMeshState = DeriveMeshState(pMeshData);
+    MeshSkeleton *pSkeleton = CompileMeshSkeleton(pMeshData);
+
+    int result = 0;
+    if (!CheckInstances(pMeshData, pMeshState, pSkeleton))
+        result = 1;
+    if (!CheckPoseCache(pMeshData, pSkeleton))
+        result = 1;
+    if (!CheckVertexCache(pMeshData, pMeshState, pSkeleton))
+        result = 1;
+    if (!CheckIncrementalSkinner(pMeshData, pSkeleton))
+        result = 1;
+    if (!CheckDualQuaternion(pSkeleton))
+        result = 1;
+    if (!CheckNormals(params))
+        result = 1;
+    if (!CheckReusedAddress(params))
+        result = 1;
+
+    std::cout << (result == 0 ? "skinning checks passed" : "skinning checks failed") << std::endl;
+
+    DestroyMeshSkeleton(pSkeleton);
+    DestroyMeshState(pMeshState);
+    DestroyMeshData(pMeshData);
+
+    return result;
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <algorithm>
+
+#include "synthetic.h"
+
+
+size_t GetColumnBone(const SyntheticMeshParams &params, const size_t column)
+{
+    return std::min(column * params.countBones / (params.countColumns + 1), params.countBones - 1);
+}
+
+bool IsPulledBy(const SyntheticMeshParams &params, const size_t column, const size_t row, const size_t boneIndex)
+{
+    const size_t columnBone = GetColumnBone(params, column);
+    if (boneIndex == columnBone)
+        return true;
+
+    // Vertices at the border between two bones get pulled by both.
+    if (column + 1 < params.countColumns + 1 && GetColumnBone(params, column + 1) == boneIndex)
+        return true;
+
+    const size_t distance = (boneIndex + params.countBones - columnBone) % params.countBones;
+    return distance <= row % (params.countExtraBones + 1);
+}
+
+void WriteSyntheticMesh(std::ostream &os, const SyntheticMeshParams &params)
+{
+    const size_t countVertexColumns = params.countColumns + 1,
+                 countVertexRows = params.countRows + 1;
+    size_t row, column, i, j, k;
+
+    os << "<mesh>" << std::endl;
+
+    os << "<vertices>" << std::endl;
+    for (row = 0; row < countVertexRows; row++)
+        for (column = 0; column < countVertexColumns; column++)
+            os << "<vertex id=\"" << (row * countVertexColumns + column) << "\">"
+               << "<pos x=\"" << column << "\" y=\"" << row << "\" z=\"0.0\"/>"
+               << "</vertex>" << std::endl;
+    os << "</vertices>" << std::endl;
+
+    os << "<faces>" << std::endl;
+    for (row = 0; row < params.countRows; row++)
+        for (column = 0; column < params.countColumns; column++)
+        {
+            const size_t vertexIDs[4] = {row * countVertexColumns + column,
+                                         row * countVertexColumns + column + 1,
+                                         (row + 1) * countVertexColumns + column + 1,
+                                         (row + 1) * countVertexColumns + column};
+
+            os << "<quad id=\"" << (row * params.countColumns + column) << "\" smooth=\"true\">";
+            for (i = 0; i < 4; i++)
+                os << "<corner vertex_id=\"" << vertexIDs[i] << "\" tex_u=\"" << (i == 1 || i == 2 ? 1 : 0)
+                   << "\" tex_v=\"" << (i >= 2 ? 1 : 0) << "\"/>";
+            os << "</quad>" << std::endl;
+        }
+    os << "</faces>" << std::endl;
+
+    os << "<subsets><subset id=\"0\"><faces>" << std::endl;
+    for (i = 0; i < params.countRows * params.countColumns; i++)
+        os << "<quad id=\"" << i << "\"/>" << std::endl;
+    os << "</faces></subset></subsets>" << std::endl;
+
+    if (params.countBones <= 0)
+    {
+        os << "</mesh>" << std::endl;
+        return;
+    }
+
+    os << "<armature><bones>" << std::endl;
+    for (i = 0; i < params.countBones; i++)
+    {
+        os << "<bone id=\"bone" << i << "\" x=\"" << (float(i * countVertexColumns) / params.countBones)
+           << "\" y=\"0.0\" z=\"0.0\" weight=\"1.0\"";
+        if (i > 0 && (params.hierarchyDepth == 0 || i % params.hierarchyDepth != 0))
+            os << " parent_id=\"bone" << (i - 1) << "\"";
+        os << "><vertices>" << std::endl;
+
+        for (row = 0; row < countVertexRows; row++)
+        {
+            for (column = 0; column < countVertexColumns; column++)
+                if (IsPulledBy(params, column, row, i))
+                    os << "<vertex id=\"" << (row * countVertexColumns + column) << "\"/>";
+            os << std::endl;
+        }
+        os << "</vertices></bone>" << std::endl;
+    }
+    os << "</bones>" << std::endl;
+
+    os << "<animations>" << std::endl;
+    for (i = 0; i < params.countAnimations; i++)
+    {
+        os << "<animation id=\"anim" << i << "\" length=\"" << params.animationLength << "\">" << std::endl;
+        for (j = 0; j < params.countBones; j++)
+        {
+            os << "<layer bone_id=\"bone" << j << "\">";
+            for (k = 0; k < params.countKeys; k++)
+            {
+                const size_t frame = k * params.animationLength / std::max(size_t(1), params.countKeys);
+                const float angle = 0.2f * std::sin(float(k + i + j)),
+                            shift = 0.1f * std::cos(float(k + i));
+
+                os << "<key frame=\"" << frame << "\" x=\"" << shift << "\" y=\"0.0\" z=\"0.0\""
+                   << " rot_x=\"0.0\" rot_y=\"0.0\" rot_z=\"" << std::sin(angle / 2)
+                   << "\" rot_w=\"" << std::cos(angle / 2) << "\"/>";
+            }
+            os << "</layer>" << std::endl;
+        }
+        os << "</animation>" << std::endl;
+    }
+    os << "</animations>" << std::endl;
+    os << "</armature>" << std::endl;
+
+    os << "</mesh>" << std::endl;
+}
@@ -0,0 +1,28 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <iostream>
+
+
+/**
+ * Describes a generated mesh: a grid of quads, with chains of bones along it.
+ */
+struct SyntheticMeshParams
+{
+    size_t countColumns,
+           countRows,
+           countBones,
+           countAnimations,
+           animationLength,
+           countKeys;  // per layer
+
+    // Vertices in row r get pulled by up to r % (countExtraBones + 1) more bones.
+    size_t countExtraBones = 0;
+
+    // The bones form chains of this many bones, 0 for one chain of all bones.
+    size_t hierarchyDepth = 0;
+};
+
+void WriteSyntheticMesh(std::ostream &, const SyntheticMeshParams &);
+
+#endif  // SYNTHETIC_H